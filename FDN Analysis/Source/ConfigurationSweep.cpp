@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    ConfigurationSweep.cpp
+    Created: 20 Oct 2026 4:52:30pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "ConfigurationSweep.h"
+
+std::vector<ConfigurationSweep::Result> ConfigurationSweep::run(const std::vector<Configuration>& configurations,
+                                                                 int numThreads) {
+    std::vector<Result> results(configurations.size());
+    std::atomic<int> remaining { (int)configurations.size() };
+    WaitableEvent finished;
+
+    ThreadPool pool(jmax(1, numThreads));
+    for (size_t i = 0; i < configurations.size(); ++i) {
+        pool.addJob([&, i] {
+            results[i] = analyse(configurations[i]);
+            if (--remaining == 0)
+                finished.signal();
+        });
+    }
+
+    if (!configurations.empty())
+        finished.wait(-1);
+    return results;
+}
+
+ConfigurationSweep::Result ConfigurationSweep::analyse(const Configuration& configuration) {
+    Result result;
+    result.configuration = configuration;
+    result.multipliesPerSample = getMultipliesPerSample(configuration.order);
+
+    const double start = Time::getMillisecondCounterHiRes();
+
+    FDN fdn;
+    fdn.setSeed((uint32)configuration.seed);
+    fdn.init((float)configuration.sampleRate, configuration.order, configuration.lowDelayMs, configuration.highDelayMs);
+
+    dsp::ProcessSpec spec;
+    spec.sampleRate = configuration.sampleRate;
+    spec.maximumBlockSize = 512;
+    spec.numChannels = 1;
+    fdn.prepare(spec);
+    fdn.updateFilter(configuration.lowT60, configuration.highT60,
+                     configuration.lowTransFreq, configuration.highTransFreq);
+    fdn.updateDryMix(0.f);
+
+    if (MatrixFactory::isGenerated(configuration.matrixType)) {
+        fdn.setMatrix(MatrixFactory::create(configuration.matrixType, configuration.order, configuration.seed));
+        fdn.applyPendingMatrix();
+    }
+
+    const int length = jmax(1, (int)(configuration.seconds * configuration.sampleRate));
+    std::vector<float> ir(length);
+    fdn.renderImpulseResponse(ir.data(), length);
+
+    const double rendered = Time::getMillisecondCounterHiRes();
+    result.renderMs = rendered - start;
+
+    double totalDelay = 0.0;
+    for (int i = 0; i < configuration.order; ++i)
+        totalDelay += fdn.delayLength[i];
+
+    result.metrics = IRMetrics::analyse(ir.data(), length, configuration.sampleRate, totalDelay);
+    result.analysisMs = Time::getMillisecondCounterHiRes() - rendered;
+    return result;
+}
+
+bool ConfigurationSweep::meetsTargets(const Result& result, const Targets& targets) {
+    const auto& metrics = result.metrics;
+    if (targets.maxMixingTime >= 0.f && (metrics.mixingTime < 0.f || metrics.mixingTime > targets.maxMixingTime))
+        return false;
+    if (targets.minFlatness >= 0.f && metrics.spectralFlatness < targets.minFlatness)
+        return false;
+    if (targets.maxColoration >= 0.f && metrics.coloration > targets.maxColoration)
+        return false;
+    if (targets.minModalDensityRatio >= 0.f
+        && metrics.modalDensity < targets.minModalDensityRatio * metrics.expectedModalDensity)
+        return false;
+    return true;
+}
+
+int ConfigurationSweep::findCheapest(const std::vector<Result>& results, const Targets& targets) {
+    int cheapest = -1;
+    for (int i = 0; i < (int)results.size(); ++i) {
+        if (meetsTargets(results[i], targets)
+            && (cheapest < 0 || results[i].multipliesPerSample < results[cheapest].multipliesPerSample))
+            cheapest = i;
+    }
+    return cheapest;
+}
+
+namespace {
+    var toArray(const std::vector<float>& values) {
+        Array<var> array;
+        for (const float value : values)
+            array.add(value);
+        return array;
+    }
+
+    String getMatrixName(int type) {
+        if (MatrixFactory::isGenerated(type))
+            return MatrixFactory::getName(type);
+        return type == 1 ? "identity" : String(type);
+    }
+}
+
+var ConfigurationSweep::toJSON(const std::vector<Result>& results, const Targets& targets) {
+    Array<var> entries;
+    for (const auto& result : results) {
+        const auto& c = result.configuration;
+        const auto& m = result.metrics;
+
+        DynamicObject::Ptr configuration = new DynamicObject();
+        configuration->setProperty("order", c.order);
+        configuration->setProperty("matrix", getMatrixName(c.matrixType));
+        configuration->setProperty("seed", c.seed);
+        configuration->setProperty("lowDelayMs", c.lowDelayMs);
+        configuration->setProperty("highDelayMs", c.highDelayMs);
+        configuration->setProperty("lowT60", c.lowT60);
+        configuration->setProperty("highT60", c.highT60);
+        configuration->setProperty("lowTransFreq", c.lowTransFreq);
+        configuration->setProperty("highTransFreq", c.highTransFreq);
+        configuration->setProperty("sampleRate", c.sampleRate);
+        configuration->setProperty("seconds", c.seconds);
+
+        DynamicObject::Ptr bands = new DynamicObject();
+        std::vector<float> frequencies, t60s;
+        Array<var> relief;
+        for (int b = 0; b < IRMetrics::nrBands; ++b) {
+            frequencies.push_back(IRMetrics::getBandFrequency(b));
+            t60s.push_back(m.t60[b]);
+            relief.add(toArray(m.decayRelief[b]));
+        }
+        bands->setProperty("frequencies", toArray(frequencies));
+        bands->setProperty("t60", toArray(t60s));
+        bands->setProperty("decayReliefStep", m.decayReliefStep);
+        bands->setProperty("decayRelief", relief);
+
+        DynamicObject::Ptr entry = new DynamicObject();
+        entry->setProperty("configuration", configuration.get());
+        entry->setProperty("multipliesPerSample", result.multipliesPerSample);
+        entry->setProperty("renderMs", result.renderMs);
+        entry->setProperty("analysisMs", result.analysisMs);
+        entry->setProperty("mixingTime", m.mixingTime);
+        entry->setProperty("echoDensityStep", m.echoDensityStep);
+        entry->setProperty("echoDensity", toArray(m.echoDensity));
+        entry->setProperty("modalDensity", m.modalDensity);
+        entry->setProperty("expectedModalDensity", m.expectedModalDensity);
+        entry->setProperty("modeSpacingSpread", m.modeSpacingSpread);
+        entry->setProperty("modeWindow", m.modeWindow);
+        entry->setProperty("modeSmoothing", m.modeSmoothing);
+        entry->setProperty("modeProminence", IRMetrics::minProminenceDb);
+        entry->setProperty("coloration", m.coloration);
+        entry->setProperty("spectralFlatness", m.spectralFlatness);
+        entry->setProperty("bands", bands.get());
+        entry->setProperty("meetsTargets", meetsTargets(result, targets));
+        entries.add(entry.get());
+    }
+
+    DynamicObject::Ptr root = new DynamicObject();
+    root->setProperty("results", entries);
+    root->setProperty("cheapest", findCheapest(results, targets));
+    return root.get();
+}
@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    ConfigurationSweep.h
+    Created: 20 Oct 2026 4:52:30pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../FDN Reverb/Source/FDN.hpp"
+#include "../../FDN Reverb/Source/MatrixFactory.h"
+#include "IRMetrics.h"
+
+// Renders the impulse response of an FDN for every configuration and measures
+// it with IRMetrics, one job per configuration on a thread pool. Each job has
+// its own FDN, which holds about 2 MB per delay line.
+class ConfigurationSweep {
+
+public:
+
+    struct Configuration {
+        int order = 16;
+        int matrixType = MatrixFactory::hadamard;
+        int seed = 1;
+        float lowDelayMs = 5.f, highDelayMs = 20.f;
+        float lowT60 = 2.f, highT60 = 0.5f;
+        float lowTransFreq = 400.f, highTransFreq = 2500.f;
+        double sampleRate = 48000.0;
+        float seconds = 3.f;
+    };
+
+    struct Result {
+        Configuration configuration;
+        IRMetrics::Result metrics;
+        int multipliesPerSample = 0;
+        double renderMs = 0.0, analysisMs = 0.0;
+    };
+
+    // the first configuration for which every limit holds, a negative limit is left out
+    struct Targets {
+        float maxMixingTime = -1.f;         // seconds
+        float minFlatness = -1.f;
+        float maxColoration = -1.f;         // dB
+        float minModalDensityRatio = -1.f;  // measured over expected
+    };
+
+    // results come back in the order of the configurations
+    static std::vector<Result> run(const std::vector<Configuration>& configurations, int numThreads);
+
+    static Result analyse(const Configuration& configuration);
+
+    // matrix, gains and shelves per sample, for ranking by cost
+    static int getMultipliesPerSample(int order) { return order * order + 2 * order + 3 * 3 * order; }
+
+    static bool meetsTargets(const Result& result, const Targets& targets);
+
+    // index of the cheapest result that meets the targets, -1 if none does
+    static int findCheapest(const std::vector<Result>& results, const Targets& targets);
+
+    static var toJSON(const std::vector<Result>& results, const Targets& targets);
+};
@@ -0,0 +1,232 @@
+/*
+  ==============================================================================
+
+    IRMetrics.cpp
+    Created: 20 Oct 2026 4:17:52pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "IRMetrics.h"
+
+IRMetrics::Result IRMetrics::analyse(const float* ir, int length, double sampleRate, double totalDelay) {
+    Result result;
+
+    result.echoDensity = normalizedEchoDensity(ir, length, sampleRate, 0.02f, result.echoDensityStep);
+    for (size_t i = 0; i < result.echoDensity.size(); ++i) {
+        if (result.echoDensity[i] >= 0.95f) {
+            result.mixingTime = i * result.echoDensityStep;
+            break;
+        }
+    }
+
+    result.expectedModalDensity = (float)(totalDelay / sampleRate);
+    measureModes(ir, length, sampleRate, 100.0f, (float)(0.4 * sampleRate), result);
+    measureDecayRelief(ir, length, sampleRate, result);
+    return result;
+}
+
+// Hann weighted, the window is centred on each step and cut off at the ends
+std::vector<float> IRMetrics::normalizedEchoDensity(const float* ir, int length, double sampleRate,
+                                                    float windowSeconds, float stepSeconds) {
+    const int halfWindow = jmax(1, (int)(0.5 * windowSeconds * sampleRate));
+    const int step = jmax(1, (int)(stepSeconds * sampleRate));
+    const double gaussianShare = std::erfc(1.0 / std::sqrt(2.0));
+
+    std::vector<double> window(2 * halfWindow + 1);
+    for (int k = 0; k < (int)window.size(); ++k)
+        window[k] = 0.5 - 0.5 * std::cos(2.0 * MathConstants<double>::pi * (k + 1) / (window.size() + 1));
+
+    std::vector<float> density;
+    for (int centre = 0; centre < length; centre += step) {
+        const int first = jmax(0, centre - halfWindow), last = jmin(length - 1, centre + halfWindow);
+
+        double weightSum = 0.0, energy = 0.0;
+        for (int n = first; n <= last; ++n) {
+            const double w = window[n - centre + halfWindow];
+            weightSum += w;
+            energy += w * ir[n] * ir[n];
+        }
+        const double sigma = std::sqrt(energy / weightSum);
+
+        double outside = 0.0;
+        for (int n = first; n <= last; ++n) {
+            if (std::abs(ir[n]) > sigma)
+                outside += window[n - centre + halfWindow];
+        }
+        density.push_back(sigma > 0.0 ? (float)(outside / weightSum / gaussianShare) : 0.0f);
+    }
+    return density;
+}
+
+// The modes are counted in the first modeWindowSeconds of the response, faded out
+// over its last quarter so the cut adds no ripple of its own and zero padded to
+// twice its length. The power spectrum is smoothed over the resolution of the
+// window, and a peak only counts if it stands minProminenceDb above the deeper
+// of the two valleys towards the next higher peak. Without that, the bin to bin
+// ripple of a noise like tail is counted, which follows the FFT length instead
+// of the modes.
+void IRMetrics::measureModes(const float* ir, int length, double sampleRate,
+                             float minFrequency, float maxFrequency, Result& result) {
+    const int windowLength = jmin(length, jmax(1, (int)(modeWindowSeconds * sampleRate)));
+    const int order = jmax(1, (int)std::ceil(std::log2(2.0 * windowLength)));
+    const int size = 1 << order;
+    dsp::FFT fft(order);
+    std::vector<float> spectrum(2 * size, 0.0f);
+
+    const int fadeLength = jmax(1, windowLength / 4);
+    for (int n = 0; n < windowLength; ++n) {
+        const int fade = n - (windowLength - fadeLength);
+        const double w = fade < 0 ? 1.0 : 0.5 + 0.5 * std::cos(MathConstants<double>::pi * fade / fadeLength);
+        spectrum[n] = (float)(ir[n] * w);
+    }
+    fft.performFrequencyOnlyForwardTransform(spectrum.data());
+
+    const double binWidth = sampleRate / size;
+    const int firstBin = jmax(1, (int)(minFrequency / binWidth));
+    const int lastBin = jmin(size / 2 - 2, (int)(maxFrequency / binWidth));
+    result.modeWindow = (float)(windowLength / sampleRate);
+    result.modeSmoothing = (float)(sampleRate / windowLength);
+    if (lastBin <= firstBin + 2)
+        return;
+
+    // flatness of the power spectrum, geometric over arithmetic mean
+    double logSum = 0.0, powerSum = 0.0;
+    for (int k = firstBin; k <= lastBin; ++k) {
+        const double power = (double)spectrum[k] * spectrum[k] + 1.0e-30;
+        logSum += std::log(power);
+        powerSum += power;
+    }
+    const int bins = lastBin - firstBin + 1;
+    result.spectralFlatness = (float)(std::exp(logSum / bins) / (powerSum / bins));
+
+    // power averaged over the resolution of the window, in dB
+    const int nrBins = size / 2;
+    const int halfWidth = jmax(0, roundToInt(0.5 * result.modeSmoothing / binWidth));
+    std::vector<double> levelDb(nrBins);
+    for (int k = 0; k < nrBins; ++k) {
+        const int first = jmax(0, k - halfWidth), last = jmin(nrBins - 1, k + halfWidth);
+        double power = 0.0;
+        for (int j = first; j <= last; ++j)
+            power += (double)spectrum[j] * spectrum[j];
+        levelDb[k] = 10.0 * std::log10(power / (last - first + 1) + 1.0e-30);
+    }
+
+    std::vector<int> peaks;
+    for (int k = firstBin; k <= lastBin; ++k) {
+        if (!(levelDb[k] > levelDb[k - 1] && levelDb[k] >= levelDb[k + 1]))
+            continue;
+
+        double leftMin = levelDb[k], rightMin = levelDb[k];
+        for (int j = k - 1; j >= 0 && levelDb[j] <= levelDb[k]; --j)
+            leftMin = jmin(leftMin, levelDb[j]);
+        for (int j = k + 1; j < nrBins && levelDb[j] <= levelDb[k]; ++j)
+            rightMin = jmin(rightMin, levelDb[j]);
+
+        if (levelDb[k] - jmax(leftMin, rightMin) >= minProminenceDb)
+            peaks.push_back(k);
+    }
+    if (peaks.size() < 3)
+        return;
+
+    result.modalDensity = (float)(peaks.size() / ((lastBin - firstBin) * binWidth));
+
+    double spacingSum = 0.0, spacingSquares = 0.0;
+    for (size_t i = 1; i < peaks.size(); ++i) {
+        const double spacing = (peaks[i] - peaks[i - 1]) * binWidth;
+        spacingSum += spacing;
+        spacingSquares += spacing * spacing;
+    }
+    const double spacings = (double)(peaks.size() - 1);
+    const double meanSpacing = spacingSum / spacings;
+    result.modeSpacingSpread = (float)(std::sqrt(jmax(0.0, spacingSquares / spacings - meanSpacing * meanSpacing)) / meanSpacing);
+
+    double heightSum = 0.0, heightSquares = 0.0;
+    for (const int k : peaks) {
+        heightSum += levelDb[k];
+        heightSquares += levelDb[k] * levelDb[k];
+    }
+    const double meanHeight = heightSum / peaks.size();
+    result.coloration = (float)std::sqrt(jmax(0.0, heightSquares / peaks.size() - meanHeight * meanHeight));
+}
+
+// Hann windowed frames of about 21 ms at 48 kHz with half overlap. The relief
+// is kept every 50 ms, the T20 is fitted on every frame.
+void IRMetrics::measureDecayRelief(const float* ir, int length, double sampleRate, Result& result) {
+    const int order = jmax(6, (int)std::round(std::log2(0.02 * sampleRate)));
+    const int size = 1 << order;
+    const int hop = size / 2;
+    const int nrFrames = jmax(1, (length - size) / hop + 1);
+    dsp::FFT fft(order);
+
+    std::vector<float> window(size), frame(2 * size);
+    for (int n = 0; n < size; ++n)
+        window[n] = 0.5f - 0.5f * std::cos(2.0f * MathConstants<float>::pi * n / size);
+
+    // energy of every frame in every band, a bin goes to the band its centre is nearest to
+    std::vector<std::vector<double>> bandEnergy(nrBands, std::vector<double>(nrFrames, 0.0));
+    std::vector<int> binBand(size / 2 + 1, -1);
+    for (int k = 1; k <= size / 2; ++k) {
+        const double octaves = std::log2(k * sampleRate / size / getBandFrequency(0));
+        const int band = (int)std::round(octaves);
+        if (band >= 0 && band < nrBands && getBandFrequency(band) * 1.41 < 0.5 * sampleRate)
+            binBand[k] = band;
+    }
+
+    for (int f = 0; f < nrFrames; ++f) {
+        std::fill(frame.begin(), frame.end(), 0.0f);
+        for (int n = 0; n < size && f * hop + n < length; ++n)
+            frame[n] = ir[f * hop + n] * window[n];
+        fft.performFrequencyOnlyForwardTransform(frame.data());
+        for (int k = 1; k <= size / 2; ++k) {
+            if (binBand[k] >= 0)
+                bandEnergy[binBand[k]][f] += (double)frame[k] * frame[k];
+        }
+    }
+
+    const double frameSeconds = hop / sampleRate;
+    const int keepEvery = jmax(1, (int)std::round(result.decayReliefStep / frameSeconds));
+    result.decayReliefStep = (float)(keepEvery * frameSeconds);
+    result.decayRelief.assign(nrBands, {});
+
+    for (int b = 0; b < nrBands; ++b) {
+        auto& energy = bandEnergy[b];
+        for (int f = nrFrames - 2; f >= 0; --f)
+            energy[f] += energy[f + 1];
+        if (energy[0] <= 0.0)
+            continue;
+
+        std::vector<double> level(nrFrames);
+        for (int f = 0; f < nrFrames; ++f)
+            level[f] = 10.0 * std::log10(energy[f] / energy[0] + 1.0e-30);
+
+        for (int f = 0; f < nrFrames; f += keepEvery)
+            result.decayRelief[b].push_back((float)level[f]);
+
+        int start = -1, end = -1;
+        for (int f = 0; f < nrFrames; ++f) {
+            if (start < 0 && level[f] <= -5.0)
+                start = f;
+            if (level[f] <= -25.0) {
+                end = f;
+                break;
+            }
+        }
+        if (start < 0 || end <= start + 1)
+            continue;
+
+        double sumT = 0.0, sumL = 0.0, sumTT = 0.0, sumTL = 0.0;
+        const int count = end - start + 1;
+        for (int f = start; f <= end; ++f) {
+            const double t = f * frameSeconds;
+            sumT += t;
+            sumL += level[f];
+            sumTT += t * t;
+            sumTL += t * level[f];
+        }
+        const double slope = (count * sumTL - sumT * sumL) / (count * sumTT - sumT * sumT);
+        if (slope < 0.0)
+            result.t60[b] = (float)(-60.0 / slope);
+    }
+}
@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+
+    IRMetrics.h
+    Created: 20 Oct 2026 4:17:52pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Objective measures of an impulse response, to compare FDN configurations
+// with numbers instead of by ear. All of it is offline and allocates freely.
+//
+// - Normalized echo density (Abel and Huang): the share of samples in a 20 ms
+//   window that lie more than one standard deviation out, divided by what
+//   Gaussian noise would give. It rises to about 1 once the tail is diffuse,
+//   the first time it reaches 0.95 is taken as the mixing time.
+// - Modal density: prominent peaks of the smoothed magnitude response per Hz,
+//   in the first modeWindowSeconds, against the total delay over the sample
+//   rate that an FDN has in theory. The spread is the coefficient of variation
+//   of the peak spacing, about 1 for randomly placed modes and lower for a
+//   regular, comb like pattern.
+// - Coloration: standard deviation of the peak heights in dB (the modal
+//   excitation spread), and the spectral flatness of the power spectrum,
+//   about 0.56 for a tail that is white noise under its envelope.
+// - Energy decay relief (Jot): the energy left after each frame of a short
+//   time Fourier transform, summed over octave bands, with a T20 per band.
+class IRMetrics {
+
+public:
+
+    enum
+    {
+        nrBands = 8,    // 63 Hz to 8 kHz
+    };
+
+    struct Result {
+        std::vector<float> echoDensity;     // every echoDensityStep seconds
+        float echoDensityStep = 0.01f;
+        float mixingTime = -1.0f;           // seconds, -1 if it never got there
+
+        float modalDensity = 0.0f;          // peaks per Hz
+        float expectedModalDensity = 0.0f;  // total delay / sample rate
+        float modeSpacingSpread = 0.0f;
+        float modeWindow = 0.0f;            // seconds of the response the modes were counted in
+        float modeSmoothing = 0.0f;         // Hz, the spectrum was averaged over this
+
+        float coloration = 0.0f;            // dB
+        float spectralFlatness = 0.0f;
+
+        std::vector<std::vector<float>> decayRelief;    // [band][frame] in dB
+        float decayReliefStep = 0.05f;
+        float t60[nrBands] = {};            // 0 if the band did not decay 25 dB
+    };
+
+    // totalDelay is the sum of the delay lengths in samples, 0 leaves the expected density out
+    static Result analyse(const float* ir, int length, double sampleRate, double totalDelay);
+
+    static std::vector<float> normalizedEchoDensity(const float* ir, int length, double sampleRate,
+                                                    float windowSeconds, float stepSeconds);
+
+    // peaks between minFrequency and maxFrequency, written into result
+    static void measureModes(const float* ir, int length, double sampleRate,
+                             float minFrequency, float maxFrequency, Result& result);
+
+    static void measureDecayRelief(const float* ir, int length, double sampleRate, Result& result);
+
+    static float getBandFrequency(int band) { return 62.5f * (float)(1 << band); }
+
+    static constexpr float modeWindowSeconds = 1.0f;
+    static constexpr float minProminenceDb = 3.0f;
+};
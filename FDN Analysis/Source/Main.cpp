@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 20 Oct 2026 5:20:14pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "ConfigurationSweep.h"
+
+namespace {
+    const char* const usage =
+        "FDN Analysis - renders FDN impulse responses and measures them\n"
+        "\n"
+        "Every combination of orders, matrices and seeds is one configuration.\n"
+        "\n"
+        "  --orders=8,16,32                   number of delay lines, up to 32\n"
+        "  --matrices=hadamard,householder    randomOrthogonal, hadamard, householder, circulant,\n"
+        "                                     blockDiagonal, nested or identity\n"
+        "  --seeds=1                          seeds for the gains and the random matrices\n"
+        "  --delays=5,20                      shortest and longest delay in ms\n"
+        "  --t60=2,0.5                        low and high T60 in seconds\n"
+        "  --transition=400,2500              low and high transition frequency in Hz\n"
+        "  --rate=48000                       sample rate\n"
+        "  --seconds=3                        length of the impulse responses\n"
+        "  --threads=<cpus>                   configurations analysed at the same time\n"
+        "  --max-mixing-time=<s>              targets for the cheapest configuration,\n"
+        "  --min-flatness=<0..1>              left out when not given\n"
+        "  --max-coloration=<dB>\n"
+        "  --min-modal-density=<ratio>        measured over expected modal density\n"
+        "  --output=<file>                    JSON goes to stdout without it\n";
+
+    std::vector<float> parseList(const String& text) {
+        std::vector<float> values;
+        for (const auto& item : StringArray::fromTokens(text, ",", ""))
+            if (item.trim().isNotEmpty())
+                values.push_back(item.trim().getFloatValue());
+        return values;
+    }
+
+    // the option if it was given, otherwise the default
+    String getOption(const ArgumentList& args, const String& option, const String& defaultValue) {
+        return args.containsOption(option) ? args.getValueForOption(option) : defaultValue;
+    }
+
+    float getTarget(const ArgumentList& args, const String& option) {
+        return args.containsOption(option) ? args.getValueForOption(option).getFloatValue() : -1.f;
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    ArgumentList args(argc, argv);
+    if (args.containsOption("--help|-h")) {
+        std::cout << usage;
+        return 0;
+    }
+
+    const auto orders = parseList(getOption(args, "--orders", "8,16,32"));
+    const auto seeds = parseList(getOption(args, "--seeds", "1"));
+    const auto delays = parseList(getOption(args, "--delays", "5,20"));
+    const auto t60s = parseList(getOption(args, "--t60", "2,0.5"));
+    const auto transitions = parseList(getOption(args, "--transition", "400,2500"));
+    if (delays.size() != 2 || t60s.size() != 2 || transitions.size() != 2) {
+        std::cerr << "--delays, --t60 and --transition take two values each\n\n" << usage;
+        return 1;
+    }
+
+    std::vector<int> matrices;
+    for (const auto& name : StringArray::fromTokens(getOption(args, "--matrices", "hadamard,householder,randomOrthogonal"), ",", "")) {
+        const int type = name == "identity" ? 1 : MatrixFactory::getTypeFromName(name.trim());
+        if (type < 0) {
+            std::cerr << "Unknown matrix " << name << "\n\n" << usage;
+            return 1;
+        }
+        matrices.push_back(type);
+    }
+
+    ConfigurationSweep::Configuration base;
+    base.lowDelayMs = delays[0];
+    base.highDelayMs = delays[1];
+    base.lowT60 = t60s[0];
+    base.highT60 = t60s[1];
+    base.lowTransFreq = transitions[0];
+    base.highTransFreq = transitions[1];
+    base.sampleRate = getOption(args, "--rate", "48000").getDoubleValue();
+    base.seconds = getOption(args, "--seconds", "3").getFloatValue();
+
+    std::vector<ConfigurationSweep::Configuration> configurations;
+    for (const float order : orders) {
+        for (const int matrix : matrices) {
+            for (const float seed : seeds) {
+                auto configuration = base;
+                configuration.order = jlimit(1, 32, (int)order);
+                configuration.matrixType = matrix;
+                configuration.seed = (int)seed;
+                configurations.push_back(configuration);
+            }
+        }
+    }
+
+    ConfigurationSweep::Targets targets;
+    targets.maxMixingTime = getTarget(args, "--max-mixing-time");
+    targets.minFlatness = getTarget(args, "--min-flatness");
+    targets.maxColoration = getTarget(args, "--max-coloration");
+    targets.minModalDensityRatio = getTarget(args, "--min-modal-density");
+
+    const int threads = getOption(args, "--threads", String(SystemStats::getNumCpus())).getIntValue();
+    const auto results = ConfigurationSweep::run(configurations, threads);
+    const String json = JSON::toString(ConfigurationSweep::toJSON(results, targets));
+
+    if (args.containsOption("--output")) {
+        const File file = File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--output"));
+        if (!file.replaceWithText(json)) {
+            std::cerr << "Could not write " << file.getFullPathName() << "\n";
+            return 1;
+        }
+    } else {
+        std::cout << json << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+  ==============================================================================
+
+    AllpassDiffuser.cpp
+    Created: 19 Oct 2026 2:48:31pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "AllpassDiffuser.h"
+
+namespace
+{
+    // mutually prime-ish stage delays in ms, short enough not to smear the attack
+    const float stageDelayMs[AllpassDiffuser::maxStages] = { 0.67f, 1.13f, 1.73f, 2.39f, 3.11f, 4.07f, 5.23f, 6.71f };
+}
+
+AllpassDiffuser::AllpassDiffuser() {}
+
+AllpassDiffuser::~AllpassDiffuser() {}
+
+void AllpassDiffuser::prepare(double sampleRate, int numChannels, int maxLines) {
+    rowSize = maxLines;
+    feedback.assign(rowSize, 0.0f);
+    inner.assign(rowSize, 0.0f);
+
+    for (int s = 0; s < maxStages; ++s) {
+        stageDelay[s] = jmax(1, roundToInt(stageDelayMs[s] * sampleRate / 1000.0));
+    }
+
+    state.resize(numChannels);
+    position.assign(numChannels, std::vector<int>(maxStages, 0));
+    for (auto& channel : state) {
+        channel.resize(maxStages);
+        for (int s = 0; s < maxStages; ++s) {
+            channel[s].assign(stageDelay[s] * rowSize, 0.0f);
+        }
+    }
+}
+
+void AllpassDiffuser::reset() {
+    for (auto& channel : state)
+        for (auto& stage : channel)
+            std::fill(stage.begin(), stage.end(), 0.0f);
+    for (auto& channel : position)
+        std::fill(channel.begin(), channel.end(), 0);
+}
+
+void AllpassDiffuser::setNrStages(int newNrStages) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingStages = jlimit(1, (int)maxStages, newNrStages);
+    settingsChanged = true;
+}
+
+void AllpassDiffuser::setGain(float newGain) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingGain = jlimit(-0.95f, 0.95f, newGain);
+    settingsChanged = true;
+}
+
+void AllpassDiffuser::setNested(bool shouldBeNested) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingNested = shouldBeNested;
+    settingsChanged = true;
+}
+
+void AllpassDiffuser::copySettingsFrom(const AllpassDiffuser& other) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingStages = other.pendingStages;
+    pendingGain = other.pendingGain;
+    pendingNested = other.pendingNested;
+    settingsChanged = true;
+}
+
+// called on the audio thread, a change that is being written is taken next time
+void AllpassDiffuser::applyPendingSettings() {
+    const SpinLock::ScopedTryLockType lock(settingsLock);
+    if (!lock.isLocked() || !settingsChanged)
+        return;
+
+    // stages that come back into use must not replay what they held before
+    for (auto& channel : state)
+        for (int s = nrStages; s < pendingStages && s < (int)channel.size(); ++s)
+            std::fill(channel[s].begin(), channel[s].end(), 0.0f);
+
+    nrStages = pendingStages;
+    gain = pendingGain;
+    nested = pendingNested;
+    settingsChanged = false;
+}
+
+// uses the pending stages, the loop filters are designed for the settings that are on the way
+int AllpassDiffuser::getTotalDelay() const {
+    int total = 0;
+    for (int s = 0; s < pendingStages; ++s) {
+        total += stageDelay[s];
+    }
+    return total;
+}
+
+void AllpassDiffuser::process(int channel, float* lines, int numLines) {
+    if (channel >= (int)state.size() || numLines > rowSize)
+        return;
+
+    if (channel == 0)
+        applyPendingSettings();
+
+    if (nested)
+        processNested(channel, lines, numLines);
+    else
+        processSeries(channel, lines, numLines);
+}
+
+// w[n] = x[n] + g * w[n - M]
+// y[n] = w[n - M] - g * w[n]
+void AllpassDiffuser::processSeries(int channel, float* lines, int numLines) {
+    float* w = feedback.data();
+
+    for (int s = 0; s < nrStages; ++s) {
+        float* delayed = getRow(channel, s);
+
+        FloatVectorOperations::copy(w, lines, numLines);
+        FloatVectorOperations::addWithMultiply(w, delayed, gain, numLines);
+        FloatVectorOperations::copy(lines, delayed, numLines);
+        FloatVectorOperations::addWithMultiply(lines, w, -gain, numLines);
+        FloatVectorOperations::copy(delayed, w, numLines);
+
+        advance(channel, s);
+    }
+}
+
+// Same recursion, but the delayed signal of stage s is first run through stage
+// s + 1, whose input is therefore the delayed signal of stage s. Working from
+// the innermost stage outwards, every stage only needs rows that have not been
+// overwritten yet.
+void AllpassDiffuser::processNested(int channel, float* lines, int numLines) {
+    float* w = feedback.data();
+    float* y = inner.data();
+    const int last = nrStages - 1;
+
+    FloatVectorOperations::copy(y, getRow(channel, last), numLines);
+
+    for (int s = last; s >= 0; --s) {
+        const float* x = (s == 0 ? lines : getRow(channel, s - 1));
+
+        FloatVectorOperations::copy(w, x, numLines);
+        FloatVectorOperations::addWithMultiply(w, y, gain, numLines);
+        FloatVectorOperations::addWithMultiply(y, w, -gain, numLines);
+        FloatVectorOperations::copy(getRow(channel, s), w, numLines);
+
+        advance(channel, s);
+    }
+
+    FloatVectorOperations::copy(lines, y, numLines);
+}
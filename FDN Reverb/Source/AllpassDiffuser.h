@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    AllpassDiffuser.h
+    Created: 19 Oct 2026 2:48:31pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Chain of allpass stages that sits inside the feedback loop, between the
+// delay lines and the attenuation filters. Every line gets its own allpass,
+// but all lines share the delay of a stage, so the state is stored one row
+// per time step with the lines next to each other (structure of arrays) and
+// each stage runs as a handful of vector operations across all lines.
+//
+// Series: x -> AP1 -> AP2 -> ... (Schroeder)
+// Nested: the delay of each stage is followed by the next stage, AP1(AP2(...))
+class AllpassDiffuser {
+
+public:
+
+    AllpassDiffuser();
+    ~AllpassDiffuser();
+
+    void prepare(double sampleRate, int numChannels, int maxLines);
+
+    void reset();
+
+    // the settings are stored as pending and picked up by the audio thread in process()
+    void setNrStages(int newNrStages);
+    void setGain(float newGain);
+    void setNested(bool shouldBeNested);
+    void copySettingsFrom(const AllpassDiffuser& other);
+
+    int getNrStages() const { return pendingStages; }
+    float getGain() const { return pendingGain; }
+    bool isNested() const { return pendingNested; }
+
+    // sum of the stage delays in samples, which is also the average group delay
+    // the diffusion adds to every line
+    int getTotalDelay() const;
+
+    // lines holds one sample per delay line and is processed in place
+    void process(int channel, float* lines, int numLines);
+
+    enum
+    {
+        maxStages = 8,
+    };
+
+private:
+
+    void applyPendingSettings();
+    void processSeries(int channel, float* lines, int numLines);
+    void processNested(int channel, float* lines, int numLines);
+
+    float* getRow(int channel, int stage) {
+        return state[channel][stage].data() + position[channel][stage] * rowSize;
+    }
+    void advance(int channel, int stage) {
+        if (++position[channel][stage] == stageDelay[stage])
+            position[channel][stage] = 0;
+    }
+
+    // [channel][stage] -> stageDelay rows of rowSize samples
+    std::vector<std::vector<std::vector<float>>> state;
+    std::vector<std::vector<int>> position;
+    int stageDelay[maxStages] = {};
+    std::vector<float> feedback, inner;
+    int rowSize = 0;
+
+    int nrStages = 4;
+    float gain = 0.6f;
+    bool nested = false;
+
+    int pendingStages = 4;
+    float pendingGain = 0.6f;
+    bool pendingNested = false;
+    bool settingsChanged = false;
+    SpinLock settingsLock;
+};
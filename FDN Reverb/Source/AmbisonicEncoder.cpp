@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    AmbisonicEncoder.cpp
+    Created: 20 Oct 2026 1:52:38am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "AmbisonicEncoder.h"
+
+AmbisonicEncoder::AmbisonicEncoder() {}
+
+AmbisonicEncoder::~AmbisonicEncoder() {}
+
+void AmbisonicEncoder::prepare(int ambisonicOrder, int maxBlockSize) {
+    order = jlimit(0, (int)maxOrder, ambisonicOrder);
+    blockSize = jmax(1, maxBlockSize);
+    lineBlock.assign((size_t)maxLines * blockSize, 0.0f);
+
+    for (int i = 0; i < maxLines; ++i)
+        evaluate(order, getAzimuth(i), getElevation(i), shGains[i]);
+}
+
+// R2 sequence (plastic number) mapped to the sphere with equal area, every
+// prefix of it is close to uniform
+float AmbisonicEncoder::getAzimuth(int line) const {
+    const double g = 1.32471795724474602596;
+    const double v = std::fmod(0.5 + (line + 1) / (g * g), 1.0);
+    return (float)(MathConstants<double>::twoPi * v - MathConstants<double>::pi);
+}
+
+float AmbisonicEncoder::getElevation(int line) const {
+    const double g = 1.32471795724474602596;
+    const double u = std::fmod(0.5 + (line + 1) / g, 1.0);
+    return (float)std::asin(1.0 - 2.0 * u);
+}
+
+void AmbisonicEncoder::evaluate(int order, float azimuth, float elevation, float* destination) {
+    const float x = std::cos(elevation) * std::cos(azimuth);
+    const float y = std::cos(elevation) * std::sin(azimuth);
+    const float z = std::sin(elevation);
+
+    destination[0] = 1.0f;
+    if (order < 1)
+        return;
+
+    destination[1] = y;
+    destination[2] = z;
+    destination[3] = x;
+    if (order < 2)
+        return;
+
+    const float sqrt3 = std::sqrt(3.0f);
+    destination[4] = sqrt3 * x * y;
+    destination[5] = sqrt3 * y * z;
+    destination[6] = 0.5f * (3.0f * z * z - 1.0f);
+    destination[7] = sqrt3 * x * z;
+    destination[8] = 0.5f * sqrt3 * (x * x - y * y);
+    if (order < 3)
+        return;
+
+    const float a = std::sqrt(5.0f / 8.0f);
+    const float b = std::sqrt(15.0f);
+    const float c = std::sqrt(3.0f / 8.0f);
+    destination[9] = a * y * (3.0f * x * x - y * y);
+    destination[10] = b * x * y * z;
+    destination[11] = c * y * (5.0f * z * z - 1.0f);
+    destination[12] = 0.5f * z * (5.0f * z * z - 3.0f);
+    destination[13] = c * x * (5.0f * z * z - 1.0f);
+    destination[14] = 0.5f * b * z * (x * x - y * y);
+    destination[15] = a * x * (x * x - 3.0f * y * y);
+}
+
+void AmbisonicEncoder::process(const float* lineGains, int nrLines, float* const* outputs, int numChannels,
+                               int numSamples) {
+    numChannels = jmin(numChannels, getNumChannels());
+    nrLines = jmin(nrLines, (int)maxLines);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        FloatVectorOperations::clear(outputs[ch], numSamples);
+
+    for (int i = 0; i < nrLines; ++i) {
+        const float* line = lineBlock.data() + (size_t)i * blockSize;
+        for (int ch = 0; ch < numChannels; ++ch)
+            FloatVectorOperations::addWithMultiply(outputs[ch], line, lineGains[i] * shGains[i][ch], numSamples);
+    }
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    AmbisonicEncoder.h
+    Created: 20 Oct 2026 1:52:38am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Encodes the delay line outputs of the FDN to ambisonics (ACN order, SN3D),
+// up to third order. Every line is given a fixed direction, taken from a low
+// discrepancy sequence so that the first N lines cover the sphere evenly for
+// any order of the FDN. The FDN writes its filtered line outputs into the
+// block buffer sample by sample, and at the end of the block every output
+// channel is built with one vectorised multiply-add per line.
+class AmbisonicEncoder {
+
+public:
+
+    AmbisonicEncoder();
+    ~AmbisonicEncoder();
+
+    // message thread, 0 switches the encoder off
+    void prepare(int ambisonicOrder, int maxBlockSize);
+
+    int getOrder() const { return order; }
+    int getNumChannels() const { return (order + 1) * (order + 1); }
+    int getBlockSize() const { return blockSize; }
+
+    // the FDN writes line i of sample n to getLineBuffer()[i * getBlockSize() + n]
+    float* getLineBuffer() { return lineBlock.data(); }
+
+    // lineGains weight the lines the way cGains do for the stereo output
+    void process(const float* lineGains, int nrLines, float* const* outputs, int numChannels, int numSamples);
+
+    float getAzimuth(int line) const;
+    float getElevation(int line) const;
+
+    // real spherical harmonics up to the given order in ACN order with SN3D normalisation
+    static void evaluate(int order, float azimuth, float elevation, float* destination);
+
+    enum
+    {
+        maxOrder = 3,
+        maxChannels = 16,
+        maxLines = 32,
+    };
+
+private:
+
+    int order = 0;
+    int blockSize = 0;
+    float shGains[maxLines][maxChannels] = {};
+    std::vector<float> lineBlock;
+};
@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    BarView.cpp
+    Created: 20 Oct 2026 2:58:44pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "BarView.h"
+
+BarView::BarView(const String& barName, Colour colour) : name(barName), barColour(colour) {
+    setOpaque(true);
+}
+
+BarView::~BarView() {}
+
+void BarView::setValues(const float* newValues, int numValues, uint32 version) {
+    if (version == shownVersion && numValues == (int)values.size())
+        return;
+
+    shownVersion = version;
+    values.assign(newValues, newValues + numValues);
+    imageChanged = true;
+    repaint();
+}
+
+void BarView::setValues(const int* newValues, int numValues, uint32 version) {
+    if (version == shownVersion && numValues == (int)values.size())
+        return;
+
+    shownVersion = version;
+    values.resize(numValues);
+    for (int i = 0; i < numValues; ++i)
+        values[i] = (float)newValues[i];
+    imageChanged = true;
+    repaint();
+}
+
+void BarView::resized() {
+    imageChanged = true;
+}
+
+void BarView::renderImage() {
+    imageChanged = false;
+    const int width = getWidth(), height = getHeight();
+    if (width <= 0 || height <= 0) {
+        image = Image();
+        return;
+    }
+
+    if (image.isNull() || image.getWidth() != width || image.getHeight() != height)
+        image = Image(Image::RGB, width, height, false);
+
+    Graphics g(image);
+    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+
+    float range = 0.0f;
+    bool bipolar = false;
+    for (const float value : values) {
+        range = jmax(range, std::abs(value));
+        bipolar = bipolar || value < 0.0f;
+    }
+
+    // the top line holds the name and the largest value
+    const int top = 14;
+    const float plotHeight = (float)(height - top);
+    const float zero = bipolar ? top + 0.5f * plotHeight : (float)height;
+    const float scale = range > 0.0f ? (bipolar ? 0.5f : 1.0f) * plotHeight / range : 0.0f;
+
+    g.setColour(Colours::darkgrey);
+    g.drawHorizontalLine((int)zero - (bipolar ? 0 : 1), 0.0f, (float)width);
+
+    if (!values.empty()) {
+        const float barWidth = (float)width / values.size();
+        const float gap = barWidth > 4.0f ? 1.0f : 0.0f;
+        g.setColour(barColour);
+        for (size_t i = 0; i < values.size(); ++i) {
+            const float barHeight = values[i] * scale;
+            const float y = barHeight >= 0.0f ? zero - barHeight : zero;
+            g.fillRect(i * barWidth, y, barWidth - gap, std::abs(barHeight));
+        }
+    }
+
+    g.setColour(Colours::ghostwhite);
+    g.setFont(Font("Arial", 10.f, Font::plain));
+    g.drawText(name + "  (max " + String(range, range >= 100.0f ? 0 : 3) + ")", 2, 0, width - 4, top, Justification::centredLeft);
+}
+
+void BarView::paint(Graphics& g) {
+    if (imageChanged)
+        renderImage();
+
+    if (image.isNull())
+        g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+    else
+        g.drawImageAt(image, 0, 0);
+}
@@ -0,0 +1,43 @@
+/*
+  ==============================================================================
+
+    BarView.h
+    Created: 20 Oct 2026 2:58:44pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// One bar per delay line, for the B and C gains or the delay lengths. The bars
+// go both ways from a centre line as soon as a value is negative. They are
+// drawn into an image the size of the component, which is only drawn again
+// when values with a new version come in or the component changes size.
+class BarView : public juce::Component {
+
+public:
+
+    BarView(const String& name, Colour barColour);
+    ~BarView() override;
+
+    // message thread, ignored if the version is the one shown
+    void setValues(const float* values, int numValues, uint32 version);
+    void setValues(const int* values, int numValues, uint32 version);
+
+    void paint(Graphics& g) override;
+    void resized() override;
+
+private:
+
+    void renderImage();
+
+    String name;
+    Colour barColour;
+    std::vector<float> values;
+    uint32 shownVersion = 0;
+    bool imageChanged = false;
+    Image image;
+};
@@ -0,0 +1,207 @@
+/*
+  ==============================================================================
+
+    CompressedDelayLine.cpp
+    Created: 20 Oct 2026 12:31:05am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "CompressedDelayLine.h"
+
+CompressedDelayLine::CompressedDelayLine(int maxDelayInSamples, Format storageFormat) : format(storageFormat) {
+    setMaximumDelayInSamples(maxDelayInSamples);
+}
+
+void CompressedDelayLine::setMaximumDelayInSamples(int maxDelayInSamples) {
+    jassert(maxDelayInSamples >= 0);
+    // room for the three samples the interpolation reads past the delay
+    totalSize = jmax(4, maxDelayInSamples + 3);
+    if (numChannels > 0)
+        prepare({ 44100.0, 0, (uint32)numChannels });
+}
+
+void CompressedDelayLine::prepare(const dsp::ProcessSpec& spec) {
+    numChannels = (int)spec.numChannels;
+    const size_t size = (size_t)numChannels * (size_t)totalSize;
+
+    // only one of the buffers is used, the other one is given back
+    if (format == float32) {
+        floatData.assign(size, 0.0f);
+        std::vector<uint16>().swap(compressedData);
+    } else {
+        compressedData.assign(size, 0);
+        std::vector<float>().swap(floatData);
+    }
+    writePos.assign(numChannels, 0);
+    readPos.assign(numChannels, 0);
+}
+
+void CompressedDelayLine::reset() {
+    std::fill(floatData.begin(), floatData.end(), 0.0f);
+    std::fill(compressedData.begin(), compressedData.end(), 0);
+    std::fill(writePos.begin(), writePos.end(), 0);
+    std::fill(readPos.begin(), readPos.end(), 0);
+}
+
+// the Lagrange interpolation reads one sample before the delay, so whole
+// delays of 1 and up are read from one sample further back
+void CompressedDelayLine::setDelay(float newDelay) {
+    delay = jlimit(0.0f, (float)getMaximumDelayInSamples(), newDelay);
+    delayInt = (int)std::floor(delay);
+    delayFrac = delay - (float)delayInt;
+
+    if (delayInt >= 1) {
+        delayFrac++;
+        delayInt--;
+    }
+}
+
+void CompressedDelayLine::pushSample(int channel, float sample) {
+    const int index = channel * totalSize + writePos[channel];
+    switch (format) {
+        case float32:   floatData[index] = sample; break;
+        case float16:   compressedData[index] = toHalf(sample); break;
+        case bfloat16:  compressedData[index] = toBFloat16(sample); break;
+    }
+    writePos[channel] = (writePos[channel] + totalSize - 1) % totalSize;
+}
+
+float CompressedDelayLine::popSample(int channel) {
+    const float result = interpolate(channel, readPos[channel] + delayInt, delayFrac);
+    readPos[channel] = (readPos[channel] + totalSize - 1) % totalSize;
+    return result;
+}
+
+float CompressedDelayLine::readSample(int channel, float delayInSamples) const {
+    const float tapDelay = jlimit(0.0f, (float)getMaximumDelayInSamples(), delayInSamples);
+    int tapInt = (int)std::floor(tapDelay);
+    float tapFrac = tapDelay - (float)tapInt;
+
+    if (tapInt >= 1) {
+        tapFrac++;
+        tapInt--;
+    }
+
+    // the write position has already moved past the last pushed sample
+    return interpolate(channel, writePos[channel] + 1 + tapInt, tapFrac);
+}
+
+float CompressedDelayLine::interpolate(int channel, int index1, float frac) const {
+    int index2 = index1 + 1;
+    int index3 = index2 + 1;
+    int index4 = index3 + 1;
+
+    if (index4 >= totalSize) {
+        index1 %= totalSize;
+        index2 %= totalSize;
+        index3 %= totalSize;
+        index4 %= totalSize;
+    }
+
+    const int offset = channel * totalSize;
+    float value1, value2, value3, value4;
+    switch (format) {
+        case float16: {
+            const uint16* samples = compressedData.data() + offset;
+            value1 = fromHalf(samples[index1]);
+            value2 = fromHalf(samples[index2]);
+            value3 = fromHalf(samples[index3]);
+            value4 = fromHalf(samples[index4]);
+            break;
+        }
+        case bfloat16: {
+            const uint16* samples = compressedData.data() + offset;
+            value1 = fromBFloat16(samples[index1]);
+            value2 = fromBFloat16(samples[index2]);
+            value3 = fromBFloat16(samples[index3]);
+            value4 = fromBFloat16(samples[index4]);
+            break;
+        }
+        default: {
+            const float* samples = floatData.data() + offset;
+            value1 = samples[index1];
+            value2 = samples[index2];
+            value3 = samples[index3];
+            value4 = samples[index4];
+            break;
+        }
+    }
+
+    const float d1 = frac - 1.0f;
+    const float d2 = frac - 2.0f;
+    const float d3 = frac - 3.0f;
+
+    const float c1 = -d1 * d2 * d3 / 6.0f;
+    const float c2 = d2 * d3 * 0.5f;
+    const float c3 = -d1 * d3 * 0.5f;
+    const float c4 = d1 * d2 / 6.0f;
+
+    return value1 * c1 + frac * (value2 * c2 + value3 * c3 + value4 * c4);
+}
+
+size_t CompressedDelayLine::getNumBytes() const {
+    return floatData.size() * sizeof(float) + compressedData.size() * sizeof(uint16);
+}
+
+const char* CompressedDelayLine::getFormatName(Format format) {
+    switch (format) {
+        case float16:   return "half";
+        case bfloat16:  return "bfloat16";
+        default:        return "float";
+    }
+}
+
+// Rounds to nearest even. Anything past the largest half (65504), including
+// NaN, is clamped to it rather than turned into inf, the blow-up check of the
+// plugin still sees the energy.
+uint16 CompressedDelayLine::toHalf(float x) {
+    uint32 bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    const uint16 sign = (uint16)((bits >> 16) & 0x8000);
+    const float magnitude = std::abs(x);
+
+    if (!(magnitude < 65504.0f))
+        return sign | 0x7bff;
+
+    // subnormal, in steps of 2^-24
+    if (magnitude < 6.103515625e-05f)
+        return sign | (uint16)roundToInt(magnitude * 16777216.0f);
+
+    std::memcpy(&bits, &magnitude, sizeof(bits));
+    bits += 0x0fff + ((bits >> 13) & 1);
+    return sign | (uint16)((bits - 0x38000000) >> 13);    // exponent bias 127 -> 15
+}
+
+float CompressedDelayLine::fromHalf(uint16 h) {
+    const uint32 sign = (uint32)(h & 0x8000) << 16;
+    const uint32 exponent = h & 0x7c00;
+    const uint32 mantissa = h & 0x03ff;
+
+    if (exponent == 0) {
+        const float value = mantissa * 5.9604644775390625e-08f;     // 2^-24
+        return sign != 0 ? -value : value;
+    }
+
+    const uint32 bits = sign | ((exponent + 0x1c000) << 13) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint16 CompressedDelayLine::toBFloat16(float x) {
+    uint32 bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    if ((bits & 0x7f800000) == 0x7f800000)
+        return (uint16)((bits >> 16) | ((bits & 0xffff) != 0 ? 0x40 : 0));    // keeps inf, NaN stays NaN
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (uint16)(bits >> 16);
+}
+
+float CompressedDelayLine::fromBFloat16(uint16 b) {
+    const uint32 bits = (uint32)b << 16;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    CompressedDelayLine.h
+    Created: 20 Oct 2026 12:31:05am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Delay line with the same behaviour as dsp::DelayLine with Lagrange3rd
+// interpolation, which can keep its samples as 16 bit floats. IEEE half keeps
+// 11 bits of mantissa and flushes below 6e-8 (-144 dB), bfloat16 keeps the
+// float range with 8 bits of mantissa. Either halves the memory the FDN loop
+// walks through every sample, at the cost of a little noise in the tail.
+class CompressedDelayLine {
+
+public:
+
+    enum Format
+    {
+        float32,
+        float16,
+        bfloat16,
+    };
+
+    CompressedDelayLine(int maxDelayInSamples = 0, Format storageFormat = float32);
+
+    void setMaximumDelayInSamples(int maxDelayInSamples);
+    int getMaximumDelayInSamples() const { return totalSize - 3; }
+
+    void prepare(const dsp::ProcessSpec& spec);
+    void reset();
+
+    void setDelay(float newDelay);
+    float getDelay() const { return delay; }
+
+    void pushSample(int channel, float sample);
+    float popSample(int channel);
+
+    // any delay counted from the last pushed sample, the read position stays where it is
+    float readSample(int channel, float delayInSamples) const;
+
+    Format getFormat() const { return format; }
+    size_t getNumBytes() const;
+
+    static const char* getFormatName(Format format);
+
+    static uint16 toHalf(float x);
+    static float fromHalf(uint16 h);
+    static uint16 toBFloat16(float x);
+    static float fromBFloat16(uint16 b);
+
+private:
+
+    float interpolate(int channel, int index1, float frac) const;
+
+    Format format;
+    std::vector<float> floatData;
+    std::vector<uint16> compressedData;     // both one channel after the other
+    std::vector<int> writePos, readPos;
+    int totalSize = 4;
+    int numChannels = 0;
+
+    float delay = 0.0f, delayFrac = 0.0f;
+    int delayInt = 0;
+};
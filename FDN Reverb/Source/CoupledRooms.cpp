@@ -0,0 +1,297 @@
+/*
+  ==============================================================================
+
+    CoupledRooms.cpp
+    Created: 19 Oct 2026 4:21:45pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "CoupledRooms.h"
+
+CoupledRooms::CoupledRooms() {
+    // every further room is larger and more reverberant than the one before
+    for (int r = 0; r < maxRooms; ++r) {
+        rooms[r].lowT60 = 1.0f + 1.5f * r;
+        rooms[r].highT60 = 0.5f + 0.75f * r;
+        rooms[r].lowDelayMs = 5.0f + 10.0f * r;
+        rooms[r].highDelayMs = 20.0f + 25.0f * r;
+        settings.lowT60[r] = rooms[r].lowT60;
+        settings.highT60[r] = rooms[r].highT60;
+    }
+    pendingSettings = settings;
+    std::fill(couplingMatrix, couplingMatrix + maxRooms * maxRooms, 0.0f);
+    std::fill(pendingCouplingMatrix, pendingCouplingMatrix + maxRooms * maxRooms, 0.0f);
+}
+
+CoupledRooms::~CoupledRooms() {}
+
+void CoupledRooms::init(float sampleRate, int nrDel, int nrRms) {
+    Fs = sampleRate;
+    nrRooms = jlimit(1, (int)maxRooms, nrRms);
+    nrDelayLines = jmax(nrRooms, nrDel);
+
+    delayLength.resize(nrDelayLines);
+    for (int r = 0; r < nrRooms; ++r) {
+        rooms[r].first = (r * nrDelayLines) / nrRooms;
+        rooms[r].size = ((r + 1) * nrDelayLines) / nrRooms - rooms[r].first;
+        findDelays(rooms[r]);
+    }
+
+    // a line of length d only needs d samples: each position is read before it is written
+    lineOffset.resize(nrDelayLines);
+    int total = 0;
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lineOffset[i] = total;
+        total += delayLength[i];
+    }
+    delayBuffer.assign(total, 0.0f);
+    writePos.assign(nrDelayLines, 0);
+    lineOutput.assign(nrDelayLines, 0.0f);
+
+    lowShelf.reset(new Filter[nrDelayLines]);
+    highShelf.reset(new Filter[nrDelayLines]);
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lowShelf[i].reset(Fs);
+        highShelf[i].reset(Fs);
+    }
+
+    bGains.assign(nrDelayLines, 0.0f);
+    cGainsLeft.assign(nrDelayLines, 0.0f);
+    cGainsRight.assign(nrDelayLines, 0.0f);
+
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingLowShelf.resize(nrDelayLines);
+    pendingHighShelf.resize(nrDelayLines);
+    pendingSettings.sourceRoom = jmin(pendingSettings.sourceRoom, nrRooms - 1);
+    pendingSettings.listenerRoom = jmin(pendingSettings.listenerRoom, nrRooms - 1);
+
+    designGains();
+    designFilters();
+    designCouplingMatrix();
+
+    // nothing runs the rooms while they are set up, so the design is taken over right away
+    takePendingSettings();
+}
+
+void CoupledRooms::reset() {
+    std::fill(delayBuffer.begin(), delayBuffer.end(), 0.0f);
+    std::fill(writePos.begin(), writePos.end(), 0);
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lowShelf[i].clear();
+        highShelf[i].clear();
+    }
+}
+
+void CoupledRooms::setRoomDelay(int room, float lowDelayMs, float highDelayMs) {
+    if (room < 0 || room >= maxRooms)
+        return;
+    rooms[room].lowDelayMs = jlimit(1.0f, (float)maxDelayMs, jmin(lowDelayMs, highDelayMs));
+    rooms[room].highDelayMs = jlimit(1.0f, (float)maxDelayMs, jmax(lowDelayMs, highDelayMs));
+}
+
+void CoupledRooms::setCoupling(float newCoupling) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingSettings.coupling = jlimit(0.0f, 1.0f, newCoupling);
+    designCouplingMatrix();
+    settingsChanged = true;
+}
+
+void CoupledRooms::setRoomT60(int room, float lowT60, float highT60) {
+    if (room < 0 || room >= maxRooms)
+        return;
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingSettings.lowT60[room] = lowT60;
+    pendingSettings.highT60[room] = highT60;
+    designFilters();
+    settingsChanged = true;
+}
+
+void CoupledRooms::setTransitionFrequencies(float l_fT, float h_fT) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingSettings.lowTransFreq = l_fT;
+    pendingSettings.highTransFreq = h_fT;
+    designFilters();
+    settingsChanged = true;
+}
+
+void CoupledRooms::setSourceRoom(int room) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingSettings.sourceRoom = jlimit(0, nrRooms - 1, room);
+    designGains();
+    settingsChanged = true;
+}
+
+void CoupledRooms::setListenerRoom(int room) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingSettings.listenerRoom = jlimit(0, nrRooms - 1, room);
+    designGains();
+    settingsChanged = true;
+}
+
+void CoupledRooms::findDelays(const Room& room) {
+    // primes spread evenly over the delay range of the room
+    const int LR = jmax(2, (int)(room.lowDelayMs * Fs / 1000.0));
+    const int UR = jmax(LR, (int)(room.highDelayMs * Fs / 1000.0));
+
+    std::vector<int> primes;
+    int i = LR;
+    while ((int)primes.size() < room.size || i <= UR) {
+        bool prime = true;
+        for (int k = 2; k * k <= i; ++k) {
+            if (i % k == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime)
+            primes.push_back(i);
+        ++i;
+    }
+
+    const double step = (double)primes.size() / room.size;
+    for (int n = 0; n < room.size; ++n) {
+        delayLength[room.first + n] = primes[(size_t)(n * step)];
+    }
+}
+
+void CoupledRooms::applyPendingSettings() {
+    const SpinLock::ScopedTryLockType lock(settingsLock);
+    if (!lock.isLocked() || !settingsChanged)
+        return;
+
+    takePendingSettings();
+}
+
+// only copies, everything has been designed by the setters
+void CoupledRooms::takePendingSettings() {
+    settings = pendingSettings;
+    settingsChanged = false;
+
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lowShelf[i].setCoefficients(pendingLowShelf[i]);
+        highShelf[i].setCoefficients(pendingHighShelf[i]);
+    }
+    std::copy(pendingBGains.begin(), pendingBGains.end(), bGains.begin());
+    std::copy(pendingCGainsLeft.begin(), pendingCGainsLeft.end(), cGainsLeft.begin());
+    std::copy(pendingCGainsRight.begin(), pendingCGainsRight.end(), cGainsRight.begin());
+    std::copy(pendingCouplingMatrix, pendingCouplingMatrix + maxRooms * maxRooms, couplingMatrix);
+}
+
+void CoupledRooms::designFilters() {
+    for (int r = 0; r < nrRooms; ++r) {
+        for (int i = rooms[r].first; i < rooms[r].first + rooms[r].size && i < (int)pendingLowShelf.size(); ++i) {
+            pendingLowShelf[i] = Filter::makeLowShelf(pendingSettings.lowT60[r], pendingSettings.lowTransFreq, delayLength[i], Fs);
+            pendingHighShelf[i] = Filter::makeHighShelf(pendingSettings.highT60[r], pendingSettings.highTransFreq, delayLength[i], Fs);
+        }
+    }
+}
+
+// M = G(0,1) G(1,2) ... G(R-2,R-1), each a Givens rotation by coupling * pi/4.
+// Only M - I is stored, which is what C adds to the room means.
+void CoupledRooms::designCouplingMatrix() {
+    const float angle = pendingSettings.coupling * MathConstants<float>::pi * 0.25f;
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+
+    float M[maxRooms * maxRooms] = {};
+    for (int r = 0; r < nrRooms; ++r)
+        M[r * maxRooms + r] = 1.0f;
+
+    for (int r = 0; r + 1 < nrRooms; ++r) {
+        for (int col = 0; col < nrRooms; ++col) {
+            const float a = M[r * maxRooms + col];
+            const float b = M[(r + 1) * maxRooms + col];
+            M[r * maxRooms + col] = c * a + s * b;
+            M[(r + 1) * maxRooms + col] = -s * a + c * b;
+        }
+    }
+
+    for (int r = 0; r < maxRooms; ++r)
+        for (int col = 0; col < maxRooms; ++col)
+            pendingCouplingMatrix[r * maxRooms + col] = M[r * maxRooms + col] - (r == col ? 1.0f : 0.0f);
+}
+
+// The input only excites the lines of the source room, and only the lines of
+// the listener room are heard.
+void CoupledRooms::designGains() {
+    Random random(2468);
+    pendingBGains.assign(nrDelayLines, 0.0f);
+    pendingCGainsLeft.assign(nrDelayLines, 0.0f);
+    pendingCGainsRight.assign(nrDelayLines, 0.0f);
+
+    const Room& source = rooms[pendingSettings.sourceRoom];
+    const Room& listener = rooms[pendingSettings.listenerRoom];
+    const float sourceNorm = 1.0f / std::sqrt((float)source.size);
+    const float listenerNorm = 1.0f / std::sqrt((float)listener.size);
+
+    for (int i = source.first; i < source.first + source.size; ++i) {
+        pendingBGains[i] = (random.nextFloat() * 2.0f - 1.0f) * sourceNorm;
+    }
+    for (int i = listener.first; i < listener.first + listener.size; ++i) {
+        pendingCGainsLeft[i] = (random.nextFloat() * 2.0f - 1.0f) * listenerNorm;
+        pendingCGainsRight[i] = (random.nextFloat() * 2.0f - 1.0f) * listenerNorm;
+    }
+}
+
+void CoupledRooms::applyFeedbackMatrix(float* v) {
+    // blockdiag(H_r): subtract twice the mean of every room from its lines.
+    // Afterwards the sum over a room is minus what it was before.
+    for (int r = 0; r < nrRooms; ++r) {
+        float* line = v + rooms[r].first;
+        const int n = rooms[r].size;
+        float sum = 0.0f;
+        for (int i = 0; i < n; ++i)
+            sum += line[i];
+        FloatVectorOperations::add(line, -2.0f * sum / n, n);
+        roomMean[r] = -sum / std::sqrt((float)n);
+    }
+
+    if (nrRooms == 1)
+        return;
+
+    // C = I + E (M - I) E^T
+    for (int r = 0; r < nrRooms; ++r) {
+        float q = 0.0f;
+        for (int col = 0; col < nrRooms; ++col)
+            q += couplingMatrix[r * maxRooms + col] * roomMean[col];
+        FloatVectorOperations::add(v + rooms[r].first, q / std::sqrt((float)rooms[r].size), rooms[r].size);
+    }
+}
+
+void CoupledRooms::processBlock(const float* input, float* outLeft, float* outRight, int numSamples) {
+    if (nrDelayLines == 0) {
+        FloatVectorOperations::clear(outLeft, numSamples);
+        FloatVectorOperations::clear(outRight, numSamples);
+        return;
+    }
+
+    applyPendingSettings();
+
+    float* y = lineOutput.data();
+    const Room& listener = rooms[settings.listenerRoom];
+
+    for (int n = 0; n < numSamples; ++n) {
+        for (int i = 0; i < nrDelayLines; ++i) {
+            y[i] = highShelf[i].processSample(lowShelf[i].processSample(delayBuffer[lineOffset[i] + writePos[i]]));
+        }
+
+        float left = 0.0f, right = 0.0f;
+        for (int i = listener.first; i < listener.first + listener.size; ++i) {
+            left += cGainsLeft[i] * y[i];
+            right += cGainsRight[i] * y[i];
+        }
+        outLeft[n] = left;
+        outRight[n] = right;
+
+        applyFeedbackMatrix(y);
+
+        const float x = input[n];
+        for (int i = 0; i < nrDelayLines; ++i) {
+            delayBuffer[lineOffset[i] + writePos[i]] = y[i] + bGains[i] * x;
+            if (++writePos[i] == delayLength[i])
+                writePos[i] = 0;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    CoupledRooms.h
+    Created: 19 Oct 2026 4:21:45pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Filter.h"
+
+// R coupled rooms, each a small FDN with its own T60s and delay range. The
+// feedback matrix is
+//
+//     A = C * blockdiag(H_1, ..., H_R),    C = I + E (M - I) E^T
+//
+// where H_r is a Householder matrix over the lines of room r, the columns of E
+// are the normalised all-ones vectors of the rooms and M is an R x R rotation
+// set by the coupling. C only moves energy between the mean components of the
+// rooms, so A is orthogonal and costs O(N + R^2) per sample instead of O(N^2).
+// With the source and the listener in different rooms, or a short room coupled
+// to a long one, the decay gets the double slope of connected spaces.
+class CoupledRooms {
+
+public:
+
+    CoupledRooms();
+    ~CoupledRooms();
+
+    // allocates, message thread only
+    void init(float sampleRate, int nrDel, int nrRooms);
+    void setRoomDelay(int room, float lowDelayMs, float highDelayMs);
+
+    void reset();
+
+    // designed here and picked up by the audio thread at the start of the next block
+    void setCoupling(float newCoupling);
+    void setRoomT60(int room, float lowT60, float highT60);
+    void setTransitionFrequencies(float l_fT, float h_fT);
+    void setSourceRoom(int room);
+    void setListenerRoom(int room);
+
+    int getNrRooms() const { return nrRooms; }
+
+    void processBlock(const float* input, float* outLeft, float* outRight, int numSamples);
+
+    enum
+    {
+        maxRooms = 4,
+        maxDelayMs = 200,
+    };
+
+private:
+
+    struct Room {
+        float lowT60 = 1.f;
+        float highT60 = 0.5f;
+        float lowDelayMs = 5.f;
+        float highDelayMs = 20.f;
+        int first = 0;      // first line of the room
+        int size = 0;
+    };
+
+    struct Settings {
+        float coupling = 0.3f;
+        float lowT60[maxRooms];
+        float highT60[maxRooms];
+        float lowTransFreq = 400.f;
+        float highTransFreq = 2500.f;
+        int sourceRoom = 0;
+        int listenerRoom = 0;
+    };
+
+    void findDelays(const Room& room);
+    void applyPendingSettings();
+    void takePendingSettings();
+
+    // fill the pending coefficients from pendingSettings, the caller holds settingsLock
+    void designFilters();
+    void designCouplingMatrix();
+    void designGains();
+
+    void applyFeedbackMatrix(float* v);
+
+    Room rooms[maxRooms];
+    int nrRooms = 1;
+    int nrDelayLines = 0;
+    float Fs = 44100.f;
+
+    Settings settings, pendingSettings;
+    bool settingsChanged = false;
+    SpinLock settingsLock;
+
+    std::vector<int> delayLength;
+    std::vector<int> lineOffset;
+    std::vector<int> writePos;
+    std::vector<float> delayBuffer;
+    std::vector<float> lineOutput;
+
+    std::vector<float> bGains;
+    std::vector<float> cGainsLeft;
+    std::vector<float> cGainsRight;
+
+    std::unique_ptr<Filter[]> lowShelf;
+    std::unique_ptr<Filter[]> highShelf;
+
+    float couplingMatrix[maxRooms * maxRooms];     // M - I, row-major
+    float roomMean[maxRooms];
+
+    // what the audio thread copies in applyPendingSettings()
+    std::vector<Filter::Coefficients> pendingLowShelf;
+    std::vector<Filter::Coefficients> pendingHighShelf;
+    std::vector<float> pendingBGains;
+    std::vector<float> pendingCGainsLeft;
+    std::vector<float> pendingCGainsRight;
+    float pendingCouplingMatrix[maxRooms * maxRooms];
+};
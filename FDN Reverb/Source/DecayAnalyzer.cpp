@@ -0,0 +1,270 @@
+/*
+  ==============================================================================
+
+    DecayAnalyzer.cpp
+    Created: 20 Oct 2026 11:03:27am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "DecayAnalyzer.h"
+
+namespace {
+    const float silenceThreshold = 1.0e-4f;     // -80 dBFS
+    const double minSeconds = 0.5;              // shorter pauses in the input are ignored
+}
+
+DecayAnalyzer::DecayAnalyzer() : juce::Thread("FDN Decay Analyzer") {
+    for (auto& target : targets)
+        target = 0.0f;
+}
+
+DecayAnalyzer::~DecayAnalyzer() {
+    stop();
+}
+
+void DecayAnalyzer::prepare(double sampleRate, int maxBlockSize) {
+    const bool wasRunning = running.load();
+    stop();
+    Fs = sampleRate;
+
+    // the worker reads every 20 ms, a second of room also covers an analysis
+    const int fifoSize = (int)Fs + 2 * maxBlockSize;
+    fifo.setTotalSize(fifoSize);
+    inputFifo.assign(fifoSize, 0.0f);
+    outputFifo.assign(fifoSize, 0.0f);
+
+    // the band filters ring for a few ms, the padding keeps that from wrapping around
+    decay.assign((size_t)(maxSeconds * Fs), 0.0f);
+    const int fftSize = nextPowerOfTwo((int)decay.size() + (int)(0.1 * Fs));
+    spectrum.assign(2 * fftSize, 0.0f);
+    band.assign(2 * fftSize, 0.0f);
+    fft.reset();
+
+    decayLength = 0;
+    inputPlayed = false;
+    recording = false;
+    windowLength = jmax(1, (int)(0.01 * Fs));
+
+    if (wasRunning)
+        start();
+}
+
+void DecayAnalyzer::start() {
+    if (isThreadRunning())
+        return;
+    recording = false;
+    inputPlayed = false;
+    startThread(2);
+    running = true;
+}
+
+void DecayAnalyzer::stop() {
+    running = false;
+    stopThread(1000);
+}
+
+void DecayAnalyzer::pushInput(const float* input, int numSamples) {
+    reservedSize1 = reservedSize2 = 0;
+    if (!running.load())
+        return;
+
+    // a block that does not fit is dropped whole, the worker starts over after it
+    if (fifo.getFreeSpace() < numSamples) {
+        overflowed = true;
+        return;
+    }
+
+    fifo.prepareToWrite(numSamples, reservedStart1, reservedSize1, reservedStart2, reservedSize2);
+    FloatVectorOperations::copy(inputFifo.data() + reservedStart1, input, reservedSize1);
+    FloatVectorOperations::copy(inputFifo.data() + reservedStart2, input + reservedSize1, reservedSize2);
+}
+
+void DecayAnalyzer::pushOutput(const float* output, int numSamples) {
+    // the reader only sees the block after finishedWrite(), so the input and output go in together
+    if (reservedSize1 + reservedSize2 != numSamples || numSamples == 0)
+        return;
+
+    FloatVectorOperations::copy(outputFifo.data() + reservedStart1, output, reservedSize1);
+    FloatVectorOperations::copy(outputFifo.data() + reservedStart2, output + reservedSize1, reservedSize2);
+    fifo.finishedWrite(numSamples);
+    reservedSize1 = reservedSize2 = 0;
+}
+
+void DecayAnalyzer::setTarget(int band, float t60) {
+    if (band >= 0 && band < nrBands)
+        targets[band] = t60;
+}
+
+DecayAnalyzer::Result DecayAnalyzer::getResult() {
+    const SpinLock::ScopedLockType lock(resultLock);
+    return result;
+}
+
+void DecayAnalyzer::run() {
+    // whatever was left from before the last stop() is not part of this run
+    fifo.finishedRead(fifo.getNumReady());
+    overflowed = false;
+
+    while (!threadShouldExit()) {
+        int ready;
+        while ((ready = fifo.getNumReady()) > 0 && !threadShouldExit()) {
+            if (overflowed.exchange(false)) {
+                recording = false;
+                inputPlayed = false;
+            }
+
+            int start1, size1, start2, size2;
+            fifo.prepareToRead(ready, start1, size1, start2, size2);
+            consume(inputFifo.data() + start1, outputFifo.data() + start1, size1);
+            consume(inputFifo.data() + start2, outputFifo.data() + start2, size2);
+            fifo.finishedRead(size1 + size2);
+        }
+        wait(20);
+    }
+}
+
+void DecayAnalyzer::consume(const float* input, const float* output, int numSamples) {
+    for (int n = 0; n < numSamples; ++n) {
+        if (std::abs(input[n]) >= silenceThreshold) {
+            // the input came back, what has been recorded so far is used if it is long enough
+            if (recording && decayLength >= minSeconds * Fs)
+                finishDecay();
+            recording = false;
+            inputPlayed = true;
+            continue;
+        }
+
+        if (!recording) {
+            if (!inputPlayed)
+                continue;
+            recording = true;
+            inputPlayed = false;
+            decayLength = 0;
+            windowEnergy = referenceEnergy = 0.0;
+            windowFill = windowsDone = 0;
+            for (int b = 0; b < nrBands; ++b)
+                decayTargets[b] = targets[b].load();
+        }
+
+        decay[decayLength++] = output[n];
+
+        // 10 ms windows, the loudest of the first 100 ms is the reference for the 50 dB
+        bool decayed = false;
+        windowEnergy += (double)output[n] * output[n];
+        if (++windowFill == windowLength) {
+            if (windowsDone < 10)
+                referenceEnergy = jmax(referenceEnergy, windowEnergy);
+            else
+                decayed = windowEnergy < referenceEnergy * 1.0e-5;
+            ++windowsDone;
+            windowEnergy = 0.0;
+            windowFill = 0;
+        }
+
+        if (decayed || decayLength == (int)decay.size()) {
+            finishDecay();
+            recording = false;
+        }
+    }
+}
+
+void DecayAnalyzer::finishDecay() {
+    // nothing to measure if the FDN was not playing
+    if (referenceEnergy < 1.0e-10 * windowLength)
+        return;
+
+    const int fftOrder = jmax(1, (int)std::ceil(std::log2((double)decayLength + 0.1 * Fs)));
+    const int fftSize = 1 << fftOrder;
+    jassert(2 * fftSize <= (int)spectrum.size());
+    if (fft == nullptr || fft->getSize() != fftSize)
+        fft.reset(new dsp::FFT(fftOrder));
+
+    std::fill(spectrum.begin(), spectrum.begin() + 2 * fftSize, 0.0f);
+    std::copy(decay.begin(), decay.begin() + decayLength, spectrum.begin());
+    fft->performRealOnlyForwardTransform(spectrum.data());
+
+    Result newResult;
+    for (int b = 0; b < nrBands; ++b) {
+        newResult.measured[b] = measureBand(b, fftSize);
+        newResult.target[b] = decayTargets[b];
+    }
+    newResult.seconds = (float)(decayLength / Fs);
+
+    const SpinLock::ScopedLockType lock(resultLock);
+    result = newResult;
+    ++resultCount;
+}
+
+// Octave band as a cos^2 window over log frequency, so neighbouring bands add
+// up to one. The band is brought back to the time domain and integrated
+// backwards from the end of the recording.
+float DecayAnalyzer::measureBand(int b, int fftSize) {
+    const double centre = getBandFrequency(b);
+    if (2.0 * centre >= 0.5 * Fs)
+        return 0.0f;
+
+    const double binWidth = Fs / fftSize;
+    for (int k = 0; k < fftSize; ++k) {
+        const double frequency = jmin(k, fftSize - k) * binWidth;
+        const double octaves = frequency > 0.0 ? std::log2(frequency / centre) : -2.0;
+        float weight = 0.0f;
+        if (std::abs(octaves) < 1.0) {
+            const double c = std::cos(0.5 * MathConstants<double>::pi * octaves);
+            weight = (float)(c * c);
+        }
+        band[2 * k] = spectrum[2 * k] * weight;
+        band[2 * k + 1] = spectrum[2 * k + 1] * weight;
+    }
+    fft->performRealOnlyInverseTransform(band.data());
+
+    // Schroeder integration in place, as energy left from each sample on
+    double energy = 0.0;
+    for (int n = decayLength - 1; n >= 0; --n) {
+        energy += (double)band[n] * band[n];
+        band[fftSize + n] = (float)energy;
+    }
+    const float* curve = band.data() + fftSize;
+    const double total = energy;
+    if (total <= 0.0)
+        return 0.0f;
+
+    int start = -1, end = -1;
+    for (int n = 0; n < decayLength; ++n) {
+        if (start < 0 && curve[n] <= total * 0.316227766)      // -5 dB
+            start = n;
+        if (curve[n] <= total * 0.00316227766) {                // -25 dB
+            end = n;
+            break;
+        }
+    }
+    if (start < 0 || end <= start)
+        return 0.0f;
+
+    // level at the end of the recording against the start of the fit, over 20 ms
+    const int window = jmin(end - start, (int)(0.02 * Fs));
+    double startLevel = 0.0, endLevel = 0.0;
+    for (int n = 0; n < window; ++n) {
+        startLevel += (double)band[start + n] * band[start + n];
+        endLevel += (double)band[decayLength - 1 - n] * band[decayLength - 1 - n];
+    }
+    if (endLevel > startLevel * 3.16227766e-4)                  // -35 dB
+        return 0.0f;
+
+    // least squares line through the curve in dB
+    double sumT = 0.0, sumL = 0.0, sumTT = 0.0, sumTL = 0.0;
+    const int count = end - start + 1;
+    for (int n = start; n <= end; ++n) {
+        const double t = (n - start) / Fs;
+        const double level = 10.0 * std::log10(curve[n] / total);
+        sumT += t;
+        sumL += level;
+        sumTT += t * t;
+        sumTL += t * level;
+    }
+    const double slope = (count * sumTL - sumT * sumL) / (count * sumTT - sumT * sumT);
+    if (slope >= 0.0)
+        return 0.0f;
+    return (float)(-60.0 / slope);
+}
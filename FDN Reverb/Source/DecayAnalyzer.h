@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    DecayAnalyzer.h
+    Created: 20 Oct 2026 11:03:27am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Measures the T60 of the running output in octave bands, to check the decay
+// the attenuation filters actually give against the one that was asked for.
+//
+// The audio thread only copies the input and the output of each block into a
+// FIFO. A worker reads it back and waits for the input to go silent after it
+// has been playing. From there the output is a free decay, which is recorded
+// until it has dropped 50 dB, the input comes back or maxSeconds is reached.
+// The recording is split into octave bands in the frequency domain, and each
+// band gets a Schroeder energy decay curve with a line fitted between -5 and
+// -25 dB (T20). A band only counts if its level at the end of the recording is
+// at least 35 dB below the start of the fit, otherwise the cut-off tail would
+// bend the curve.
+class DecayAnalyzer : private juce::Thread {
+
+public:
+
+    enum
+    {
+        nrBands = 7,        // 125 Hz to 8 kHz
+        maxSeconds = 8,
+    };
+
+    struct Result {
+        float measured[nrBands] = {};   // 0 if the band did not decay far enough
+        float target[nrBands] = {};     // as set when the decay started
+        float seconds = 0.0f;           // length of the recorded decay
+    };
+
+    DecayAnalyzer();
+    ~DecayAnalyzer() override;
+
+    // message thread, stops the worker and allocates for maxSeconds at the new rate
+    void prepare(double sampleRate, int maxBlockSize);
+
+    void start();
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+    // audio thread, the input of a block before it is processed and then the
+    // output of the same block, nothing is pushed while the worker is stopped
+    void pushInput(const float* input, int numSamples);
+    void pushOutput(const float* output, int numSamples);
+
+    // any thread, stored with the next decay that starts
+    void setTarget(int band, float t60);
+
+    // goes up by one with every decay that has been analysed
+    int getResultCount() const { return resultCount.load(); }
+    Result getResult();
+
+    static float getBandFrequency(int band) { return 125.0f * (float)(1 << band); }
+
+private:
+
+    void run() override;
+    void consume(const float* input, const float* output, int numSamples);
+    void finishDecay();
+    float measureBand(int band, int fftSize);
+
+    std::atomic<bool> running { false };
+
+    AbstractFifo fifo { 1 };
+    std::vector<float> inputFifo, outputFifo;
+    int reservedStart1 = 0, reservedSize1 = 0, reservedStart2 = 0, reservedSize2 = 0;  // audio thread
+    std::atomic<bool> overflowed { false };
+
+    // worker only
+    std::vector<float> decay;
+    int decayLength = 0;
+    bool inputPlayed = false;
+    bool recording = false;
+    double windowEnergy = 0.0, referenceEnergy = 0.0;
+    int windowFill = 0, windowsDone = 0, windowLength = 1;
+    float decayTargets[nrBands] = {};
+    std::unique_ptr<dsp::FFT> fft;
+    std::vector<float> spectrum, band;
+
+    std::atomic<float> targets[nrBands];
+
+    Result result;
+    SpinLock resultLock;
+    std::atomic<int> resultCount { 0 };
+
+    double Fs = 44100.0;
+};
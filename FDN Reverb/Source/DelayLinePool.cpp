@@ -0,0 +1,141 @@
+/*
+  ==============================================================================
+
+    DelayLinePool.cpp
+    Created: 19 Oct 2026 11:48:16pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "DelayLinePool.h"
+
+DelayLinePool::DelayLinePool() : juce::Thread("FDN Delay Allocator") {}
+
+DelayLinePool::~DelayLinePool() {
+    stopThread(1000);
+}
+
+void DelayLinePool::prepare(const dsp::ProcessSpec& newSpec, int maxDelaySamples, int nrLines,
+                            DelayLine::Format newFormat) {
+    jassert(nrLines <= maxLines);
+    stopThread(1000);
+
+    // the lines only depend on the number of channels, the longest delay and
+    // the storage format, if any of them has changed they are all built again
+    const bool sizeChanged = newSpec.numChannels != spec.numChannels || maxDelaySamples != maxDelay
+                          || newFormat != format;
+    spec = newSpec;
+    maxDelay = maxDelaySamples;
+    format = newFormat;
+
+    for (int i = 0; i < maxLines; ++i) {
+        if (sizeChanged)
+            lines[i].reset();
+        unusedSince[i] = 0;
+    }
+
+    nrRequested = nrLines;
+    allocateLines(nrLines);
+    nrInUse = nrLines;
+}
+
+void DelayLinePool::start() {
+    if (!isThreadRunning())
+        startThread(3);
+}
+
+void DelayLinePool::stop() {
+    stopThread(1000);
+}
+
+void DelayLinePool::request(int nrLines) {
+    nrRequested = jlimit(0, (int)maxLines, nrLines);
+
+    if (isThreadRunning())
+        notify();
+    else
+        allocateLines(nrRequested.load());
+}
+
+void DelayLinePool::allocate(int nrLines) {
+    nrRequested = jlimit(0, (int)maxLines, nrLines);
+    allocateLines(nrRequested.load());
+}
+
+size_t DelayLinePool::getNumBytes() {
+    const SpinLock::ScopedLockType lock(lineLock);
+    size_t bytes = 0;
+    for (auto& line : lines) {
+        if (line != nullptr)
+            bytes += line->getNumBytes();
+    }
+    return bytes;
+}
+
+bool DelayLinePool::tryUse(int nrLines) {
+    const SpinLock::ScopedTryLockType lock(lineLock);
+    if (!lock.isLocked())
+        return false;
+
+    for (int i = 0; i < nrLines; ++i) {
+        if (lines[i] == nullptr)
+            return false;
+    }
+    nrInUse = nrLines;
+    return true;
+}
+
+void DelayLinePool::run() {
+    while (!threadShouldExit()) {
+        allocateLines(nrRequested.load());
+        releaseUnusedLines();
+        wait(100);
+    }
+}
+
+// Built without the lock, a line that is already there by the time the new one
+// is ready (allocate() and the worker can race) is simply thrown away again.
+void DelayLinePool::allocateLines(int nrLines) {
+    for (int i = 0; i < nrLines; ++i) {
+        {
+            const SpinLock::ScopedLockType lock(lineLock);
+            if (lines[i] != nullptr)
+                continue;
+        }
+
+        std::unique_ptr<DelayLine> line(new DelayLine(maxDelay, format));
+        line->prepare(spec);
+
+        const SpinLock::ScopedLockType lock(lineLock);
+        if (lines[i] == nullptr)
+            lines[i] = std::move(line);
+    }
+}
+
+void DelayLinePool::releaseUnusedLines() {
+    const uint32 now = jmax((uint32)1, Time::getMillisecondCounter());
+
+    for (int i = 0; i < maxLines; ++i) {
+        if (i < nrRequested.load() || i < nrInUse.load()) {
+            unusedSince[i] = 0;
+            continue;
+        }
+        if (unusedSince[i] == 0) {
+            unusedSince[i] = now;
+            continue;
+        }
+        if (now - unusedSince[i] < (uint32)releaseDelayMs)
+            continue;
+
+        // the audio thread takes the lock to start using more lines, so with it
+        // held a line above the order in use can not be picked up any more
+        std::unique_ptr<DelayLine> released;
+        {
+            const SpinLock::ScopedLockType lock(lineLock);
+            if (i >= nrInUse.load() && i >= nrRequested.load())
+                released = std::move(lines[i]);
+        }
+        unusedSince[i] = 0;
+    }
+}
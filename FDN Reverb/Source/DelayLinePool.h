@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    DelayLinePool.h
+    Created: 19 Oct 2026 11:48:16pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CompressedDelayLine.h"
+
+// Delay lines of the FDN, allocated for the order in use rather than for
+// maxLines. A line holds maxDelaySamples for every channel, so this is where
+// almost all of the memory of an FDN goes.
+//
+// When the order grows, request() has the lines built by a worker and the
+// audio thread only switches to the new order once tryUse() finds them all
+// there. Lines above the order in use are kept for releaseDelayMs in case the
+// order goes back up, after that the worker frees them. Until start() is
+// called, request() allocates straight away.
+class DelayLinePool : private juce::Thread {
+
+public:
+
+    using DelayLine = CompressedDelayLine;
+
+    DelayLinePool();
+    ~DelayLinePool() override;
+
+    // stops the worker and allocates the first nrLines for the spec, start() it again afterwards
+    void prepare(const dsp::ProcessSpec& spec, int maxDelaySamples, int nrLines,
+                 DelayLine::Format format = DelayLine::float32);
+
+    void start();
+    void stop();
+
+    // message thread, the first nrLines are allocated in the background
+    void request(int nrLines);
+
+    // message thread, the first nrLines are allocated before this returns
+    void allocate(int nrLines);
+
+    // audio thread, false if the lines are not all there yet or the worker holds the lock
+    bool tryUse(int nrLines);
+
+    int getNrInUse() const { return nrInUse.load(); }
+
+    // message thread, memory of the lines that are allocated right now
+    size_t getNumBytes();
+
+    // only lines below getNrInUse() can be used
+    DelayLine& operator[](int index) { return *lines[index]; }
+    const DelayLine& operator[](int index) const { return *lines[index]; }
+
+    enum
+    {
+        maxLines = 32,
+        releaseDelayMs = 5000,
+    };
+
+private:
+
+    void run() override;
+    void allocateLines(int nrLines);
+    void releaseUnusedLines();
+
+    std::unique_ptr<DelayLine> lines[maxLines];
+    uint32 unusedSince[maxLines] = {};      // worker only, 0 while the line is wanted
+    std::atomic<int> nrInUse { 0 };
+    std::atomic<int> nrRequested { 0 };
+    SpinLock lineLock;
+
+    dsp::ProcessSpec spec { 44100.0, 512, 2 };
+    int maxDelay = 0;
+    DelayLine::Format format = DelayLine::float32;
+};
@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+    EarlyReflections.cpp
+    Created: 19 Oct 2026 1:26:07pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "EarlyReflections.h"
+
+EarlyReflections::EarlyReflections() {}
+
+EarlyReflections::~EarlyReflections() {}
+
+void EarlyReflections::prepare(double sampleRate, int numChannels, int maxBlockSize) {
+    Fs = sampleRate;
+    blockSize = jmax(1, maxBlockSize);
+
+    // power of two so the ring buffer can wrap with a mask
+    const int size = nextPowerOfTwo((int)(maxDelayMs * Fs / 1000.0) + blockSize + 1);
+    historyMask = size - 1;
+
+    history.assign(numChannels, std::vector<float>(size, 0.0f));
+    lowpassState.assign(numChannels, std::vector<float>(maxTaps, 0.0f));
+    writePos.assign(numChannels, 0);
+    tapBuffer.assign(blockSize, 0.0f);
+
+    if (nrTaps == 0 && pendingNrTaps == 0) {
+        setDefaultTaps(12);
+        return;
+    }
+
+    // the audio thread is stopped, so the running taps are converted as well
+    const SpinLock::ScopedLockType lock(tapLock);
+    for (int i = 0; i < maxTaps; ++i) {
+        updateTap(pendingTaps[i]);
+        updateTap(taps[i]);
+    }
+}
+
+void EarlyReflections::reset() {
+    for (auto& channel : history)
+        std::fill(channel.begin(), channel.end(), 0.0f);
+    for (auto& channel : lowpassState)
+        std::fill(channel.begin(), channel.end(), 0.0f);
+    std::fill(writePos.begin(), writePos.end(), 0);
+}
+
+void EarlyReflections::setNrTaps(int newNrTaps) {
+    const SpinLock::ScopedLockType lock(tapLock);
+    pendingNrTaps = jlimit(0, (int)maxTaps, newNrTaps);
+    tapsChanged = true;
+}
+
+void EarlyReflections::setTap(int index, float delayMs, float gain, float cutoffHz) {
+    if (index < 0 || index >= maxTaps)
+        return;
+
+    const SpinLock::ScopedLockType lock(tapLock);
+    auto& tap = pendingTaps[index];
+    tap.delayMs = delayMs;
+    tap.cutoffHz = cutoffHz;
+    tap.gain = gain;
+    updateTap(tap);
+
+    tapsChanged = true;
+}
+
+void EarlyReflections::updateTap(Tap& tap) const {
+    tap.delay = jlimit(0, (int)(maxDelayMs * Fs / 1000.0), (int)(tap.delayMs * Fs / 1000.0));
+
+    // one-pole lowpass, switched off at and above Nyquist
+    if (tap.cutoffHz <= 0.0f || tap.cutoffHz >= 0.5f * Fs)
+        tap.lowpassCoef = 0.0f;
+    else
+        tap.lowpassCoef = 1.0f - std::exp(-2.0f * MathConstants<float>::pi * tap.cutoffHz / (float)Fs);
+}
+
+// Sparse pattern between 3 and 80 ms: gains fall off exponentially with random
+// signs and the later taps are darker.
+void EarlyReflections::setDefaultTaps(int newNrTaps) {
+    Random random(1234);
+    const int n = jlimit(1, (int)maxTaps, newNrTaps);
+
+    for (int i = 0; i < n; ++i) {
+        const float position = (i + random.nextFloat()) / n;
+        const float delayMs = 3.0f + 77.0f * position * position;
+        const float sign = random.nextBool() ? 1.0f : -1.0f;
+        const float gain = sign * 0.7f * std::exp(-delayMs / 40.0f);
+        const float cutoff = 16000.0f - 12000.0f * position;
+        setTap(i, delayMs, gain, cutoff);
+    }
+    setNrTaps(n);
+}
+
+void EarlyReflections::applyPendingTaps() {
+    const SpinLock::ScopedTryLockType lock(tapLock);
+    if (!lock.isLocked() || !tapsChanged)
+        return;
+
+    std::copy(pendingTaps, pendingTaps + maxTaps, taps);
+    nrTaps = pendingNrTaps;
+    tapsChanged = false;
+}
+
+void EarlyReflections::process(int channel, const float* input, float* output, int numSamples) {
+    if (channel == 0)
+        applyPendingTaps();
+
+    for (int start = 0; start < numSamples; start += blockSize) {
+        processChunk(channel, input + start, output + start, jmin(blockSize, numSamples - start));
+    }
+}
+
+void EarlyReflections::processChunk(int channel, const float* input, float* output, int numSamples) {
+    auto& ring = history[channel];
+    const int size = historyMask + 1;
+    const int start = writePos[channel];
+
+    // write the block first, so a tap with zero delay reads the current input
+    const int firstPart = jmin(numSamples, size - start);
+    FloatVectorOperations::copy(ring.data() + start, input, firstPart);
+    FloatVectorOperations::copy(ring.data(), input + firstPart, numSamples - firstPart);
+
+    FloatVectorOperations::clear(output, numSamples);
+    float* tapData = tapBuffer.data();
+
+    for (int t = 0; t < nrTaps; ++t) {
+        const auto& tap = taps[t];
+
+        const int readStart = (start - tap.delay) & historyMask;
+        const int readFirst = jmin(numSamples, size - readStart);
+        FloatVectorOperations::copy(tapData, ring.data() + readStart, readFirst);
+        FloatVectorOperations::copy(tapData + readFirst, ring.data(), numSamples - readFirst);
+
+        if (tap.lowpassCoef > 0.0f) {
+            float state = lowpassState[channel][t];
+            for (int n = 0; n < numSamples; ++n) {
+                state += tap.lowpassCoef * (tapData[n] - state);
+                tapData[n] = state;
+            }
+            lowpassState[channel][t] = state;
+        }
+
+        FloatVectorOperations::addWithMultiply(output, tapData, tap.gain, numSamples);
+    }
+
+    writePos[channel] = (start + numSamples) & historyMask;
+}
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    EarlyReflections.h
+    Created: 19 Oct 2026 1:26:07pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Sparse multi-tap delay placed in front of the FDN. The input is written
+// into a ring buffer a block at a time, and each tap copies its contiguous
+// slice out of it, runs an optional one-pole lowpass over it and adds it to
+// the output with a vectorised multiply-add.
+class EarlyReflections {
+
+public:
+
+    EarlyReflections();
+    ~EarlyReflections();
+
+    void prepare(double sampleRate, int numChannels, int maxBlockSize);
+
+    void reset();
+
+    // message thread, picked up by the audio thread at the start of the next block
+    void setNrTaps(int newNrTaps);
+    void setTap(int index, float delayMs, float gain, float cutoffHz);
+    void setDefaultTaps(int newNrTaps);
+
+    int getNrTaps() const { return pendingNrTaps; }
+    float getTapDelayMs(int index) const { return pendingTaps[index].delayMs; }
+    float getTapGain(int index) const { return pendingTaps[index].gain; }
+    float getTapCutoff(int index) const { return pendingTaps[index].cutoffHz; }
+
+    void process(int channel, const float* input, float* output, int numSamples);
+
+    enum
+    {
+        maxTaps = 32,
+        maxDelayMs = 100,
+    };
+
+private:
+
+    // kept in ms and Hz as well, so the taps can be converted again for a new rate
+    struct Tap {
+        float delayMs = 0.0f;
+        float cutoffHz = 0.0f;
+        int delay = 0;              // samples
+        float gain = 0.0f;
+        float lowpassCoef = 0.0f;   // 0 = no lowpass
+    };
+
+    void updateTap(Tap& tap) const;
+    void applyPendingTaps();
+    void processChunk(int channel, const float* input, float* output, int numSamples);
+
+    Tap taps[maxTaps];
+    Tap pendingTaps[maxTaps];
+    int nrTaps = 0;
+    int pendingNrTaps = 0;
+    bool tapsChanged = false;
+    SpinLock tapLock;
+
+    std::vector<std::vector<float>> history;
+    std::vector<std::vector<float>> lowpassState;   // per channel, per tap
+    std::vector<int> writePos;
+    std::vector<float> tapBuffer;
+    int historyMask = 0;
+    int blockSize = 0;
+    double Fs = 44100.0;
+};
@@ -9,6 +9,7 @@
 */
 
 #include "FDN.hpp"
+#include "MatrixFactory.h"
 
 FDN::FDN() {}
 
@@ -18,14 +19,45 @@ FDN::~FDN() {
     delete mixingMatrix;
     delete delayLineInputMatrix;
     delete delayLineOutputMatrix;
-    delete [] lowShelf;
-    delete [] highShelf;
+    delete nextMixingMatrix;
+    delete nextInputMatrix;
+    delete nextOutputMatrix;
 }
 
 void FDN::reset() {
-    for(int i = 0; i < nrDelayLines; ++i) {
+    // before the first prepare() there are no delay lines to clear
+    const int nrLines = jmin(nrDelayLines, dspDelayLines.getNrInUse());
+    for(int i = 0; i < nrLines; ++i) {
         dspDelayLines[i].reset();
     }
+    diffuser.reset();
+    scattering.reset();
+    filterMatrix.reset();
+    graphicEQ.reset();
+    toneCorrection.reset();
+}
+
+void FDN::recover() {
+    reset();
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lowShelf[i].clear();
+        highShelf[i].clear();
+        endHighShelf[i].clear();
+    }
+    matrixModulator.reset();
+    delayLineInputMatrix->clear();
+    delayLineOutputMatrix->clear();
+
+    float* matrix = mixingMatrix->getRawDataPointer();
+    const int size = (int)(mixingMatrix->getNumRows() * mixingMatrix->getNumColumns());
+    for (int i = 0; i < size; ++i) {
+        if (!std::isfinite(matrix[i])) {
+            mixingMatrix->clear();
+            for (int j = 0; j < (int)mixingMatrix->getNumRows(); ++j)
+                mixingMatrix->operator()(j, j) = 1.0f;
+            break;
+        }
+    }
 }
 
 void FDN::init(float sampleRate, int nrDel, float loDel, float highDel) {
@@ -34,29 +66,37 @@ void FDN::init(float sampleRate, int nrDel, float loDel, float highDel) {
 
     lowDelay = loDel;
     highDelay = highDel;
-    bGains.resize(maxDelayLines);
-    cGains.resize(maxDelayLines);
-
-    delayLength.resize(maxDelayLines);
-    findNPrime((int)(lowDelay * Fs/1000.0), (int)(highDelay * Fs/1000.0), nrDelayLines);
+    random.seed(seed);
+    
+    if (lowShelf == nullptr) {
+        bGains.resize(maxDelayLines);
+        cGains.resize(maxDelayLines);
+        delayLength.resize(maxDelayLines);
+        pendingDelayLength.resize(maxDelayLines);
+        loopDelays.resize(maxDelayLines);
+        
+        lowShelf.reset(new Filter[maxDelayLines]);
+        highShelf.reset(new Filter[maxDelayLines]);
+        endHighShelf.reset(new Filter[maxDelayLines]);
+        
+        modDepth.resize(maxDelayLines);
+        lfos.resize(maxDelayLines);
+        delayLineSmoother.resize(maxDelayLines);
         
-    dspDelayLines.resize(maxDelayLines);
+        for (int i = 0; i < maxDelayLines; ++i) {
+            lfos[i] = dsp::Oscillator<float>{[](float x) {return std::sin(x);}};
+        }
+    }
     
-    lowShelf = new Filter[maxDelayLines];
-    highShelf = new Filter[maxDelayLines];
-    endHighShelf = new Filter[maxDelayLines];
-
-    modDepth.resize(maxDelayLines);
-    lfos.resize(maxDelayLines);
-    delayLineSmoother.resize(maxDelayLines);
+    findNPrime((int)(lowDelay * Fs/1000.0), (int)(highDelay * Fs/1000.0), nrDelayLines, delayLength);
+    delaysPending = false;
+    delaysRamping = false;
 
     int size = nrDel*nrDel;
     coefs.resize(size);
 
+    // the delay lines are allocated and given their delays in prepare()
     for (int i = 0; i < maxDelayLines; ++i) {
-        dspDelayLines[i] = dsp::DelayLine<float, dsp::DelayLineInterpolationTypes::Lagrange3rd>(maxDelaySamples);
-        dspDelayLines[i].setDelay(delayLength[i]);
-        lfos[i] = dsp::Oscillator<float>{[](float x) {return std::sin(x);}};
         bGains[i] = randomFloat(-1.f, 1.f);
         cGains[i] = randomFloat(-1.f, 1.f);
         modDepth[i] = 6.f;
@@ -68,15 +108,25 @@ void FDN::init(float sampleRate, int nrDel, float loDel, float highDel) {
         endHighShelf[i].reset(Fs);
     }
 
+    matrixCoefficients.ensureStorageAllocated(maxDelayLines * maxDelayLines);
     matrixCoefficients.resize(nrDelayLines*nrDelayLines);
-    mixingMatrix = new dsp::Matrix<float>(dsp::Matrix<float>::identity(nrDelayLines));
-    delayLineInputMatrix = new dsp::Matrix<float>(nrDelayLines, 1); // all zeros
-    delayLineOutputMatrix = new dsp::Matrix<float>(nrDelayLines, 1); // all zeros
-    
+    if (mixingMatrix == nullptr) {
+        mixingMatrix = new dsp::Matrix<float>(dsp::Matrix<float>::identity(nrDelayLines));
+        delayLineInputMatrix = new dsp::Matrix<float>(nrDelayLines, 1); // all zeros
+        delayLineOutputMatrix = new dsp::Matrix<float>(nrDelayLines, 1); // all zeros
+    } else {
+        *mixingMatrix = dsp::Matrix<float>::identity(nrDelayLines);
+        *delayLineInputMatrix = dsp::Matrix<float>(nrDelayLines, 1);
+        *delayLineOutputMatrix = dsp::Matrix<float>(nrDelayLines, 1);
+    }
 }
 
 
-void FDN::updateFDN(int nrDel, int matrixSelection) {
+bool FDN::updateFDN(int nrDel, int matrixSelection) {
+    const SpinLock::ScopedTryLockType lock(matrixLock);
+    if (!lock.isLocked() || nextMatrixOrder != nrDel || !dspDelayLines.tryUse(nrDel))
+        return false;
+    
     updatingFDNOrder = true;
     nrDelayLines = nrDel;
     reset();
@@ -84,30 +134,77 @@ void FDN::updateFDN(int nrDel, int matrixSelection) {
         bGains[i] = randomFloat(-1.f, 1.f);
         cGains[i] = randomFloat(-1.f, 1.f);
     }
-    findNPrime((int)(lowDelay * Fs/1000.0), (int)(highDelay * Fs/1000.0), nrDelayLines);
+    findNPrime((int)(lowDelay * Fs/1000.0), (int)(highDelay * Fs/1000.0), nrDelayLines, delayLength);
+    delaysRamping = false;
     
     for (int i = 0; i < nrDel; ++i) {
         dspDelayLines[i].setDelay(delayLength[i]);
         delayLineSmoother[i].setCurrentAndTargetValue(delayLength[i]);
     }
 
+    // the storage of matrixCoefficients was reserved in init()
     matrixCoefficients.resize(nrDelayLines*nrDelayLines);
-    if(matrixSelection == 1) {
-        mixingMatrix = new dsp::Matrix<float>(dsp::Matrix<float>::identity(nrDelayLines));
-    }
+    
+    // the matrices of the old order go back to the spares and are freed on the message thread.
+    // Generated matrices are handed over again once they are built for the new order, scattering
+    // does not use the matrix but the morph and the state still expect it at this order
+    std::swap(mixingMatrix, nextMixingMatrix);
+    std::swap(delayLineInputMatrix, nextInputMatrix);
+    std::swap(delayLineOutputMatrix, nextOutputMatrix);
+    nextMatrixOrder = 0;
     if(matrixSelection == 2) {
-        mixingMatrix = new dsp::Matrix<float>(nrDelayLines, nrDelayLines, matrixCoefficients.getRawDataPointer());
+        std::copy(matrixCoefficients.begin(), matrixCoefficients.end(), mixingMatrix->getRawDataPointer());
     }
-    delayLineInputMatrix = new dsp::Matrix<float>(nrDelayLines, 1); // all zeros
-    delayLineOutputMatrix = new dsp::Matrix<float>(nrDelayLines, 1); // all zeros
+    scatteringOn = (matrixSelection == 3);
+    filterMatrixOn = (matrixSelection == MatrixFactory::filterMatrix);
     updatingFDNOrder = false;
+    return true;
 }
 
 void FDN::prepare(const dsp::ProcessSpec& spec) {
+    if ((float)spec.sampleRate != Fs) {
+        const double ratio = spec.sampleRate / Fs;
+        for (int i = 0; i < maxDelayLines; ++i) {
+            delayLength[i] = jlimit(1, maxDelaySamples - 1, roundToInt(delayLength[i] * ratio));
+            delayLineSmoother[i].reset(spec.sampleRate, 0.05f);
+            delayLineSmoother[i].setCurrentAndTargetValue(delayLength[i]);
+        }
+        Fs = (float)spec.sampleRate;
+    }
+    
+    // only the lines of the current order are allocated, their memory is kept
+    // unless the number of channels has changed
+    dspDelayLines.prepare(spec, maxDelaySamples, nrDelayLines, delayStorage);
     for(int i = 0; i < nrDelayLines; ++i) {
-        dspDelayLines[i].prepare(spec);
+        dspDelayLines[i].setDelay(delayLength[i]);
+    }
+    for(int i = 0; i < maxDelayLines; ++i) {
         lfos[i].prepare(spec);
     }
+    
+    diffuser.prepare(spec.sampleRate, spec.numChannels, maxDelayLines);
+    scattering.prepare(spec.sampleRate, spec.numChannels, maxDelayLines);
+    filterMatrix.prepare(spec.sampleRate, spec.numChannels, maxDelayLines);
+    matrixModulator.prepare(spec.sampleRate, maxDelayLines);
+    matrixMorph.prepare(spec.sampleRate, maxDelayLines);
+    graphicEQ.prepare(spec.sampleRate, spec.numChannels, maxDelayLines);
+    toneCorrection.prepare(spec.sampleRate, spec.numChannels, 1);
+    const float oneSample = 1.f;
+    toneCorrection.setDelays(&oneSample, 1);
+    filterCache.prepare(spec.sampleRate, maxDelayLines);
+    
+    // 10 ms, the filters are shared by the channels so they step once per channel
+    filterRampLength = roundToInt(0.01 * spec.sampleRate) * jmax(1, (int)spec.numChannels);
+    
+    // the stage delays depend on the sample rate, so the filters are designed again
+    updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+    updateGraphicEQ();
+    updateToneCorrection();
+    
+    if (backgroundFilterDesign)
+        filterCache.start();
+    if (backgroundDelayAllocation)
+        dspDelayLines.start();
 }
 
 void FDN::setBGains(std::vector<float> gains) {
@@ -135,24 +232,252 @@ void FDN::updateDryMix(float dryWet) {
 }
 
 void FDN::updateFilter(float g_DC, float g_PI, float l_fT, float h_fT) {
-    for (int i = 0; i < nrDelayLines; ++i) {
-        lowShelf[i].updateLowShelf(g_DC, l_fT, delayLength[i], Fs);
-        highShelf[i].updateHighShelf(g_PI, h_fT, delayLength[i], Fs);
-        endHighShelf[i].updateHighShelf(g_PI, 20200.f, delayLength[i], Fs);
+    lowT60 = g_DC;
+    highT60 = g_PI;
+    lowTransFreq = l_fT;
+    highTransFreq = h_fT;
+    
+    // the allpasses, the scattering delays and the latency of the filter matrix
+    // are lossless but make the loop longer, so the attenuation has to cover them too
+    float extraDelay = 0.f;
+    if (diffusionOn)
+        extraDelay += diffuser.getTotalDelay();
+    if (scatteringOn)
+        extraDelay += scattering.getAverageDelay(nrDelayLines);
+    if (filterMatrixOn)
+        extraDelay += filterMatrix.getLatency();
+    
+    {
+        // the lengths the audio thread has not taken yet are the ones the filters are for
+        const SpinLock::ScopedLockType lock(delayLock);
+        const auto& lengths = delaysPending ? pendingDelayLength : delayLength;
+        for (int i = 0; i < nrDelayLines; ++i) {
+            loopDelays[i] = lengths[i] + extraDelay;
+        }
+    }
+    
+    // the audio thread picks the set up in processFDN() once the worker has designed it
+    filterCache.request(g_DC, g_PI, l_fT, h_fT, loopDelays.data(), nrDelayLines);
+    if (!filterCache.isRunning()) {
+        filterCache.applyPendingSet(lowShelf.get(), highShelf.get(), endHighShelf.get(), nrDelayLines, 0);
+        toneCorrectionChanged = true;
+    }
+    
+    // only stores the delays, the design itself happens in updateGraphicEQ()
+    graphicEQ.setDelays(loopDelays.data(), nrDelayLines);
+}
+
+void FDN::setBackgroundFilterDesign(bool shouldDesignInBackground) {
+    backgroundFilterDesign = shouldDesignInBackground;
+    if (backgroundFilterDesign)
+        filterCache.start();
+    else
+        filterCache.stop();
+}
+
+void FDN::setBackgroundDelayAllocation(bool shouldAllocateInBackground) {
+    backgroundDelayAllocation = shouldAllocateInBackground;
+    if (backgroundDelayAllocation)
+        dspDelayLines.start();
+    else
+        dspDelayLines.stop();
+}
+
+void FDN::requestDelayLines(int nrDel) {
+    prepareOrderMatrices(nrDel);
+    dspDelayLines.request(nrDel);
+}
+
+void FDN::allocateDelayLines(int nrDel) {
+    prepareOrderMatrices(nrDel);
+    dspDelayLines.allocate(nrDel);
+}
+
+// identity, input and output vector for the next order, swapped in by updateFDN()
+void FDN::prepareOrderMatrices(int nrDel) {
+    auto* mixing = new dsp::Matrix<float>(dsp::Matrix<float>::identity(nrDel));
+    auto* input = new dsp::Matrix<float>(nrDel, 1);    // all zeros
+    auto* output = new dsp::Matrix<float>(nrDel, 1);   // all zeros
+    {
+        const SpinLock::ScopedLockType lock(matrixLock);
+        std::swap(nextMixingMatrix, mixing);
+        std::swap(nextInputMatrix, input);
+        std::swap(nextOutputMatrix, output);
+        nextMatrixOrder = nrDel;
+    }
+    
+    // the spares from before, the audio thread is not using them
+    delete mixing;
+    delete input;
+    delete output;
+}
+
+float FDN::getLongestT60() const {
+    if (graphicEQOn) {
+        float longest = 0.f;
+        for (int k = 0; k < graphicEQ.getNrBands(); ++k)
+            longest = jmax(longest, graphicEQ.getT60(k));
+        return longest;
+    }
+    return jmax(lowT60, highT60);
+}
+
+// Same curve as GraphicEQ::setT60FromShelves(): the shelf T60s outside the
+// transition frequencies, log interpolated between them.
+float FDN::getTargetT60(float frequency) const {
+    if (graphicEQOn) {
+        int nearest = 0;
+        for (int k = 1; k < graphicEQ.getNrBands(); ++k) {
+            if (std::abs(std::log(graphicEQ.getCentreFrequency(k) / frequency))
+                < std::abs(std::log(graphicEQ.getCentreFrequency(nearest) / frequency)))
+                nearest = k;
         }
+        return graphicEQ.getT60(nearest);
+    }
+    
+    const float lowFreq = jmax(1.0f, jmin(lowTransFreq, highTransFreq));
+    const float highFreq = jmax(lowFreq * 1.01f, highTransFreq);
+    if (frequency <= lowFreq)
+        return lowT60;
+    if (frequency >= highFreq)
+        return highT60;
+    return lowT60 * std::pow(highT60 / lowT60, std::log(frequency / lowFreq) / std::log(highFreq / lowFreq));
+}
+
+void FDN::setGraphicEQ(bool shouldBeOn, bool shouldFollowShelves) {
+    graphicEQFollowsShelves = shouldFollowShelves;
+    if (shouldBeOn && !graphicEQOn)
+        graphicEQ.reset();
+    updateGraphicEQ();
+    graphicEQOn = shouldBeOn;
+    toneCorrectionChanged = true;
+}
+
+void FDN::updateGraphicEQ() {
+    if (graphicEQFollowsShelves)
+        graphicEQ.setT60FromShelves(lowT60, highT60, lowTransFreq, highTransFreq);
+    graphicEQ.update();
+}
+
+void FDN::setToneCorrection(bool shouldBeOn) {
+    if (shouldBeOn && !toneCorrectionOn)
+        toneCorrection.reset();
+    toneCorrectionChanged = true;
+    updateToneCorrection();
+    toneCorrectionOn = shouldBeOn;
+}
+
+// The energy a line adds to the tail at a frequency is 1 / (1 - g^2), where g
+// is the gain of one pass through its attenuation filters, so the tail is
+// louder where it decays slower. The correction is the inverse of the average
+// over the lines per octave, with its mean taken out so the level stays the same.
+void FDN::updateToneCorrection() {
+    if (!toneCorrectionChanged.exchange(false))
+        return;
+    
+    const int nrBands = toneCorrection.getNrBands();
+    std::vector<float> energyDb(nrBands, 0.f);
+    float meanDb = 0.f;
+    int nrValid = 0;
+    
+    for (int k = 0; k < nrBands; ++k) {
+        const float f = toneCorrection.getCentreFrequency(k);
+        if (f >= 0.45f * Fs)
+            break;
+        
+        double energy = 0.0;
+        for (int i = 0; i < nrDelayLines; ++i) {
+            float gainDb;
+            if (graphicEQOn) {
+                const int band = (graphicEQ.getNrBands() == nrBands) ? k : 3 * k + 2;
+                gainDb = -60.f * loopDelays[i] / (graphicEQ.getT60(band) * Fs);
+            } else {
+                const float magnitude = lowShelf[i].getMagnitudeForFrequency(f) * highShelf[i].getMagnitudeForFrequency(f)
+                                      * endHighShelf[i].getMagnitudeForFrequency(f);
+                gainDb = 20.f * std::log10(jmax(magnitude, 1.0e-6f));
+            }
+            energy += 1.0 / (1.0 - std::pow(10.0, jmin(gainDb, -1.0e-4f) / 10.0));
+        }
+        energyDb[k] = 10.f * std::log10((float)(energy / jmax(1, nrDelayLines)));
+        meanDb += energyDb[k];
+        ++nrValid;
+    }
+    meanDb /= jmax(1, nrValid);
+    
+    for (int k = 0; k < nrValid; ++k)
+        toneCorrection.setGain(k, meanDb - energyDb[k]);
+    toneCorrection.update();
+}
+
+void FDN::setDiffusion(bool shouldDiffuse) {
+    if (shouldDiffuse && !diffusionOn)
+        diffuser.reset();
+    diffusionOn = shouldDiffuse;
+    updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+}
+
+void FDN::setDiffusionStages(int nrStages) {
+    diffuser.setNrStages(nrStages);
+    updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+}
+
+void FDN::setDiffusionGain(float gain) {
+    diffuser.setGain(gain);
+}
+
+void FDN::setDiffusionNested(bool shouldBeNested) {
+    diffuser.setNested(shouldBeNested);
+}
+
+void FDN::setScatteringStages(int nrStages) {
+    scattering.setNrStages(nrStages);
+    updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+}
+
+void FDN::setScatteringSpread(float spreadMs) {
+    scattering.setSpread(spreadMs);
+    updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+}
+
+void FDN::setFilterMatrices(const std::vector<float>& low, const std::vector<float>& high) {
+    filterMatrix.setMatrices(low, high, nrDelayLines);
+}
+
+void FDN::setFilterMatrixCrossover(float frequencyHz) {
+    filterMatrix.setCrossover(frequencyHz);
+}
+
+void FDN::setMatrixModulation(bool shouldModulate) {
+    if (shouldModulate && !matrixModulationOn)
+        matrixModulator.reset();
+    matrixModulationOn = shouldModulate;
 }
 
 void FDN::updateDelay(float newDelay) {
     lowDelay = newDelay * 0.6;
     highDelay = newDelay;
-    findNPrime((int)(lowDelay * Fs/1000.0), (int)(highDelay * Fs/1000.0), nrDelayLines);
     
-    for(int i = 0; i < nrDelayLines; ++i) {
-        delayLineSmoother[i].setTargetValue(delayLength[i]);
-        while (delayLength[i] != delayLineSmoother[i].getNextValue()) {
-            dspDelayLines[i].setDelay(delayLineSmoother[i].getNextValue());
+    const SpinLock::ScopedLockType lock(delayLock);
+    findNPrime((int)(lowDelay * Fs/1000.0), (int)(highDelay * Fs/1000.0), nrDelayLines, pendingDelayLength);
+    pendingDelayLines = nrDelayLines;
+    delaysPending = true;
+}
+
+// Audio thread. Only sets the targets, processFDN() moves the lines there one
+// sample at a time. Lengths found for another order are dropped.
+void FDN::applyPendingDelays() {
+    const SpinLock::ScopedTryLockType lock(delayLock);
+    if (!lock.isLocked() || !delaysPending)
+        return;
+    
+    if (pendingDelayLines == nrDelayLines) {
+        for (int i = 0; i < nrDelayLines; ++i) {
+            delayLength[i] = pendingDelayLength[i];
+            delayLineSmoother[i].setTargetValue(delayLength[i]);
         }
+        delaysRamping = true;
     }
+    delaysPending = false;
 }
 
 void FDN::setDelayOSCWhole(std::vector<float> newDelayVector) {
@@ -161,12 +486,14 @@ void FDN::setDelayOSCWhole(std::vector<float> newDelayVector) {
         dspDelayLines[i].reset();
         delayLength[i] = newDelayVector[i] * Fs/1000.0f;
         dspDelayLines[i].setDelay(delayLength[i]);
+        delayLineSmoother[i].setCurrentAndTargetValue(delayLength[i]);
     }
 }
 
 void FDN::setDelayOSCSingle(int index, int newDelay) {
     delayLength[index] = newDelay * Fs/1000.0f;
     dspDelayLines[index].setDelay(delayLength[index]);
+    delayLineSmoother[index].setCurrentAndTargetValue(delayLength[index]);
 }
 
 void FDN::updateModulation(float newDepth, float newRate) {
@@ -174,7 +501,8 @@ void FDN::updateModulation(float newDepth, float newRate) {
     for(int i = 0; i < nrDelayLines; ++i) {
         modDepth[i] = newDepth;
         lfos[i].setFrequency(newRate);
-        float delay = delayLength[i];
+        // follows a delay change that is still ramping
+        float delay = delayLineSmoother[i].getCurrentValue();
         float lfoOut = modDepth[i] * lfos[i].processSample(0.0f);
 
         float newDelay = delay + lfoOut;
@@ -185,22 +513,77 @@ void FDN::updateModulation(float newDepth, float newRate) {
     }
 }
     
-float FDN::processFDN(int channel, float input) {
+float FDN::processFDN(int channel, float input, float* lines, int lineStride) {
     float out = 0.0f;
   
     
 //    updateModulation();
     if (!updatingFDNOrder) {
     
+    float* lineOutput = delayLineOutputMatrix->getRawDataPointer();
+    
+    // a new set of lengths from updateDelay() is reached in 50 ms without a click
+    if (channel == 0 && delaysRamping) {
+        delaysRamping = false;
+        for (int i = 0; i < nrDelayLines; ++i) {
+            if (delayLineSmoother[i].isSmoothing()) {
+                dspDelayLines[i].setDelay(delayLineSmoother[i].getNextValue());
+                delaysRamping = true;
+            }
+        }
+    }
+    
+    if (channel == 0 && filterCache.hasPendingSet()) {
+        filterCache.applyPendingSet(lowShelf.get(), highShelf.get(), endHighShelf.get(), nrDelayLines, filterRampLength);
+        toneCorrectionChanged = true;
+    }
+    
     for (int i = 0; i < nrDelayLines; ++i) {
         dspDelayLines[i].pushSample(channel, bGains[i] * input + delayLineInputMatrix->operator()(i, 0));
-        delayLineOutputMatrix->operator()(i, 0) = endHighShelf[i].processSample( highShelf[i].processSample(lowShelf[i].processSample(dspDelayLines[i].popSample(channel))));
-        
-        out += cGains[i] * delayLineOutputMatrix->operator()(i, 0);
+        lineOutput[i] = dspDelayLines[i].popSample(channel);
+    }
+    
+    out = outputTaps.process(channel, dspDelayLines, delayLength, nrDelayLines);
+    
+    // the diffuser works on all lines at once, so it needs every line popped first
+    if (diffusionOn)
+        diffuser.process(channel, lineOutput, nrDelayLines);
+    
+    // until the graphic EQ has been designed for this order the shelves keep the loop lossy
+    if (graphicEQOn && graphicEQ.process(channel, lineOutput, nrDelayLines)) {
+        for (int i = 0; i < nrDelayLines; ++i)
+            out += cGains[i] * lineOutput[i];
+    } else {
+        for (int i = 0; i < nrDelayLines; ++i) {
+            lineOutput[i] = endHighShelf[i].processSample( highShelf[i].processSample(lowShelf[i].processSample(lineOutput[i])));
+            
+            out += cGains[i] * lineOutput[i];
+        }
+    }
+    
+    // for the ambisonic encoder, before the modulator and scattering change them
+    if (lines != nullptr) {
+        for (int i = 0; i < nrDelayLines; ++i)
+            lines[i * lineStride] = lineOutput[i];
     }
     
+    if (toneCorrectionOn)
+        toneCorrection.process(channel, &out, 1);
+    
     out += d * input;
-    *delayLineInputMatrix = mixingMatrix->operator*(*delayLineOutputMatrix);
+    // A * R(t) * x, with the rotations applied to x so the matrix itself stays untouched
+    if (matrixModulationOn)
+        matrixModulator.process(channel, lineOutput, nrDelayLines);
+    
+    if (matrixMorph.getMorphTime() > 0.0f)
+        matrixMorph.process(channel, mixingMatrix->getRawDataPointer(), nrDelayLines);
+    
+    if (scatteringOn)
+        scattering.process(channel, lineOutput, delayLineInputMatrix->getRawDataPointer(), nrDelayLines);
+    else if (filterMatrixOn)
+        filterMatrix.process(channel, lineOutput, delayLineInputMatrix->getRawDataPointer(), nrDelayLines);
+    else
+        *delayLineInputMatrix = mixingMatrix->operator*(*delayLineOutputMatrix);
 
     
     return out;
@@ -209,7 +592,242 @@ float FDN::processFDN(int channel, float input) {
     }
 }
 
-void FDN::findNPrime(int LR, int UR, int N){
+// Takes over everything that shapes the response of another FDN. The delay
+// lines and the filters of this one take the settings over in prepare().
+bool FDN::copySettingsFrom(const FDN& other, const FDNSnapshot& settings) {
+    const int N = settings.nrDelayLines;
+    if (N == 0 || settings.matrixOrder != N)
+        return false;
+    
+    init(other.Fs, N, other.lowDelay, other.highDelay);
+    
+    d = settings.dryMix;
+    for (int i = 0; i < N; ++i) {
+        bGains[i] = settings.bGains[i];
+        cGains[i] = settings.cGains[i];
+        delayLength[i] = settings.delays[i];
+        delayLineSmoother[i].setCurrentAndTargetValue(delayLength[i]);
+    }
+    std::copy(settings.matrix, settings.matrix + N * N, mixingMatrix->getRawDataPointer());
+    outputTaps.copySettingsFrom(other.outputTaps);
+    diffusionOn = other.diffusionOn;
+    diffuser.copySettingsFrom(other.diffuser);
+    scatteringOn = settings.scattering;
+    scattering.copySettingsFrom(other.scattering);
+    filterMatrixOn = settings.filterMatrix;
+    filterMatrix.copySettingsFrom(other.filterMatrix);
+    graphicEQOn = other.graphicEQOn;
+    graphicEQFollowsShelves = other.graphicEQFollowsShelves;
+    graphicEQ.copySettingsFrom(other.graphicEQ);
+    toneCorrectionOn = other.toneCorrectionOn;
+    
+    // only the values, the filters are designed for them in prepare()
+    lowT60 = settings.lowT60;
+    highT60 = settings.highT60;
+    lowTransFreq = settings.lowTransFreq;
+    highTransFreq = settings.highTransFreq;
+    return true;
+}
+
+namespace
+{
+    enum { stateVersion = 2 };
+}
+
+void FDN::getState(MemoryOutputStream& stream) const {
+    const int N = nrDelayLines;
+    stream.writeInt(N);
+    stream.writeInt(stateVersion);
+    stream.writeInt((int)seed);
+    stream.writeFloat(Fs);
+    stream.writeFloat(d);
+    stream.write(bGains.data(), N * sizeof(float));
+    stream.write(cGains.data(), N * sizeof(float));
+    stream.write(delayLength.data(), N * sizeof(int));
+    stream.write(modDepth.data(), N * sizeof(float));
+    for (int i = 0; i < N; ++i)
+        stream.writeFloat(lfos[i].getFrequency());
+    
+    // a matrix left at another order is not used at this one, the identity stands in for it
+    if ((int)mixingMatrix->getNumRows() == N && (int)mixingMatrix->getNumColumns() == N) {
+        stream.write(mixingMatrix->getRawDataPointer(), N * N * sizeof(float));
+    } else {
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+                stream.writeFloat(i == j ? 1.0f : 0.0f);
+    }
+    
+    // version 2, the settings only OSC reaches
+    stream.writeBool(diffusionOn);
+    stream.writeInt(diffuser.getNrStages());
+    stream.writeFloat(diffuser.getGain());
+    stream.writeBool(diffuser.isNested());
+    stream.writeInt(scattering.getNrStages());
+    stream.writeFloat(scattering.getSpread());
+    stream.writeFloat(filterMatrix.getCrossover());
+    stream.writeBool(graphicEQOn);
+    stream.writeBool(graphicEQFollowsShelves);
+    stream.writeInt(graphicEQ.getNrBands());
+    for (int k = 0; k < graphicEQ.getNrBands(); ++k)
+        stream.writeFloat(graphicEQ.getT60(k));
+    stream.writeBool(toneCorrectionOn);
+    stream.writeBool(matrixModulationOn);
+    stream.writeFloat(matrixModulator.getRate());
+    stream.writeFloat(matrixModulator.getDepth());
+    stream.writeFloat(matrixMorph.getMorphTime());
+    stream.writeInt(outputTaps.getTapsPerLine());
+    for (int i = 0; i < N; ++i) {
+        for (int t = 0; t < outputTaps.getTapsPerLine(); ++t) {
+            stream.writeFloat(outputTaps.getTapPosition(i, t));
+            stream.writeFloat(outputTaps.getTapGain(i, t));
+        }
+    }
+}
+
+bool FDN::setState(MemoryInputStream& stream) {
+    const int N = stream.readInt();
+    const int version = stream.readInt();
+    const int64 fixedSize = (int64)(3 * sizeof(float) + N * (5 + N) * sizeof(float));
+    if (N != nrDelayLines || version > stateVersion || stream.getNumBytesRemaining() < fixedSize)
+        return false;
+    
+    // a short OSC part is found before anything has been restored
+    if (version >= 2) {
+        const int64 start = stream.getPosition();
+        stream.setPosition(start + fixedSize);
+        const bool fits = oscSettingsFit(stream, N);
+        stream.setPosition(start);
+        if (!fits)
+            return false;
+    }
+    
+    setSeed((uint32)stream.readInt());
+    const float savedFs = stream.readFloat();
+    d = stream.readFloat();
+    stream.read(bGains.data(), N * sizeof(float));
+    stream.read(cGains.data(), N * sizeof(float));
+    stream.read(delayLength.data(), N * sizeof(int));
+    stream.read(modDepth.data(), N * sizeof(float));
+    for (int i = 0; i < N; ++i)
+        lfos[i].setFrequency(stream.readFloat());
+    if ((int)mixingMatrix->getNumRows() != N || (int)mixingMatrix->getNumColumns() != N)
+        *mixingMatrix = dsp::Matrix<float>(N, N);
+    stream.read(mixingMatrix->getRawDataPointer(), N * N * sizeof(float));
+    const float* restored = mixingMatrix->getRawDataPointer();
+    matrixOrthogonal = MatrixValidator::getOrthogonalityError(std::vector<float>(restored, restored + N * N), N) <= 1.0e-3f;
+    
+    if (version >= 2 && !setOSCSettings(stream, N))
+        return false;
+    
+    // the delays are kept in samples, so they are only rescaled if the rate has changed.
+    // They also win over lengths that are still waiting for the audio thread
+    {
+        const SpinLock::ScopedLockType lock(delayLock);
+        delaysPending = false;
+    }
+    delaysRamping = false;
+    for (int i = 0; i < N; ++i) {
+        if (savedFs != Fs && savedFs > 0.f)
+            delayLength[i] = roundToInt(delayLength[i] * Fs / savedFs);
+        dspDelayLines[i].setDelay(delayLength[i]);
+        delayLineSmoother[i].setCurrentAndTargetValue(delayLength[i]);
+    }
+    updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+    updateGraphicEQ();
+    return true;
+}
+
+// Walks the lengths of the OSC part without reading it in: 28 bytes up to the
+// number of bands, a float per band, 18 bytes up to the taps per line and two
+// floats per tap. The stream is left where it was.
+bool FDN::oscSettingsFit(MemoryInputStream& stream, int N) {
+    const int64 start = stream.getPosition();
+    bool fits = false;
+    
+    if (stream.getNumBytesRemaining() >= 28) {
+        stream.setPosition(start + 24);
+        const int nrBands = stream.readInt();
+        if (nrBands >= 0 && nrBands <= GraphicEQ::maxBands
+            && stream.getNumBytesRemaining() >= (int64)nrBands * 4 + 18) {
+            stream.setPosition(stream.getPosition() + (int64)nrBands * 4 + 14);
+            const int tapsPerLine = stream.readInt();
+            fits = tapsPerLine >= 0 && tapsPerLine <= OutputTaps::maxTapsPerLine
+                && stream.getNumBytesRemaining() >= (int64)N * tapsPerLine * 8;
+        }
+    }
+    
+    stream.setPosition(start);
+    return fits;
+}
+
+// The filters are designed once at the end of setState(), so the settings go
+// straight to the parts instead of through the setters of the FDN.
+bool FDN::setOSCSettings(MemoryInputStream& stream, int N) {
+    if (!oscSettingsFit(stream, N))
+        return false;
+    
+    const bool diffuse = stream.readBool();
+    diffuser.setNrStages(stream.readInt());
+    diffuser.setGain(stream.readFloat());
+    diffuser.setNested(stream.readBool());
+    if (diffuse && !diffusionOn)
+        diffuser.reset();
+    diffusionOn = diffuse;
+    
+    scattering.setNrStages(stream.readInt());
+    scattering.setSpread(stream.readFloat());
+    filterMatrix.setCrossover(stream.readFloat());
+    
+    graphicEQOn = stream.readBool();
+    graphicEQFollowsShelves = stream.readBool();
+    const int nrBands = stream.readInt();
+    graphicEQ.setNrBands(nrBands);
+    for (int k = 0; k < nrBands; ++k) {
+        const float t60 = stream.readFloat();
+        if (k < graphicEQ.getNrBands())
+            graphicEQ.setT60(k, t60);
+    }
+    
+    toneCorrectionOn = stream.readBool();
+    toneCorrectionChanged = true;
+    
+    matrixModulationOn = stream.readBool();
+    matrixModulator.setRate(stream.readFloat());
+    matrixModulator.setDepth(stream.readFloat());
+    matrixMorph.setMorphTime(stream.readFloat());
+    
+    const int tapsPerLine = stream.readInt();
+    for (int i = 0; i < N; ++i) {
+        for (int t = 0; t < tapsPerLine; ++t) {
+            const float position = stream.readFloat();
+            outputTaps.setTap(i, t, position, stream.readFloat());
+        }
+    }
+    outputTaps.setTapsPerLine(tapsPerLine);
+    return true;
+}
+
+// Impulse response of channel 0, including the direct path. Clears all of the
+// state first, the filters and the feedback included.
+void FDN::renderImpulseResponse(float* destination, int length) {
+    recover();
+    for (int n = 0; n < length; ++n) {
+        destination[n] = processFDN(0, n == 0 ? 1.0f : 0.0f);
+    }
+}
+
+void FDN::renderImpulseResponses(float* const* destination, int numChannels, int length) {
+    for (int input = 0; input < numChannels; ++input) {
+        recover();
+        for (int n = 0; n < length; ++n) {
+            for (int ch = 0; ch < numChannels; ++ch) {
+                destination[input * numChannels + ch][n] = processFDN(ch, (ch == input && n == 0) ? 1.0f : 0.0f);
+            }
+        }
+    }
+}
+
+void FDN::findNPrime(int LR, int UR, int N, std::vector<int>& lengths){
     int count = 0;
     bool prime;
     
@@ -218,57 +836,102 @@ void FDN::findNPrime(int LR, int UR, int N){
             return;
         else {
             prime= true;
-            for(int k = 2; k < i/2; k++) {
+            for(int k = 2; k * k <= i; k++) {
                 if (i % k == 0) {
                     prime = false;
                     break;
                 }
             }
             if (prime == true)
-                delayLength[count++] = i;
+                lengths[count++] = i;
          
         }
     }
 }
 
 float FDN::randomFloat(float min, float max) {
-    float random = ((float) rand())/(float)RAND_MAX;
-    float diff = max - min;
-    float r = random * diff;
-    return min + r;
+    return std::uniform_real_distribution<float>(min, max)(random);
 }
 
-void FDN::updateMatrixCoefficients(std::vector<float> newMatrixCoef, int matrixSelection) {
+void FDN::updateMatrixCoefficients(const std::vector<float>& newMatrixCoef, int matrixSelection) {
   
+    const bool scatter = (matrixSelection == 3);
+    if (scatter != scatteringOn) {
+        if (scatter)
+            scattering.reset();
+        scatteringOn = scatter;
+        updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+    }
+    
+    const bool filterMix = (matrixSelection == MatrixFactory::filterMatrix);
+    if (filterMix != filterMatrixOn) {
+        if (filterMix)
+            filterMatrix.reset();
+        filterMatrixOn = filterMix;
+        updateFilter(lowT60, highT60, lowTransFreq, highTransFreq);
+    }
+    
+    // both are handed over like any other matrix, setMatrix() decides on a morph
     if(matrixSelection == 1) {
-        delete mixingMatrix;
-        mixingMatrix = new dsp::Matrix<float>(dsp::Matrix<float>::identity(nrDelayLines));
+        std::vector<float> identity(nrDelayLines * nrDelayLines, 0.0f);
+        for (int i = 0; i < nrDelayLines; ++i)
+            identity[i * nrDelayLines + i] = 1.0f;
+        setMatrix(identity);
     }
     
     if(matrixSelection == 2) {
-        for (int i = 0; i < newMatrixCoef.size(); ++i) {
-            matrixCoefficients.insert(i, newMatrixCoef[i]);
+        // a matrix for another order waits for the next update
+        if ((int)newMatrixCoef.size() != nrDelayLines * nrDelayLines)
+            return;
+        for (int i = 0; i < (int)newMatrixCoef.size(); ++i) {
+            matrixCoefficients.set(i, newMatrixCoef[i]);
         }
-        delete mixingMatrix;
-        mixingMatrix = new dsp::Matrix<float>(nrDelayLines, nrDelayLines, matrixCoefficients.getRawDataPointer());
+        setMatrix(newMatrixCoef);
     }
 }
 
+// called from the OSC callback, so the matrix is handed over to the audio thread
+// instead of replacing mixingMatrix underneath it
 void FDN::updateMatrixCoefficientsOSC(std::vector<float> newMatrixCoef, String singleWhole) {
-    if(singleWhole.compare("whole") == 0) {
+    if(singleWhole.compare("whole") == 0 || singleWhole.compare("single") == 0) {
         for (int i = 0; i < newMatrixCoef.size(); ++i) {
-            matrixCoefficients.insert(i, newMatrixCoef[i]);
+            matrixCoefficients.set(i, newMatrixCoef[i]);
         }
-        mixingMatrix = new dsp::Matrix<float>(nrDelayLines, nrDelayLines, matrixCoefficients.getRawDataPointer());
+        setMatrix(newMatrixCoef);
     }
+}
+
+// The morph is a product of rotations, which only connects orthogonal matrices.
+// Anything else, or a morph that would start from such a matrix, is swapped in.
+void FDN::setMatrix(const std::vector<float>& newMatrixCoef) {
+    const bool sized = (int)newMatrixCoef.size() == nrDelayLines * nrDelayLines;
+    const bool wasOrthogonal = matrixOrthogonal;
+    matrixOrthogonal = sized && MatrixValidator::getOrthogonalityError(newMatrixCoef, nrDelayLines) <= 1.0e-3f;
     
-    if(singleWhole.compare("single") == 0) {
-        for (int i = 0; i < newMatrixCoef.size(); ++i) {
-            matrixCoefficients.insert(i, newMatrixCoef[i]);
+    if (matrixMorph.getMorphTime() > 0.0f) {
+        if (matrixOrthogonal && wasOrthogonal) {
+            matrixMorph.setTarget(newMatrixCoef, nrDelayLines);
+            return;
         }
-        delete mixingMatrix;
-        mixingMatrix = new dsp::Matrix<float>(nrDelayLines, nrDelayLines, matrixCoefficients.getRawDataPointer());
+        matrixMorph.cancel();
+    }
+    
+    const SpinLock::ScopedLockType lock(matrixLock);
+    pendingMatrix = newMatrixCoef;
+    matrixPending = true;
+}
+
+void FDN::applyPendingMatrix() {
+    const SpinLock::ScopedTryLockType lock(matrixLock);
+    if (!lock.isLocked() || !matrixPending)
+        return;
+    
+    // a matrix built for another order is dropped, a new one is on its way
+    if ((int)pendingMatrix.size() == nrDelayLines * nrDelayLines
+        && (int)mixingMatrix->getNumRows() == nrDelayLines && (int)mixingMatrix->getNumColumns() == nrDelayLines) {
+        std::copy(pendingMatrix.begin(), pendingMatrix.end(), mixingMatrix->getRawDataPointer());
     }
+    matrixPending = false;
 }
 
 void FDN::setModRate(float newRate) {
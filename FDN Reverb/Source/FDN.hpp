@@ -13,6 +13,17 @@
 #include <JuceHeader.h>
 #include <random>
 #include "Filter.h"
+#include "FilterCoefficientCache.h"
+#include "DelayLinePool.h"
+#include "OutputTaps.h"
+#include "AllpassDiffuser.h"
+#include "ScatteringMatrix.h"
+#include "FilterFeedbackMatrix.h"
+#include "GraphicEQ.h"
+#include "GivensModulator.h"
+#include "MatrixMorph.h"
+#include "MatrixValidator.h"
+#include "FDNSnapshot.h"
 
 
 class FDN : public juce::Component {
@@ -27,10 +38,19 @@ public:
 
     void reset();
     
+    // audio thread, after the output blew up: clears every bit of state and
+    // falls back to the identity if the mixing matrix itself is broken
+    void recover();
+    
+    // allocates for maxDelayLines on the first call only, after that it starts
+    // over with new delays and gains in the same memory
     void init(float sampleRate, int nrDel, float loDel, float higDel);
     
-    void updateFDN(int nrDel, int matrixSelection);
+    // audio thread, false until the delay lines of the new order have been allocated
+    bool updateFDN(int nrDel, int matrixSelection);
     
+    // a new sample rate scales the delays in samples instead of searching for
+    // primes again, the delay lines are only prepared again for a new channel count
     void prepare(const dsp::ProcessSpec& spec);
     
     void setBGains(std::vector<float> gains);
@@ -47,8 +67,11 @@ public:
     
     void updateDryMix(float dryWet);
     
+    // message thread, the audio thread ramps the lines to the new lengths
     void updateDelay(float newDelay);
     
+    void applyPendingDelays();
+    
     void setDelayOSCWhole(std::vector<float> newDelayVector);
     
     void setDelayOSCSingle(int index, int newDelay);
@@ -57,16 +80,136 @@ public:
         
     void updateFilter(float gDC, float gPI, float l_fT, float h_fT);
     
-    float processFDN(int channel, float input);
+    // the shelves are designed by a worker and ramped in on the audio thread,
+    // without it updateFilter() designs them straight away
+    void setBackgroundFilterDesign(bool shouldDesignInBackground);
+    
+    // delay lines for a new order are allocated by a worker, without it
+    // requestDelayLines() allocates them straight away
+    void setBackgroundDelayAllocation(bool shouldAllocateInBackground);
+    
+    // message thread, ahead of updateFDN() with a new order. Also builds the
+    // matrices for that order, so updateFDN() only has to swap them in
+    void requestDelayLines(int nrDel);
+    
+    // message thread, same as requestDelayLines() but done before it returns
+    void allocateDelayLines(int nrDel);
+    
+    // 16 bit storage for the delay lines, takes effect with the next prepare()
+    void setDelayStorage(CompressedDelayLine::Format format) { delayStorage = format; }
+    
+    CompressedDelayLine::Format getDelayStorage() const { return delayStorage; }
+    
+    size_t getDelayLineBytes() { return dspDelayLines.getNumBytes(); }
+    
+    float getLongestT60() const;
+    
+    // the decay asked for at a frequency, from the graphic EQ bands if it is on
+    float getTargetT60(float frequency) const;
+    
+    void setDiffusion(bool shouldDiffuse);
+    
+    void setDiffusionStages(int nrStages);
+    
+    void setDiffusionGain(float gain);
+    
+    void setDiffusionNested(bool shouldBeNested);
+    
+    bool isDiffusing() const { return diffusionOn; }
+    
+    const AllpassDiffuser& getDiffuser() const { return diffuser; }
+    
+    void setScatteringStages(int nrStages);
+    
+    void setScatteringSpread(float spreadMs);
+    
+    const ScatteringMatrix& getScattering() const { return scattering; }
+    
+    // mixing matrices below and above the crossover, for MATRIXSELECTION 10
+    void setFilterMatrices(const std::vector<float>& low, const std::vector<float>& high);
+    
+    void setFilterMatrixCrossover(float frequencyHz);
+    
+    const FilterFeedbackMatrix& getFilterMatrix() const { return filterMatrix; }
+    
+    // per band T60s instead of the two shelves, optionally following the shelf T60s
+    void setGraphicEQ(bool shouldBeOn, bool shouldFollowShelves);
+    
+    bool isGraphicEQOn() const { return graphicEQOn; }
+    
+    GraphicEQ& getGraphicEQ() { return graphicEQ; }
+    
+    // message thread, designs the graphic EQ if anything has changed
+    void updateGraphicEQ();
+    
+    // output filter that flattens the steady state spectrum of the tail
+    void setToneCorrection(bool shouldBeOn);
+    
+    bool isToneCorrectionOn() const { return toneCorrectionOn; }
+    
+    const GraphicEQ& getToneCorrection() const { return toneCorrection; }
+    
+    // message thread, designs the correction again after updateFilter() or a graphic EQ change
+    void updateToneCorrection();
+    
+    // extra outputs along every line, none until taps are set
+    OutputTaps& getOutputTaps() { return outputTaps; }
+    
+    void setMatrixModulation(bool shouldModulate);
     
-    void findNPrime(int LR, int UR, int N);
+    bool isMatrixModulating() const { return matrixModulationOn; }
     
-    void updateMatrixCoefficients(std::vector<float> newMatrixCoef, int matrixSelection);
+    GivensModulator& getMatrixModulator() { return matrixModulator; }
+    
+    // 0 swaps the matrix straight away, above that every new matrix is morphed to
+    void setMatrixMorphTime(float seconds) { matrixMorph.setMorphTime(seconds); }
+    
+    float getMatrixMorphTime() const { return matrixMorph.getMorphTime(); }
+    
+    bool isMatrixMorphing() const { return matrixMorph.isMorphing(); }
+    
+    // lines, if given, gets the filtered output of line i at lines[i * lineStride]
+    float processFDN(int channel, float input, float* lines = nullptr, int lineStride = 1);
+    
+    // Message thread. What the audio thread owns (gains, delays, matrix, dry
+    // mix, shelves, matrix mode) comes from a snapshot of the other FDN, the
+    // rest from the settings last requested of it, so nothing the audio thread
+    // is using is read. This FDN is initialised for the snapshot's order and
+    // takes the settings over in prepare(); false if the snapshot is not whole.
+    bool copySettingsFrom(const FDN& other, const FDNSnapshot& settings);
+    
+    // Everything the plugin parameters do not cover: seed, gains, delays, LFOs
+    // and the mixing matrix, written as raw arrays, then the settings only OSC
+    // reaches (diffusion, scattering, graphic EQ, tone correction, matrix
+    // modulation and morph, output taps). setState() returns false without
+    // touching anything if the order is not the one of this FDN.
+    void getState(MemoryOutputStream& stream) const;
+    bool setState(MemoryInputStream& stream);
+    
+    // the gains and LFO rates of init() and updateFDN() are drawn from this seed
+    void setSeed(uint32 newSeed) { seed = newSeed; random.seed(seed); }
+    uint32 getSeed() const { return seed; }
+    
+    void renderImpulseResponse(float* destination, int length);
+    
+    // every input to every output, destination[input * numChannels + output].
+    // The channels share the matrix and the filters, so one input is heard on all outputs
+    void renderImpulseResponses(float* const* destination, int numChannels, int length);
+    
+    void findNPrime(int LR, int UR, int N, std::vector<int>& lengths);
+    
+    // message thread, the matrix goes through setMatrix()
+    void updateMatrixCoefficients(const std::vector<float>& newMatrixCoef, int matrixSelection);
     
     void updateMixingMatrix(float frac);
     
     void updateMatrixCoefficientsOSC(std::vector<float> newMatrixCoef, String singleWhole);
     
+    // message thread, the audio thread copies it into the mixing matrix at the start of a block
+    void setMatrix(const std::vector<float>& newMatrixCoef);
+    
+    void applyPendingMatrix();
+    
     void updateModulation(float newDepth, float newRate);
     
     void updateModDepthOSCSingle(int index, float newDepth);
@@ -81,21 +224,21 @@ public:
 
     std::vector<int> delayLength;
     
-    std::vector<juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Lagrange3rd>> dspDelayLines;
+    DelayLinePool dspDelayLines;    // only the lines below nrDelayLines are there
 
 
-    Filter* lowShelf;
-    Filter* highShelf;
-    Filter* endHighShelf;
+    std::unique_ptr<Filter[]> lowShelf;
+    std::unique_ptr<Filter[]> highShelf;
+    std::unique_ptr<Filter[]> endHighShelf;
     std::vector<SmoothedValue<float, ValueSmoothingTypes::Linear>> delayLineSmoother;
     
-    dsp::Matrix<float>* mixingMatrix;
-    dsp::Matrix<float>* delayLineInputMatrix;
-    dsp::Matrix<float>* delayLineOutputMatrix;
+    dsp::Matrix<float>* mixingMatrix = nullptr;
+    dsp::Matrix<float>* delayLineInputMatrix = nullptr;
+    dsp::Matrix<float>* delayLineOutputMatrix = nullptr;
     
     Array<float> coefs;
     
-    int nrDelayLines;
+    int nrDelayLines = 0;
     float Fs;
     
     float lowDelay;
@@ -124,7 +267,73 @@ private:
     
     std::vector<dsp::Oscillator<float>> lfos;
    
+    // last values given to updateFilter, needed to rebuild the filters of a copy
+    float lowT60 = 1.f, highT60 = 0.5f, lowTransFreq = 400.f, highTransFreq = 2500.f;
+    
+    FilterCoefficientCache filterCache;
+    bool backgroundFilterDesign = false;
+    int filterRampLength = 0;
+    
+    bool backgroundDelayAllocation = false;
+    CompressedDelayLine::Format delayStorage = CompressedDelayLine::float32;
+    
+    AllpassDiffuser diffuser;
+    bool diffusionOn = false;
+    
+    ScatteringMatrix scattering;
+    bool scatteringOn = false;  // MATRIXSELECTION 3
+    
+    FilterFeedbackMatrix filterMatrix;
+    bool filterMatrixOn = false;    // MATRIXSELECTION 10
+    
+    GraphicEQ graphicEQ;
+    bool graphicEQOn = false;
+    bool graphicEQFollowsShelves = true;
+    std::vector<float> loopDelays;  // delay plus extra delay of every line, for the graphic EQ
+    
+    GraphicEQ toneCorrection;   // octave bands, a single line with a delay of one sample
+    bool toneCorrectionOn = false;
+    std::atomic<bool> toneCorrectionChanged { true };
+    
+    OutputTaps outputTaps;
+    
+    GivensModulator matrixModulator;
+    bool matrixModulationOn = false;
+    
+    MatrixMorph matrixMorph;
+    
+    std::vector<float> pendingMatrix;
+    bool matrixPending = false;
+    SpinLock matrixLock;
+    
+    // whether the last matrix handed to setMatrix() was orthogonal, message thread
+    bool matrixOrthogonal = true;
+    
+    std::vector<int> pendingDelayLength;
+    int pendingDelayLines = 0;
+    bool delaysPending = false;
+    bool delaysRamping = false;
+    SpinLock delayLock;
+    
+    void prepareOrderMatrices(int nrDel);
+    
+    // built on the message thread for the next order, they hold the old matrices after the swap
+    dsp::Matrix<float>* nextMixingMatrix = nullptr;
+    dsp::Matrix<float>* nextInputMatrix = nullptr;
+    dsp::Matrix<float>* nextOutputMatrix = nullptr;
+    int nextMatrixOrder = 0;
+    
+    // false, without changing anything, if the stream is too short for what it announces
+    bool setOSCSettings(MemoryInputStream& stream, int N);
+    static bool oscSettingsFit(MemoryInputStream& stream, int N);
+    
+    // reads what the audio thread owns for copies taken on the message thread
+    friend class FDNSnapshotBuffer;
+    
     float PI = MathConstants<double>::pi;
+    
+    uint32 seed = 1;
+    std::mt19937 random { 1 };
     bool updatingFDNOrder = false;
     int delayUpdate = 0;
     std::vector<float> modDepth;
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    FDNSnapshot.cpp
+    Created: 20 Oct 2026 9:12:40am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "FDNSnapshot.h"
+#include "FDN.hpp"
+
+String FDNSnapshot::formatList(const float* values, int numValues) {
+    std::string list;
+    for (int i = 0; i < numValues; ++i) {
+        if (i > 0)
+            list.append(", ");
+        list.append(std::to_string(values[i]));
+    }
+    return list;
+}
+
+String FDNSnapshot::formatList(const int* values, int numValues) {
+    std::string list;
+    for (int i = 0; i < numValues; ++i) {
+        if (i > 0)
+            list.append(", ");
+        list.append(std::to_string(values[i]));
+    }
+    return list;
+}
+
+void FDNSnapshotBuffer::publish(const FDN& fdn) {
+    // the gain vectors are resized on the message thread, so only what is there is read
+    const int n = jmin(jmin((int)FDNSnapshot::maxLines, fdn.nrDelayLines, (int)fdn.delayLength.size()),
+                       (int)fdn.bGains.size(), (int)fdn.cGains.size());
+    const int matrixSize = fdn.mixingMatrix != nullptr ? (int)fdn.mixingMatrix->getNumRows() : 0;
+    bool changed = false;
+
+    if (n != latest.nrDelayLines) {
+        latest.nrDelayLines = n;
+        ++latest.gainsVersion;
+        ++latest.delaysVersion;
+        ++latest.matrixVersion;
+        changed = true;
+    }
+
+    if (std::memcmp(latest.bGains, fdn.bGains.data(), n * sizeof(float)) != 0
+     || std::memcmp(latest.cGains, fdn.cGains.data(), n * sizeof(float)) != 0) {
+        std::memcpy(latest.bGains, fdn.bGains.data(), n * sizeof(float));
+        std::memcpy(latest.cGains, fdn.cGains.data(), n * sizeof(float));
+        ++latest.gainsVersion;
+        changed = true;
+    }
+
+    if (std::memcmp(latest.delays, fdn.delayLength.data(), n * sizeof(int)) != 0) {
+        std::memcpy(latest.delays, fdn.delayLength.data(), n * sizeof(int));
+        ++latest.delaysVersion;
+        changed = true;
+    }
+
+    // skipped for the block or two where the order and the matrix disagree
+    if (matrixSize == n && n > 0) {
+        const float* coefficients = fdn.mixingMatrix->getRawDataPointer();
+        if (latest.matrixOrder != n || std::memcmp(latest.matrix, coefficients, n * n * sizeof(float)) != 0) {
+            std::memcpy(latest.matrix, coefficients, n * n * sizeof(float));
+            latest.matrixOrder = n;
+            ++latest.matrixVersion;
+            changed = true;
+        }
+    }
+
+    if (latest.dryMix != fdn.d || latest.lowT60 != fdn.lowT60 || latest.highT60 != fdn.highT60
+     || latest.lowTransFreq != fdn.lowTransFreq || latest.highTransFreq != fdn.highTransFreq
+     || latest.scattering != fdn.scatteringOn || latest.filterMatrix != fdn.filterMatrixOn) {
+        latest.dryMix = fdn.d;
+        latest.lowT60 = fdn.lowT60;
+        latest.highT60 = fdn.highT60;
+        latest.lowTransFreq = fdn.lowTransFreq;
+        latest.highTransFreq = fdn.highTransFreq;
+        latest.scattering = fdn.scatteringOn;
+        latest.filterMatrix = fdn.filterMatrixOn;
+        ++latest.settingsVersion;
+        changed = true;
+    }
+
+    if (!changed)
+        return;
+
+    slots[back] = latest;
+    back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+}
+
+bool FDNSnapshotBuffer::acquire() {
+    if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+        return false;
+
+    front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+    return true;
+}
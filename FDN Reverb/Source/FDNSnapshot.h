@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    FDNSnapshot.h
+    Created: 20 Oct 2026 9:12:40am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class FDN;
+
+// What the editor shows of the FDN, plus the settings the audio thread owns
+// that a copy of the FDN needs (FDN::copySettingsFrom()). Each part has a
+// version that only goes up when its values have changed, so the editor can
+// tell what to format again.
+struct FDNSnapshot {
+    enum
+    {
+        maxLines = 32,
+    };
+
+    int nrDelayLines = 0;
+    float bGains[maxLines] = {};
+    float cGains[maxLines] = {};
+    int delays[maxLines] = {};
+    float matrix[maxLines * maxLines] = {};     // nrDelayLines x nrDelayLines, row major
+    int matrixOrder = 0;                        // order the matrix was taken at
+
+    float dryMix = 0.0f;
+    float lowT60 = 0.0f;
+    float highT60 = 0.0f;
+    float lowTransFreq = 0.0f;
+    float highTransFreq = 0.0f;
+    bool scattering = false;
+    bool filterMatrix = false;
+
+    uint32 gainsVersion = 0;
+    uint32 delaysVersion = 0;
+    uint32 matrixVersion = 0;
+    uint32 settingsVersion = 0;
+
+    // same format as the string getters of the FDN
+    static String formatList(const float* values, int numValues);
+    static String formatList(const int* values, int numValues);
+};
+
+// Triple buffer from the audio thread to a single reader on the message thread,
+// a second reader needs a buffer of its own.
+// The writer never waits and the reader always gets a whole snapshot, the
+// newest one is swapped in and older ones are skipped.
+class FDNSnapshotBuffer {
+
+public:
+
+    // audio thread, compares the FDN with what was published last and only
+    // publishes if something has changed
+    void publish(const FDN& fdn);
+
+    // message thread, true if a newer snapshot has been swapped in since the last call
+    bool acquire();
+
+    // message thread, the snapshot taken by the last acquire()
+    const FDNSnapshot& current() const { return slots[front]; }
+
+private:
+
+    enum
+    {
+        indexMask = 3,
+        freshBit = 4,
+    };
+
+    FDNSnapshot slots[3];
+    FDNSnapshot latest;                 // audio thread only, compared against
+    std::atomic<int> middle { 1 };      // slot in between, with freshBit once written
+    int back = 0;                       // audio thread only
+    int front = 2;                      // message thread only
+};
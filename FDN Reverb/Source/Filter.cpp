@@ -21,10 +21,17 @@ void Filter::reset(float sampleRate) {
     a1 = 0.0f;
     prevInput = 0.0f;
     prevOutput = 0.0f;
+    target = Coefficients();
+    rampRemaining = 0;
     this->Fs = sampleRate;
 }
 
-void Filter::updateLowShelf(float t60, float fT, float delay, float sampleRate) {
+void Filter::clear() {
+    prevInput = 0.0f;
+    prevOutput = 0.0f;
+}
+
+Filter::Coefficients Filter::makeLowShelf(float t60, float fT, float delay, float sampleRate) {
 
     float gdB = -60/(t60*sampleRate);
    
@@ -33,22 +40,19 @@ void Filter::updateLowShelf(float t60, float fT, float delay, float sampleRate)
     float del = floor(delay);
     float g = pow(gLin,del);
 
-    float wc = 2.0 * PI * fT / Fs;
+    float wc = 2.0 * MathConstants<double>::pi * fT / sampleRate;
     float tc = std::tan(wc * 0.5f);
 
-    b0 = g*tc + sqrt(g);
-    b1 = g*tc - sqrt(g);
-    a0 = tc + sqrt(g);
-    a1 = tc - sqrt(g);
+    float a0inv = 1/(tc + sqrt(g));
     
-    float a0inv = 1/a0;
-    b0 *= a0inv;
-    b1 *= a0inv;
-    a1 *= a0inv;
-
+    Coefficients c;
+    c.b0 = (g*tc + sqrt(g)) * a0inv;
+    c.b1 = (g*tc - sqrt(g)) * a0inv;
+    c.a1 = (tc - sqrt(g)) * a0inv;
+    return c;
 }
 
-void Filter::updateHighShelf(float t60, float fT, float delay, float sampleRate) {
+Filter::Coefficients Filter::makeHighShelf(float t60, float fT, float delay, float sampleRate) {
 
     float gdB = -60/(t60*sampleRate);
    
@@ -57,22 +61,55 @@ void Filter::updateHighShelf(float t60, float fT, float delay, float sampleRate)
     float del = floor(delay);
     float g = pow(gLin,del);
 
-    float wc = 2.0 * PI * fT / Fs;
+    float wc = 2.0 * MathConstants<double>::pi * fT / sampleRate;
     float tc = std::tan(wc * 0.5f);
     
-    b0 = sqrt(g)*tc + g;
-    b1 = sqrt(g)*tc - g;
-    a0 = sqrt(g)*tc + 1;
-    a1 = sqrt(g)*tc - 1;
+    float a0inv = 1/(sqrt(g)*tc + 1);
     
-    float a0inv = 1/a0;
-    b0 *= a0inv;
-    b1 *= a0inv;
-    a1 *= a0inv;
+    Coefficients c;
+    c.b0 = (sqrt(g)*tc + g) * a0inv;
+    c.b1 = (sqrt(g)*tc - g) * a0inv;
+    c.a1 = (sqrt(g)*tc - 1) * a0inv;
+    return c;
+}
 
+void Filter::updateLowShelf(float t60, float fT, float delay, float sampleRate) {
+    setCoefficients(makeLowShelf(t60, fT, delay, sampleRate));
+}
+
+void Filter::updateHighShelf(float t60, float fT, float delay, float sampleRate) {
+    setCoefficients(makeHighShelf(t60, fT, delay, sampleRate));
+}
+
+void Filter::setCoefficients(const Coefficients& newCoefficients, int rampLength) {
+    target = newCoefficients;
+    if (rampLength <= 0) {
+        b0 = target.b0;
+        b1 = target.b1;
+        a1 = target.a1;
+        rampRemaining = 0;
+        return;
+    }
+    const float inv = 1.0f / rampLength;
+    step.b0 = (target.b0 - b0) * inv;
+    step.b1 = (target.b1 - b1) * inv;
+    step.a1 = (target.a1 - a1) * inv;
+    rampRemaining = rampLength;
 }
 
 float Filter::processSample(float input) {
+    if (rampRemaining > 0) {
+        if (--rampRemaining == 0) {
+            b0 = target.b0;
+            b1 = target.b1;
+            a1 = target.a1;
+        } else {
+            b0 += step.b0;
+            b1 += step.b1;
+            a1 += step.a1;
+        }
+    }
+    
     float output = b0 * input + b1 * prevInput - a1 * prevOutput;
     
     prevInput = input;
@@ -80,3 +117,8 @@ float Filter::processSample(float input) {
     
     return  output;
 }
+
+float Filter::getMagnitudeForFrequency(float frequency) const {
+    const std::complex<double> z1 = std::polar(1.0, -2.0 * PI * frequency / Fs);
+    return (float)(std::abs((double)target.b0 + (double)target.b1 * z1) / std::abs(1.0 + (double)target.a1 * z1));
+}
@@ -22,13 +22,29 @@ public:
     // Destructor
     ~Filter();
     
+    struct Coefficients {
+        float b0 = 1.0f, b1 = 0.0f, a1 = 0.0f;
+    };
+    
+    static Coefficients makeLowShelf(float t60, float fT, float delay, float sampleRate);
+    static Coefficients makeHighShelf(float t60, float fT, float delay, float sampleRate);
+    
     void reset(float sampleRate);
+    void clear();   // state only, keeps the coefficients
     void updateLowShelf(float t60, float fT, float delay, float sampleRate);
     void updateHighShelf(float t60, float fT, float delay, float sampleRate);
+    
+    // moves to the new coefficients in rampLength samples. A first order filter
+    // stays stable all the way, since a1 only moves between two stable values.
+    void setCoefficients(const Coefficients& newCoefficients, int rampLength = 0);
+    
     float processSample(float input);
+    float getMagnitudeForFrequency(float frequency) const;  // of the coefficients it is moving to
  
 private:
     float b0, b1, a0, a1;
+    Coefficients target, step;
+    int rampRemaining = 0;
     float Fs;
     float prevInput, prevOutput;
     double PI = MathConstants<double>::pi;
@@ -0,0 +1,139 @@
+/*
+  ==============================================================================
+
+    FilterCoefficientCache.cpp
+    Created: 19 Oct 2026 11:12:40pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "FilterCoefficientCache.h"
+
+FilterCoefficientCache::FilterCoefficientCache() : juce::Thread("FDN Filter Designer") {
+    for (auto& delay : requestDelays)
+        delay = 0.0f;
+    requestT60[0] = requestT60[1] = 1.0f;
+    requestFreq[0] = requestFreq[1] = 1000.0f;
+
+    // sized here, a copy of the FDN can request a design before it is prepared
+    for (auto* set : { &building, &pending, &active }) {
+        set->low.assign(maxLines, Filter::Coefficients());
+        set->high.assign(maxLines, Filter::Coefficients());
+        set->end.assign(maxLines, Filter::Coefficients());
+    }
+}
+
+FilterCoefficientCache::~FilterCoefficientCache() {
+    stopThread(1000);
+}
+
+void FilterCoefficientCache::prepare(double sampleRate, int maxNrLines) {
+    jassert(maxNrLines <= maxLines);
+    stopThread(1000);
+
+    if (sampleRate != Fs)
+        cache.clear();
+    Fs = sampleRate;
+
+    for (auto* set : { &building, &pending, &active })
+        set->numLines = 0;
+    setReady = false;
+    designedCount = requestCount.load() - 1;    // the next request is always designed
+}
+
+void FilterCoefficientCache::start() {
+    if (!isThreadRunning())
+        startThread(4);
+}
+
+void FilterCoefficientCache::stop() {
+    stopThread(1000);
+}
+
+void FilterCoefficientCache::request(float lowT60, float highT60, float lowTransFreq, float highTransFreq,
+                                     const float* loopDelays, int numLines) {
+    numLines = jmin(numLines, (int)maxLines);
+    requestT60[0] = lowT60;
+    requestT60[1] = highT60;
+    requestFreq[0] = lowTransFreq;
+    requestFreq[1] = highTransFreq;
+    for (int i = 0; i < numLines; ++i)
+        requestDelays[i] = loopDelays[i];
+    requestLines = numLines;
+    ++requestCount;
+
+    if (isThreadRunning())
+        notify();
+    else
+        design();
+}
+
+void FilterCoefficientCache::run() {
+    while (!threadShouldExit()) {
+        if (requestCount.load() != designedCount)
+            design();
+        wait(-1);
+    }
+}
+
+void FilterCoefficientCache::design() {
+    designedCount = requestCount.load();
+
+    const int numLines = requestLines.load();
+    const float lowT60 = requestT60[0].load(), highT60 = requestT60[1].load();
+    const float lowFreq = requestFreq[0].load(), highFreq = requestFreq[1].load();
+
+    for (int i = 0; i < numLines; ++i) {
+        const float delay = requestDelays[i].load();
+        building.low[i] = lookup(lowShelfType, lowT60, lowFreq, delay);
+        building.high[i] = lookup(highShelfType, highT60, highFreq, delay);
+        building.end[i] = lookup(endShelfType, highT60, 20200.f, delay);
+    }
+    building.numLines = numLines;
+
+    const SpinLock::ScopedLockType lock(setLock);
+    std::swap(building, pending);
+    setReady = true;
+}
+
+Filter::Coefficients FilterCoefficientCache::lookup(ShelfType type, float t60, float fT, float delay) {
+    // the shelves only use the whole samples of the delay
+    const uint64 t60Ms = (uint64)jlimit(1, 65535, roundToInt(t60 * 1000.0f));
+    const uint64 freqHz = (uint64)jlimit(1, 65535, roundToInt(fT));
+    const uint64 samples = (uint64)jlimit(0, (1 << 22) - 1, (int)std::floor(delay));
+    const uint64 key = ((uint64)type << 54) | (t60Ms << 38) | (freqHz << 22) | samples;
+
+    auto found = cache.find(key);
+    if (found != cache.end())
+        return found->second;
+
+    if ((int)cache.size() >= maxCacheSize)
+        cache.clear();
+
+    // designed from the rounded values, so a hit gives the same set as a miss
+    const float t60Key = t60Ms / 1000.0f;
+    const float freqKey = (type == endShelfType) ? fT : (float)freqHz;
+    const Filter::Coefficients c = (type == lowShelfType)
+                                 ? Filter::makeLowShelf(t60Key, freqKey, (float)samples, (float)Fs)
+                                 : Filter::makeHighShelf(t60Key, freqKey, (float)samples, (float)Fs);
+    cache.emplace(key, c);
+    return c;
+}
+
+void FilterCoefficientCache::applyPendingSet(Filter* lowShelf, Filter* highShelf, Filter* endHighShelf,
+                                             int numLines, int rampLength) {
+    const SpinLock::ScopedTryLockType lock(setLock);
+    if (!lock.isLocked() || !setReady.load())
+        return;
+
+    std::swap(active, pending);
+    setReady = false;
+
+    numLines = jmin(numLines, active.numLines);
+    for (int i = 0; i < numLines; ++i) {
+        lowShelf[i].setCoefficients(active.low[i], rampLength);
+        highShelf[i].setCoefficients(active.high[i], rampLength);
+        endHighShelf[i].setCoefficients(active.end[i], rampLength);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    FilterCoefficientCache.h
+    Created: 19 Oct 2026 11:12:40pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Filter.h"
+
+// Designs the low, high and end shelves of every delay line away from the
+// audio thread. Coefficients are memoised by (T60, transition frequency, delay)
+// for the current sample rate, with the T60 rounded to 1 ms and the frequency
+// to 1 Hz, so automation that goes back and forth mostly hits the cache.
+//
+// Until start() is called, request() designs straight away and the sets are
+// applied without a ramp, which is what offline copies of the FDN need. After
+// that a worker is woken by each request and the audio thread ramps the filters
+// to each new set.
+class FilterCoefficientCache : private juce::Thread {
+
+public:
+
+    FilterCoefficientCache();
+    ~FilterCoefficientCache() override;
+
+    // stops the worker, start() it again afterwards
+    void prepare(double sampleRate, int maxLines);
+
+    void start();
+    void stop();
+    bool isRunning() const { return isThreadRunning(); }
+
+    // any thread, the shelf parameters and the loop delay of every line in samples
+    void request(float lowT60, float highT60, float lowTransFreq, float highTransFreq,
+                 const float* loopDelays, int numLines);
+
+    bool hasPendingSet() const { return setReady.load(); }
+
+    // audio thread, gives up if the worker holds the lock. The filters move to the
+    // new set in rampLength samples.
+    void applyPendingSet(Filter* lowShelf, Filter* highShelf, Filter* endHighShelf, int numLines, int rampLength);
+
+    int getCacheSize() const { return (int)cache.size(); }
+
+    enum
+    {
+        maxLines = 32,
+        maxCacheSize = 16384,
+    };
+
+private:
+
+    struct CoefficientSet {
+        std::vector<Filter::Coefficients> low, high, end;
+        int numLines = 0;
+    };
+
+    enum ShelfType { lowShelfType, highShelfType, endShelfType };
+
+    void run() override;
+    void design();
+    Filter::Coefficients lookup(ShelfType type, float t60, float fT, float delay);
+
+    std::unordered_map<uint64, Filter::Coefficients> cache;    // designing thread only
+
+    CoefficientSet building, pending, active;
+    std::atomic<bool> setReady { false };
+    SpinLock setLock;
+
+    // the newest request, read by the worker when the count has moved on
+    std::atomic<float> requestT60[2], requestFreq[2];
+    std::atomic<float> requestDelays[maxLines];
+    std::atomic<int> requestLines { 0 };
+    std::atomic<int> requestCount { 0 };
+    int designedCount = 0;
+
+    double Fs = 44100.0;
+};
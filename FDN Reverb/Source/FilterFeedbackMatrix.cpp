@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    FilterFeedbackMatrix.cpp
+    Created: 19 Oct 2026 8:52:40pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "FilterFeedbackMatrix.h"
+
+FilterFeedbackMatrix::FilterFeedbackMatrix() {}
+
+FilterFeedbackMatrix::~FilterFeedbackMatrix() {}
+
+void FilterFeedbackMatrix::prepare(double sampleRate, int numChannels, int maxLines) {
+    Fs = sampleRate;
+    maxNrLines = maxLines;
+    const int numBins = blockSize + 1;
+
+    fft.reset(new dsp::FFT(fftOrder));
+    channels.resize(numChannels);
+    for (auto& state : channels) {
+        state.previous.assign(maxLines * blockSize, 0.0f);
+        state.current.assign(maxLines * blockSize, 0.0f);
+        state.output.assign(maxLines * blockSize, 0.0f);
+        state.pos = 0;
+    }
+    spectra.assign(maxLines * numBins * 2, 0.0f);
+    lowSpectra.assign(maxLines * numBins * 2, 0.0f);
+    highSpectra.assign(maxLines * numBins * 2, 0.0f);
+    fftBuffer.assign(4 * blockSize, 0.0f);
+
+    // the crossover depends on the sample rate
+    designFilters();
+    pushSettings();
+}
+
+void FilterFeedbackMatrix::reset() {
+    for (auto& state : channels) {
+        std::fill(state.previous.begin(), state.previous.end(), 0.0f);
+        std::fill(state.current.begin(), state.current.end(), 0.0f);
+        std::fill(state.output.begin(), state.output.end(), 0.0f);
+        state.pos = 0;
+    }
+}
+
+void FilterFeedbackMatrix::setMatrices(const std::vector<float>& low, const std::vector<float>& high, int numLines) {
+    if (numLines > maxNrLines || (int)low.size() < numLines * numLines || (int)high.size() < numLines * numLines)
+        return;
+
+    requested.low.assign(low.begin(), low.begin() + numLines * numLines);
+    requested.high.assign(high.begin(), high.begin() + numLines * numLines);
+    requested.numLines = numLines;
+    pushSettings();
+}
+
+void FilterFeedbackMatrix::setCrossover(float frequencyHz) {
+    crossover = jlimit(100.0f, 0.4f * (float)Fs, frequencyHz);
+    designFilters();
+    pushSettings();
+}
+
+// the requested settings of the other one, its audio thread may not have them yet
+void FilterFeedbackMatrix::copySettingsFrom(const FilterFeedbackMatrix& other) {
+    crossover = other.crossover;
+    requested = other.requested;
+    designFilters();
+    pushSettings();
+}
+
+void FilterFeedbackMatrix::pushSettings() {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pending = requested;
+    settingsChanged = true;
+}
+
+void FilterFeedbackMatrix::applyPendingSettings() {
+    const SpinLock::ScopedTryLockType lock(settingsLock);
+    if (!lock.isLocked() || !settingsChanged)
+        return;
+
+    std::swap(settings, pending);
+    settingsChanged = false;
+}
+
+// Blackman windowed sinc and its complement, as spectra on the FFT grid.
+// Both are scaled down by the largest |H_lp| + |H_hp|, which bounds the norm
+// of the matrix on that bin.
+void FilterFeedbackMatrix::designFilters() {
+    const int numBins = blockSize + 1;
+    const int fftSize = 2 * blockSize;
+    const double fc = crossover / Fs;
+    const double pi = MathConstants<double>::pi;
+
+    std::vector<float> buffer(2 * fftSize, 0.0f);
+    double sum = 0.0;
+    for (int n = 0; n < filterLength; ++n) {
+        const double m = n - filterDelay;
+        const double sinc = (m == 0.0) ? 2.0 * fc : std::sin(2.0 * pi * fc * m) / (pi * m);
+        const double window = 0.42 - 0.5 * std::cos(2.0 * pi * n / (filterLength - 1))
+                            + 0.08 * std::cos(4.0 * pi * n / (filterLength - 1));
+        buffer[n] = (float)(sinc * window);
+        sum += buffer[n];
+    }
+    for (int n = 0; n < filterLength; ++n)
+        buffer[n] /= (float)sum;
+
+    dsp::FFT transform(fftOrder);
+    transform.performRealOnlyForwardTransform(buffer.data());
+
+    requested.lowpass.resize(numBins * 2);
+    requested.highpass.resize(numBins * 2);
+    double largest = 0.0;
+    for (int k = 0; k < numBins; ++k) {
+        const double phase = -2.0 * pi * k * filterDelay / fftSize;
+        const double lr = buffer[2 * k], li = buffer[2 * k + 1];
+        const double hr = std::cos(phase) - lr, hi = std::sin(phase) - li;
+        requested.lowpass[2 * k] = (float)lr;
+        requested.lowpass[2 * k + 1] = (float)li;
+        requested.highpass[2 * k] = (float)hr;
+        requested.highpass[2 * k + 1] = (float)hi;
+        largest = jmax(largest, std::sqrt(lr * lr + li * li) + std::sqrt(hr * hr + hi * hi));
+    }
+
+    if (largest > 1.0) {
+        for (auto& x : requested.lowpass)
+            x /= (float)largest;
+        for (auto& x : requested.highpass)
+            x /= (float)largest;
+    }
+}
+
+void FilterFeedbackMatrix::process(int channel, const float* input, float* output, int numLines) {
+    auto& state = channels[channel];
+    if (channel == 0 && state.pos == 0)
+        applyPendingSettings();
+
+    // nothing built for this order yet, the lines are passed on unmixed
+    if (settings.numLines != numLines) {
+        std::copy(input, input + numLines, output);
+        return;
+    }
+
+    for (int i = 0; i < numLines; ++i) {
+        state.current[i * blockSize + state.pos] = input[i];
+        output[i] = state.output[i * blockSize + state.pos];
+    }
+
+    if (++state.pos == blockSize) {
+        processBlock(state, numLines);
+        state.pos = 0;
+    }
+}
+
+void FilterFeedbackMatrix::processBlock(ChannelState& state, int numLines) {
+    const int numBins = blockSize + 1;
+    const int fftSize = 2 * blockSize;
+    const int spectrumSize = numBins * 2;
+
+    // [previous, current] of every line to the frequency domain
+    for (int i = 0; i < numLines; ++i) {
+        std::copy(state.previous.begin() + i * blockSize, state.previous.begin() + (i + 1) * blockSize, fftBuffer.begin());
+        std::copy(state.current.begin() + i * blockSize, state.current.begin() + (i + 1) * blockSize,
+                  fftBuffer.begin() + blockSize);
+        std::fill(fftBuffer.begin() + fftSize, fftBuffer.end(), 0.0f);
+        fft->performRealOnlyForwardTransform(fftBuffer.data());
+        std::copy(fftBuffer.begin(), fftBuffer.begin() + spectrumSize, spectra.begin() + i * spectrumSize);
+    }
+    std::swap(state.previous, state.current);
+
+    // A_low X and A_high X for all bins at once, the matrices are real
+    FloatVectorOperations::clear(lowSpectra.data(), numLines * spectrumSize);
+    FloatVectorOperations::clear(highSpectra.data(), numLines * spectrumSize);
+    for (int i = 0; i < numLines; ++i) {
+        float* low = lowSpectra.data() + i * spectrumSize;
+        float* high = highSpectra.data() + i * spectrumSize;
+        for (int j = 0; j < numLines; ++j) {
+            const float* x = spectra.data() + j * spectrumSize;
+            FloatVectorOperations::addWithMultiply(low, x, settings.low[i * numLines + j], spectrumSize);
+            FloatVectorOperations::addWithMultiply(high, x, settings.high[i * numLines + j], spectrumSize);
+        }
+    }
+
+    // Y = H_lp A_low X + H_hp A_high X, back to the time domain, the second half is valid
+    const float* lp = settings.lowpass.data();
+    const float* hp = settings.highpass.data();
+    for (int i = 0; i < numLines; ++i) {
+        const float* low = lowSpectra.data() + i * spectrumSize;
+        const float* high = highSpectra.data() + i * spectrumSize;
+        for (int k = 0; k < numBins; ++k) {
+            fftBuffer[2 * k] = lp[2 * k] * low[2 * k] - lp[2 * k + 1] * low[2 * k + 1]
+                             + hp[2 * k] * high[2 * k] - hp[2 * k + 1] * high[2 * k + 1];
+            fftBuffer[2 * k + 1] = lp[2 * k] * low[2 * k + 1] + lp[2 * k + 1] * low[2 * k]
+                                 + hp[2 * k] * high[2 * k + 1] + hp[2 * k + 1] * high[2 * k];
+        }
+        for (int k = 1; k < blockSize; ++k) {
+            fftBuffer[2 * (fftSize - k)] = fftBuffer[2 * k];
+            fftBuffer[2 * (fftSize - k) + 1] = -fftBuffer[2 * k + 1];
+        }
+        fft->performRealOnlyInverseTransform(fftBuffer.data());
+        std::copy(fftBuffer.begin() + blockSize, fftBuffer.begin() + fftSize, state.output.begin() + i * blockSize);
+    }
+}
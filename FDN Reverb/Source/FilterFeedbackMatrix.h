@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    FilterFeedbackMatrix.h
+    Created: 19 Oct 2026 8:52:40pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Frequency dependent feedback matrix:
+//
+//     A(z) = A_low H_lp(z) + A_high H_hp(z)
+//
+// where H_lp is a linear phase FIR lowpass and H_hp = z^-D - H_lp its
+// complement, so below the crossover the lines are mixed by A_low and above it
+// by A_high. On the unit circle A = e^(-jwD) (a A_low + (1 - a) A_high) with a
+// real, which has a norm of at most one for orthogonal A_low and A_high; the
+// ripple of the lowpass is scaled out so that holds on every bin.
+//
+// The matrix of filters is applied with overlap-save FFTs of all lines at once:
+// a lines x lines multiply-accumulate per bin, done as two real matrices on the
+// whole spectrum. That makes the output one block late, which together with the
+// delay of the FIRs is added to the loop like the scattering delays.
+class FilterFeedbackMatrix {
+
+public:
+
+    FilterFeedbackMatrix();
+    ~FilterFeedbackMatrix();
+
+    void prepare(double sampleRate, int numChannels, int maxLines);
+
+    void reset();
+
+    // message thread, row-major N x N, picked up by the audio thread at the next block
+    void setMatrices(const std::vector<float>& low, const std::vector<float>& high, int numLines);
+    void setCrossover(float frequencyHz);
+    void copySettingsFrom(const FilterFeedbackMatrix& other);
+
+    float getCrossover() const { return crossover; }
+
+    // samples the matrix adds to every loop
+    int getLatency() const { return blockSize + filterDelay; }
+
+    void process(int channel, const float* input, float* output, int numLines);
+
+    enum
+    {
+        blockSize = 64,
+        fftOrder = 7,           // 2 x blockSize
+        filterLength = 63,
+        filterDelay = 31,
+    };
+
+private:
+
+    struct Settings {
+        std::vector<float> low;
+        std::vector<float> high;
+        std::vector<float> lowpass;     // (blockSize + 1) complex bins
+        std::vector<float> highpass;
+        int numLines = 0;
+    };
+
+    struct ChannelState {
+        std::vector<float> previous;    // lines x blockSize
+        std::vector<float> current;
+        std::vector<float> output;
+        int pos = 0;
+    };
+
+    void designFilters();
+    void pushSettings();
+    void applyPendingSettings();
+    void processBlock(ChannelState& state, int numLines);
+
+    std::unique_ptr<dsp::FFT> fft;
+    std::vector<ChannelState> channels;
+    Settings requested, pending, settings;  // message thread, shared, audio thread
+    bool settingsChanged = false;
+    SpinLock settingsLock;
+
+    // scratch, lines x (blockSize + 1) complex bins
+    std::vector<float> spectra, lowSpectra, highSpectra;
+    std::vector<float> fftBuffer;
+
+    float crossover = 1500.0f;
+    int maxNrLines = 0;
+    double Fs = 44100.0;
+};
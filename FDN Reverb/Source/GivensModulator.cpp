@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    GivensModulator.cpp
+    Created: 19 Oct 2026 5:02:18pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "GivensModulator.h"
+
+GivensModulator::GivensModulator() {}
+
+GivensModulator::~GivensModulator() {}
+
+void GivensModulator::prepare(double sampleRate, int maxLines) {
+    Fs = sampleRate;
+    maxPairs = jmax(1, maxLines / 2);
+
+    const int size = nrLayers * maxPairs;
+    rateScale.resize(size);
+    phase.resize(size);
+    cosines.assign(size, 1.0f);
+    sines.assign(size, 0.0f);
+
+    Random random(1357);
+    for (int p = 0; p < size; ++p) {
+        rateScale[p] = 0.5f + random.nextFloat();
+    }
+    reset();
+}
+
+void GivensModulator::reset() {
+    Random random(9753);
+    for (auto& ph : phase) {
+        ph = random.nextFloat() * MathConstants<float>::twoPi;
+    }
+    samplesUntilUpdate = 0;
+}
+
+void GivensModulator::updateAngles(int numLines) {
+    const int nrPairs = jmin(maxPairs, numLines / 2);
+    const float maxAngle = depth * MathConstants<float>::pi * 0.25f;
+    const float increment = MathConstants<float>::twoPi * rate * subBlockSize / (float)Fs;
+
+    for (int l = 0; l < nrLayers; ++l) {
+        for (int p = 0; p < nrPairs; ++p) {
+            const int k = l * maxPairs + p;
+            phase[k] += increment * rateScale[k];
+            if (phase[k] > MathConstants<float>::twoPi)
+                phase[k] -= MathConstants<float>::twoPi;
+
+            const float angle = maxAngle * std::sin(phase[k]);
+            cosines[k] = std::cos(angle);
+            sines[k] = std::sin(angle);
+        }
+    }
+}
+
+void GivensModulator::process(int channel, float* v, int numLines) {
+    if (phase.empty() || numLines < 2)
+        return;
+
+    if (channel == 0 && --samplesUntilUpdate <= 0) {
+        updateAngles(numLines);
+        samplesUntilUpdate = subBlockSize;
+    }
+
+    const int nrPairs = jmin(maxPairs, numLines / 2);
+    for (int l = 0; l < nrLayers; ++l) {
+        const float* c = cosines.data() + l * maxPairs;
+        const float* s = sines.data() + l * maxPairs;
+
+        // layer 1 wraps around to line 0 when the number of lines is even
+        for (int p = 0; p < nrPairs; ++p) {
+            const int i = 2 * p + l;
+            const int j = (i + 1) % numLines;
+            const float a = v[i];
+            const float b = v[j];
+            v[i] = c[p] * a - s[p] * b;
+            v[j] = s[p] * a + c[p] * b;
+        }
+    }
+}
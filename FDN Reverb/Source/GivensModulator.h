@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+    GivensModulator.h
+    Created: 19 Oct 2026 5:02:18pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Slowly rotates the feedback matrix: A(t) = A * R(t), where R(t) is two layers
+// of Givens rotations over disjoint pairs of lines, (0,1)(2,3)... followed by
+// (1,2)(3,4)... Every rotation angle follows its own slow sine. A product of
+// rotations is orthogonal whatever the angles are, so the matrix never has to
+// be re-orthogonalised. The angles are only recomputed once per sub-block.
+class GivensModulator {
+
+public:
+
+    GivensModulator();
+    ~GivensModulator();
+
+    void prepare(double sampleRate, int maxLines);
+
+    void reset();
+
+    void setRate(float newRateHz) { rate = jlimit(0.0f, 10.0f, newRateHz); }
+    // 1 swings every rotation by up to +-45 degrees
+    void setDepth(float newDepth) { depth = jlimit(0.0f, 1.0f, newDepth); }
+
+    float getRate() const { return rate; }
+    float getDepth() const { return depth; }
+
+    // v holds one sample per delay line and is rotated in place. Time moves on
+    // with channel 0, the other channels use the same rotations.
+    void process(int channel, float* v, int numLines);
+
+    enum
+    {
+        subBlockSize = 32,
+        nrLayers = 2,
+    };
+
+private:
+
+    void updateAngles(int numLines);
+
+    std::vector<float> rateScale;       // per pair, so the rotations do not move in lockstep
+    std::vector<float> phase;
+    std::vector<float> cosines;         // [layer * maxPairs + pair]
+    std::vector<float> sines;
+    int maxPairs = 0;
+    int samplesUntilUpdate = 0;
+
+    float rate = 0.2f;
+    float depth = 0.3f;
+    double Fs = 44100.0;
+};
@@ -0,0 +1,328 @@
+/*
+  ==============================================================================
+
+    GraphicEQ.cpp
+    Created: 19 Oct 2026 9:58:03pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "GraphicEQ.h"
+
+namespace
+{
+    // gain of the band filters while the interaction matrix is measured. The
+    // attenuation per pass is only a few dB, and the band shapes are closest to
+    // the real ones when the prototype is in the same range.
+    const double prototypeGainDb = 6.0;
+
+    // Peaking filter with its half gain (in dB) at the band edges, unity at DC and Nyquist
+    void peaking(double gainDb, double cosCentre, double tanHalfBandwidth, double* b, double* a) {
+        if (std::abs(gainDb) < 1.0e-4) {
+            b[0] = 1.0; b[1] = 0.0; b[2] = 0.0;
+            a[0] = 0.0; a[1] = 0.0;
+            return;
+        }
+        const double G = std::pow(10.0, gainDb / 20.0);
+        const double beta = tanHalfBandwidth / std::sqrt(G);
+        const double norm = 1.0 / (1.0 + beta);
+        b[0] = (1.0 + G * beta) * norm;
+        b[1] = -2.0 * cosCentre * norm;
+        b[2] = (1.0 - G * beta) * norm;
+        a[0] = -2.0 * cosCentre * norm;
+        a[1] = (1.0 - beta) * norm;
+    }
+
+    double magnitudeDb(const double* b, const double* a, double w) {
+        const std::complex<double> z1 = std::polar(1.0, -w), z2 = std::polar(1.0, -2.0 * w);
+        const auto H = (b[0] + b[1] * z1 + b[2] * z2) / (1.0 + a[0] * z1 + a[1] * z2);
+        return 20.0 * std::log10(std::abs(H));
+    }
+}
+
+void GraphicEQ::Coefficients::allocate() {
+    b0.assign(maxBands * maxLines, 1.0f);
+    b1.assign(maxBands * maxLines, 0.0f);
+    b2.assign(maxBands * maxLines, 0.0f);
+    a1.assign(maxBands * maxLines, 0.0f);
+    a2.assign(maxBands * maxLines, 0.0f);
+    gain.assign(maxLines, 1.0f);
+    nrBands = 0;
+    numLines = 0;
+}
+
+GraphicEQ::GraphicEQ() {
+    for (auto& t60 : t60s)
+        t60 = 1.0f;
+    for (auto& gain : gainsDb)
+        gain = 0.0f;
+    for (auto& delay : lineDelays)
+        delay = 0.0f;
+}
+
+GraphicEQ::~GraphicEQ() {}
+
+void GraphicEQ::prepare(double sampleRate, int numChannels, int maxNrLines) {
+    jassert(maxNrLines <= maxLines);
+    Fs = sampleRate;
+
+    {
+        const SpinLock::ScopedLockType lock(coefficientLock);
+        design.allocate();
+        pending.allocate();
+        active.allocate();
+        coefficientsReady = false;
+    }
+    state.assign(numChannels, std::vector<float>(2 * maxBands * maxLines, 0.0f));
+
+    designedBands = 0;      // the centre frequencies depend on the sample rate
+    changed = true;
+}
+
+void GraphicEQ::reset() {
+    for (auto& channel : state)
+        std::fill(channel.begin(), channel.end(), 0.0f);
+}
+
+void GraphicEQ::setNrBands(int newNrBands) {
+    nrBands = (newNrBands > 10) ? 31 : 10;
+    changed = true;
+}
+
+float GraphicEQ::getCentreFrequency(int band) const {
+    if (nrBands == 10)
+        return 31.25f * std::pow(2.0f, (float)band);
+    return 1000.0f * std::pow(2.0f, (band - 17) / 3.0f);
+}
+
+void GraphicEQ::setT60(int band, float t60) {
+    if (band < 0 || band >= maxBands)
+        return;
+    t60s[band] = jlimit(0.05f, 30.0f, t60);
+    usesGains = false;
+    changed = true;
+}
+
+void GraphicEQ::setGain(int band, float gainDb) {
+    if (band < 0 || band >= maxBands)
+        return;
+    gainsDb[band] = jlimit(-24.0f, 24.0f, gainDb);
+    usesGains = true;
+    changed = true;
+}
+
+void GraphicEQ::setT60FromShelves(float lowT60, float highT60, float lowTransFreq, float highTransFreq) {
+    const float lowFreq = jmax(1.0f, jmin(lowTransFreq, highTransFreq));
+    const float highFreq = jmax(lowFreq * 1.01f, highTransFreq);
+
+    for (int k = 0; k < nrBands; ++k) {
+        const float f = getCentreFrequency(k);
+        float t60 = lowT60;
+        if (f >= highFreq)
+            t60 = highT60;
+        else if (f > lowFreq)
+            t60 = lowT60 * std::pow(highT60 / lowT60, std::log(f / lowFreq) / std::log(highFreq / lowFreq));
+
+        t60 = jlimit(0.05f, 30.0f, t60);
+        if (t60s[k] != t60 || usesGains) {
+            t60s[k] = t60;
+            changed = true;
+        }
+    }
+    usesGains = false;
+}
+
+void GraphicEQ::setDelays(const float* delays, int numLines) {
+    numLines = jmin(numLines, (int)maxLines);
+    for (int i = 0; i < numLines; ++i) {
+        if (lineDelays[i].load() != delays[i]) {
+            lineDelays[i] = delays[i];
+            changed = true;
+        }
+    }
+    if (nrLines.exchange(numLines) != numLines)
+        changed = true;
+}
+
+void GraphicEQ::copySettingsFrom(const GraphicEQ& other) {
+    nrBands = other.nrBands;
+    for (int k = 0; k < maxBands; ++k) {
+        t60s[k] = other.t60s[k];
+        gainsDb[k] = other.gainsDb[k];
+    }
+    usesGains = other.usesGains;
+    changed = true;
+}
+
+// Band gains per dB of target: the dB responses of all band filters at the
+// design frequencies (centres and geometric midpoints) plus a column of ones
+// for the broadband gain, and the least squares solution (B^T B)^-1 B^T.
+void GraphicEQ::updateInteractionMatrix() {
+    int K = 0;
+    while (K < nrBands && getCentreFrequency(K) < 0.45 * Fs)
+        ++K;
+
+    const int M = 2 * K - 1;
+    const int columns = K + 1;
+    const double pi = MathConstants<double>::pi;
+    const double bandwidth = (nrBands == 10) ? 1.5 : 0.49;  // times the centre frequency
+
+    cosCentre.resize(K);
+    tanHalfBandwidth.resize(K);
+    std::vector<double> w(M);
+    for (int k = 0; k < K; ++k) {
+        const double wc = 2.0 * pi * getCentreFrequency(k) / Fs;
+        cosCentre[k] = std::cos(wc);
+        tanHalfBandwidth[k] = std::tan(jmin(0.5 * bandwidth * wc, 0.45 * pi));
+        w[2 * k] = wc;
+        if (k > 0)
+            w[2 * k - 1] = std::sqrt(w[2 * k - 2] * wc);
+    }
+
+    std::vector<double> B(M * columns);
+    for (int k = 0; k < K; ++k) {
+        double b[3], a[2];
+        peaking(prototypeGainDb, cosCentre[k], tanHalfBandwidth[k], b, a);
+        for (int m = 0; m < M; ++m)
+            B[m * columns + k] = magnitudeDb(b, a, w[m]) / prototypeGainDb;
+    }
+    for (int m = 0; m < M; ++m)
+        B[m * columns + K] = 1.0;
+
+    // [B^T B | B^T] reduced to [I | solver], with a little regularisation
+    const int width = columns + M;
+    std::vector<double> system(columns * width, 0.0);
+    for (int r = 0; r < columns; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            double sum = (r == c) ? 1.0e-6 : 0.0;
+            for (int m = 0; m < M; ++m)
+                sum += B[m * columns + r] * B[m * columns + c];
+            system[r * width + c] = sum;
+        }
+        for (int m = 0; m < M; ++m)
+            system[r * width + columns + m] = B[m * columns + r];
+    }
+
+    for (int c = 0; c < columns; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < columns; ++r)
+            if (std::abs(system[r * width + c]) > std::abs(system[pivot * width + c]))
+                pivot = r;
+        if (pivot != c)
+            for (int j = 0; j < width; ++j)
+                std::swap(system[c * width + j], system[pivot * width + j]);
+
+        const double inv = 1.0 / system[c * width + c];
+        for (int j = 0; j < width; ++j)
+            system[c * width + j] *= inv;
+        for (int r = 0; r < columns; ++r) {
+            if (r == c)
+                continue;
+            const double factor = system[r * width + c];
+            if (factor != 0.0)
+                for (int j = 0; j < width; ++j)
+                    system[r * width + j] -= factor * system[c * width + j];
+        }
+    }
+
+    solver.resize(columns * M);
+    for (int r = 0; r < columns; ++r)
+        for (int m = 0; m < M; ++m)
+            solver[r * M + m] = system[r * width + columns + m];
+
+    designedBands = nrBands;
+}
+
+void GraphicEQ::update() {
+    if (design.gain.empty() || !changed.exchange(false))
+        return;
+
+    const double start = Time::getMillisecondCounterHiRes();
+
+    if (designedBands != nrBands)
+        updateInteractionMatrix();
+
+    const int K = (int)cosCentre.size();
+    const int M = 2 * K - 1;
+    const int numLines = nrLines.load();
+
+    // target in dB per sample at the design frequencies
+    std::vector<double> target(M);
+    for (int k = 0; k < K; ++k) {
+        target[2 * k] = usesGains ? gainsDb[k] : -60.0 / (t60s[k] * Fs);
+        if (k > 0)
+            target[2 * k - 1] = 0.5 * (target[2 * k - 2] + target[2 * k]);
+    }
+    double perSample[maxBands + 1];
+    for (int r = 0; r <= K; ++r) {
+        double sum = 0.0;
+        for (int m = 0; m < M; ++m)
+            sum += solver[r * M + m] * target[m];
+        perSample[r] = sum;
+    }
+
+    for (int i = 0; i < numLines; ++i) {
+        const double delay = lineDelays[i].load();
+        for (int k = 0; k < K; ++k) {
+            double b[3], a[2];
+            peaking(delay * perSample[k], cosCentre[k], tanHalfBandwidth[k], b, a);
+            const int index = k * maxLines + i;
+            design.b0[index] = (float)b[0];
+            design.b1[index] = (float)b[1];
+            design.b2[index] = (float)b[2];
+            design.a1[index] = (float)a[0];
+            design.a2[index] = (float)a[1];
+        }
+        design.gain[i] = (float)std::pow(10.0, delay * perSample[K] / 20.0);
+    }
+    design.nrBands = K;
+    design.numLines = numLines;
+
+    {
+        const SpinLock::ScopedLockType lock(coefficientLock);
+        pending = design;
+        coefficientsReady = true;
+    }
+
+    designTimeMs = Time::getMillisecondCounterHiRes() - start;
+}
+
+void GraphicEQ::applyPendingCoefficients() {
+    const SpinLock::ScopedTryLockType lock(coefficientLock);
+    if (!lock.isLocked())
+        return;
+    std::swap(active, pending);
+    coefficientsReady = false;
+}
+
+bool GraphicEQ::process(int channel, float* lines, int numLines) {
+    if (channel == 0 && coefficientsReady.load())
+        applyPendingCoefficients();
+
+    // nothing designed for this order yet
+    if (active.numLines != numLines)
+        return false;
+
+    float* s = state[channel].data();
+    for (int k = 0; k < active.nrBands; ++k) {
+        const float* b0 = active.b0.data() + k * maxLines;
+        const float* b1 = active.b1.data() + k * maxLines;
+        const float* b2 = active.b2.data() + k * maxLines;
+        const float* a1 = active.a1.data() + k * maxLines;
+        const float* a2 = active.a2.data() + k * maxLines;
+        float* z1 = s + 2 * k * maxLines;
+        float* z2 = z1 + maxLines;
+
+        // transposed direct form II, one band across all lines
+        for (int i = 0; i < numLines; ++i) {
+            const float x = lines[i];
+            const float y = b0[i] * x + z1[i];
+            z1[i] = b1[i] * x - a1[i] * y + z2[i];
+            z2[i] = b2[i] * x - a2[i] * y;
+            lines[i] = y;
+        }
+    }
+    FloatVectorOperations::multiply(lines, active.gain.data(), numLines);
+    return true;
+}
@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    GraphicEQ.h
+    Created: 19 Oct 2026 9:58:03pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Attenuation filter with a T60 per octave (10 bands) or third octave (31
+// bands), used instead of the low and high shelves. Every line gets a cascade
+// of peaking filters plus a broadband gain, designed like the accurate cascade
+// graphic EQ of Valimaki and Liski: the dB response of each band filter at the
+// band centres and between them is collected once in an interaction matrix, and
+// the band gains are the least squares solution against the target.
+//
+// The attenuation of a line is its delay times the attenuation per sample, so
+// the least squares solution only has to be found once per design and is then
+// scaled for every line. What is left per line are the biquad coefficients.
+//
+// Designed on the message thread with update(), the audio thread picks the new
+// coefficients up at the next sample. The cascade runs band by band across all
+// lines (structure of arrays).
+//
+// With setGain() instead of setT60() it is a plain graphic EQ: the band gains
+// are taken as the attenuation per sample, so a single line with a delay of
+// one sample gets exactly those gains.
+class GraphicEQ {
+
+public:
+
+    GraphicEQ();
+    ~GraphicEQ();
+
+    void prepare(double sampleRate, int numChannels, int maxLines);
+
+    void reset();
+
+    // 10 or 31
+    void setNrBands(int newNrBands);
+    int getNrBands() const { return nrBands; }
+    float getCentreFrequency(int band) const;
+
+    void setT60(int band, float t60);
+    float getT60(int band) const { return t60s[band]; }
+    
+    // band gain in dB, switches from T60s to gains until the next setT60()
+    void setGain(int band, float gainDb);
+    float getGain(int band) const { return gainsDb[band]; }
+
+    // band T60s from the two shelves of the FDN, log interpolated between the transition frequencies
+    void setT60FromShelves(float lowT60, float highT60, float lowTransFreq, float highTransFreq);
+
+    // loop delay of every line in samples, safe to call from the audio thread
+    void setDelays(const float* delays, int numLines);
+
+    void copySettingsFrom(const GraphicEQ& other);
+
+    // message thread, designs the filters if anything has changed since the last time
+    void update();
+
+    double getDesignTime() const { return designTimeMs; }
+
+    // lines holds one sample per delay line and is filtered in place. False, with
+    // the lines untouched, until filters for this number of lines have been designed
+    bool process(int channel, float* lines, int numLines);
+
+    enum
+    {
+        maxBands = 31,
+        maxLines = 32,
+    };
+
+private:
+
+    struct Coefficients {
+        std::vector<float> b0, b1, b2, a1, a2;  // [band * maxLines + line]
+        std::vector<float> gain;                // broadband, per line
+        int nrBands = 0;
+        int numLines = 0;
+
+        void allocate();
+    };
+
+    void updateInteractionMatrix();
+    void applyPendingCoefficients();
+
+    Coefficients design, pending, active;   // message thread, shared, audio thread
+    std::atomic<bool> coefficientsReady { false };
+    SpinLock coefficientLock;
+
+    // [channel] -> two state rows per band of maxLines samples
+    std::vector<std::vector<float>> state;
+
+    // least squares solution, (nrBands + 1) x (2 nrBands - 1), the last row is the broadband gain
+    std::vector<double> solver;
+    std::vector<double> cosCentre, tanHalfBandwidth;
+
+    int nrBands = 10;
+    int designedBands = 0;
+    float t60s[maxBands];
+    float gainsDb[maxBands];
+    bool usesGains = false;
+    std::atomic<float> lineDelays[maxLines];
+    std::atomic<int> nrLines { 0 };
+    std::atomic<bool> changed { true };
+
+    double designTimeMs = 0.0;
+    double Fs = 44100.0;
+};
@@ -0,0 +1,219 @@
+/*
+  ==============================================================================
+
+    HybridConvolution.cpp
+    Created: 19 Oct 2026 11:41:52am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "HybridConvolution.h"
+
+HybridConvolution::HybridConvolution() : juce::Thread("FDN Impulse Renderer") {}
+
+HybridConvolution::~HybridConvolution() {
+    stopThread(5000);
+    delete pendingResponse.exchange(nullptr);
+    delete retiredResponse.exchange(nullptr);
+    delete currentResponse;
+}
+
+void HybridConvolution::prepare(double sampleRate, int numChannels, int samplesPerBlock) {
+    Fs = sampleRate;
+    nrChannels = numChannels;
+    engine.prepare(numChannels, (int)(maxImpulseSeconds * Fs));
+    convolutionBuffer.setSize(numChannels, samplesPerBlock);
+    silence.setSize(1, samplesPerBlock);
+    silence.clear();
+    inputChunk.resize(numChannels);
+    outputChunk.resize(numChannels);
+    fade.reset(Fs, 0.08);
+
+    // start over from the live FDN, the old response does not match the new rate
+    retireCurrentResponse();
+    state = live;
+    lastRenderedCount = -1;
+}
+
+void HybridConvolution::update(const FDN& liveFDN, const FDNSnapshot& settings, int changeCount, bool canFreeze) {
+    delete retiredResponse.exchange(nullptr);
+
+    if (changeCount != lastChangeCount) {
+        lastChangeCount = changeCount;
+        lastChangeTime = Time::getMillisecondCounter();
+    }
+
+    const bool settled = Time::getMillisecondCounter() - lastChangeTime > (uint32)settleTimeMs;
+    const bool idle = state.load() == live && !isThreadRunning()
+                   && pendingResponse.load() == nullptr && retiredResponse.load() == nullptr;
+
+    if (enabled && canFreeze && settled && idle && changeCount != lastRenderedCount) {
+        // built here, the audio thread is never waited for
+        renderFDN.reset(new FDN());
+        if (!renderFDN->copySettingsFrom(liveFDN, settings)) {
+            renderFDN.reset();
+            return;
+        }
+
+        // -90 dB is reached after 1.5 x T60
+        renderLength = jlimit((int)PartitionedConvolution::blockSize, (int)(maxImpulseSeconds * Fs),
+                              (int)(1.5f * renderFDN->getLongestT60() * Fs));
+        pendingChangeCount = changeCount;
+        lastRenderedCount = changeCount;
+        startThread(3);
+    }
+}
+
+void HybridConvolution::run() {
+    dsp::ProcessSpec spec;
+    spec.sampleRate = Fs;
+    spec.maximumBlockSize = 512;
+    spec.numChannels = (uint32)nrChannels;
+    renderFDN->prepare(spec);
+
+    AudioBuffer<float> irs(nrChannels * nrChannels, renderLength);
+    renderFDN->renderImpulseResponses(irs.getArrayOfWritePointers(), nrChannels, renderLength);
+    renderFDN.reset();
+
+    if (threadShouldExit())
+        return;
+
+    pendingResponse = new PartitionedConvolution::ImpulseResponse(irs.getArrayOfReadPointers(), nrChannels, renderLength,
+                                                                  PartitionedConvolution::blockSize, zeroLatency);
+}
+
+void HybridConvolution::checkForChanges(int changeCount) {
+    audioChangeCount = changeCount;
+
+    if (changeCount == frozenChangeCount)
+        return;
+
+    switch (state.load()) {
+        case priming:
+            retireCurrentResponse();
+            state = live;
+            break;
+        case fadeIn:
+            fade.setTargetValue(0.0f);
+            state = fadeOut;
+            break;
+        case convolution:
+            if (fdnCleared.load()) {
+                // the FDN starts over from silence and the old tail comes from the convolution
+                decayRemaining = currentResponse->length + PartitionedConvolution::blockSize;
+                state = decay;
+            } else {
+                // not cleared yet, so the FDN still holds the same tail
+                fade.setCurrentAndTargetValue(1.0f);
+                fade.setTargetValue(0.0f);
+                state = fadeOut;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool HybridConvolution::shouldResetFDN() {
+    if (state.load() != convolution || fdnCleared.load())
+        return false;
+    fdnCleared = true;
+    return true;
+}
+
+void HybridConvolution::installPendingResponse() {
+    if (state.load() != live || retiredResponse.load() != nullptr)
+        return;
+
+    if (auto* response = pendingResponse.exchange(nullptr)) {
+        if (pendingChangeCount.load() == audioChangeCount) {
+            if (currentResponse != nullptr)
+                retiredResponse = currentResponse;
+            engine.setImpulseResponse(response);
+            currentResponse = response;
+            frozenChangeCount = audioChangeCount;
+            primingRemaining = response->length + PartitionedConvolution::blockSize;
+            state = priming;
+        } else {
+            retiredResponse = response;
+        }
+    }
+}
+
+void HybridConvolution::retireCurrentResponse() {
+    engine.setImpulseResponse(nullptr);
+    if (currentResponse != nullptr && retiredResponse.load() == nullptr) {
+        retiredResponse = currentResponse;
+        currentResponse = nullptr;
+    }
+}
+
+void HybridConvolution::process(const float* const* input, float* const* wet, int numChannels, int numSamples) {
+    // the responses connect every channel, so they are all processed together
+    jassert(numChannels == nrChannels);
+    installPendingResponse();
+
+    for (int start = 0; start < numSamples && state.load() != live; start += convolutionBuffer.getNumSamples()) {
+        const int count = jmin(convolutionBuffer.getNumSamples(), numSamples - start);
+
+        // after a change only the tail of the old input is left to play
+        for (int ch = 0; ch < numChannels; ++ch) {
+            inputChunk[ch] = (state.load() == decay ? silence.getReadPointer(0) : input[ch] + start);
+            outputChunk[ch] = convolutionBuffer.getWritePointer(ch);
+        }
+        engine.process(inputChunk.data(), outputChunk.data(), count);
+
+        switch (state.load()) {
+            case priming:
+                // the FDN is still audible while the convolution history fills up
+                primingRemaining -= count;
+                if (primingRemaining <= 0) {
+                    fade.setCurrentAndTargetValue(0.0f);
+                    fade.setTargetValue(1.0f);
+                    state = fadeIn;
+                }
+                break;
+
+            case fadeIn:
+            case fadeOut:
+                for (int n = 0; n < count; ++n) {
+                    const float g = fade.getNextValue();
+                    for (int ch = 0; ch < numChannels; ++ch) {
+                        float* w = wet[ch] + start;
+                        w[n] = g * convolutionBuffer.getSample(ch, n) + (1.0f - g) * w[n];
+                    }
+                }
+                if (!fade.isSmoothing()) {
+                    if (state.load() == fadeIn) {
+                        fdnCleared = false;
+                        state = convolution;
+                    } else {
+                        retireCurrentResponse();
+                        state = live;
+                    }
+                }
+                break;
+
+            case convolution:
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    FloatVectorOperations::copy(wet[ch] + start, convolutionBuffer.getReadPointer(ch), count);
+                }
+                break;
+
+            case decay:
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    FloatVectorOperations::add(wet[ch] + start, convolutionBuffer.getReadPointer(ch), count);
+                }
+                decayRemaining -= count;
+                if (decayRemaining <= 0) {
+                    retireCurrentResponse();
+                    state = live;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    HybridConvolution.h
+    Created: 19 Oct 2026 11:41:52am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FDN.hpp"
+#include "PartitionedConvolution.h"
+
+// Freezes a static FDN into a convolution. Once the parameters have not changed
+// for a while, the impulse responses of a copy of the live FDN are rendered on a
+// background thread and handed to the audio thread, from every input channel to
+// every output channel, as the channels of the FDN share its matrix and filters.
+// The convolution is then run silently until its history is filled, crossfaded
+// in, and from then on the FDN is not processed at all. A parameter change
+// starts the FDN again from silence, while the convolution, fed with silence,
+// plays out the tail of what came before.
+//
+// Only one impulse response is in flight at a time: it moves from pending
+// (render thread) to current (audio thread) to retired (deleted by update()).
+class HybridConvolution : private juce::Thread {
+
+public:
+
+    HybridConvolution();
+    ~HybridConvolution() override;
+
+    void prepare(double sampleRate, int numChannels, int samplesPerBlock);
+
+    // message thread
+    void setEnabled(bool shouldBeEnabled) { enabled = shouldBeEnabled; }
+    bool isEnabled() const { return enabled; }
+    void setZeroLatency(bool shouldBeZeroLatency) { zeroLatency = shouldBeZeroLatency; }
+    // settings is the latest snapshot of the live FDN, see FDN::copySettingsFrom()
+    void update(const FDN& liveFDN, const FDNSnapshot& settings, int changeCount, bool canFreeze);
+
+    // audio thread
+    void checkForChanges(int changeCount);
+    // true once after the convolution has taken over, the caller clears all of the FDN's state
+    bool shouldResetFDN();
+    // also true with a response waiting, process() is what takes it over
+    bool isActive() const { return state.load() != live || pendingResponse.load() != nullptr; }
+    bool needsFDN() const { return state.load() != convolution; }
+    void process(const float* const* input, float* const* wet, int numChannels, int numSamples);
+
+    enum
+    {
+        live,
+        priming,
+        fadeIn,
+        convolution,
+        fadeOut,
+        decay,
+    };
+
+    int getState() const { return state.load(); }
+
+private:
+
+    void run() override;
+    void installPendingResponse();
+    void retireCurrentResponse();
+
+    enum
+    {
+        settleTimeMs = 500,
+        maxImpulseSeconds = 10,
+    };
+
+    PartitionedConvolution engine;
+    AudioBuffer<float> convolutionBuffer;
+    AudioBuffer<float> silence;
+    std::vector<const float*> inputChunk;
+    std::vector<float*> outputChunk;
+    SmoothedValue<float, ValueSmoothingTypes::Linear> fade;
+
+    std::unique_ptr<FDN> renderFDN;
+    int renderLength = 0;
+    int lastRenderedCount = -1;
+
+    std::atomic<PartitionedConvolution::ImpulseResponse*> pendingResponse { nullptr };
+    std::atomic<PartitionedConvolution::ImpulseResponse*> retiredResponse { nullptr };
+    std::atomic<int> pendingChangeCount { -1 };
+    PartitionedConvolution::ImpulseResponse* currentResponse = nullptr;
+
+    std::atomic<int> state { live };
+    std::atomic<bool> fdnCleared { false };
+    int frozenChangeCount = -1;
+    int audioChangeCount = 0;
+    int primingRemaining = 0;
+    int decayRemaining = 0;
+
+    int lastChangeCount = -1;
+    uint32 lastChangeTime = 0;
+
+    double Fs = 44100.0;
+    int nrChannels = 2;
+    bool enabled = false;
+    bool zeroLatency = true;
+};
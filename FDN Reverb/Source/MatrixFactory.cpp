@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    MatrixFactory.cpp
+    Created: 19 Oct 2026 5:40:03pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "MatrixFactory.h"
+
+namespace
+{
+    const char* const typeNames[] = { "randomOrthogonal", "hadamard", "householder", "circulant", "blockDiagonal", "nested" };
+}
+
+int MatrixFactory::getTypeFromName(const String& name) {
+    for (int i = 0; i < (int)(sizeof(typeNames) / sizeof(typeNames[0])); ++i) {
+        if (name.compare(typeNames[i]) == 0)
+            return randomOrthogonal + i;
+    }
+    return -1;
+}
+
+String MatrixFactory::getName(int type) {
+    if (!isGenerated(type))
+        return {};
+    return typeNames[type - randomOrthogonal];
+}
+
+std::vector<float> MatrixFactory::create(int type, int N, int seed) {
+    switch (type) {
+        case randomOrthogonal: return createRandomOrthogonal(N, seed);
+        case hadamard:         return createHadamard(N);
+        case householder:      return createHouseholder(N);
+        case circulant:        return createCirculant(N, seed);
+        case blockDiagonal:    return createBlockDiagonal(N, seed);
+        case nested:           return createNested(N, seed);
+        default:               break;
+    }
+
+    std::vector<float> identity(N * N, 0.0f);
+    for (int i = 0; i < N; ++i)
+        identity[i * N + i] = 1.0f;
+    return identity;
+}
+
+// Box-Muller on juce::Random, so a seed gives the same matrix on every platform
+double MatrixFactory::nextGaussian(Random& random) {
+    const double u1 = jmax(1.0e-12, random.nextDouble());
+    const double u2 = random.nextDouble();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(MathConstants<double>::twoPi * u2);
+}
+
+void MatrixFactory::randomOrthogonalInto(std::vector<double>& Q, int N, Random& random) {
+    std::vector<double> A(N * N);
+    for (auto& a : A)
+        a = nextGaussian(random);
+
+    // A = Q R with Householder reflections, Q is accumulated from the identity
+    Q.assign(N * N, 0.0);
+    for (int i = 0; i < N; ++i)
+        Q[i * N + i] = 1.0;
+
+    std::vector<double> v(N);
+    std::vector<double> signs(N, 1.0);
+    for (int k = 0; k < N; ++k) {
+        double norm = 0.0;
+        for (int i = k; i < N; ++i)
+            norm += A[i * N + k] * A[i * N + k];
+        norm = std::sqrt(norm);
+
+        const double alpha = A[k * N + k] > 0.0 ? -norm : norm;
+        // R_kk = alpha, the sign is undone below so Q is Haar distributed
+        signs[k] = alpha < 0.0 ? -1.0 : 1.0;
+
+        std::fill(v.begin(), v.end(), 0.0);
+        for (int i = k; i < N; ++i)
+            v[i] = A[i * N + k];
+        v[k] -= alpha;
+
+        double vNorm = 0.0;
+        for (int i = k; i < N; ++i)
+            vNorm += v[i] * v[i];
+        if (vNorm < 1.0e-20)
+            continue;
+
+        // A = H A and Q = Q H, with H = I - 2 v v^T / (v^T v)
+        for (int j = k; j < N; ++j) {
+            double dot = 0.0;
+            for (int i = k; i < N; ++i)
+                dot += v[i] * A[i * N + j];
+            const double f = 2.0 * dot / vNorm;
+            for (int i = k; i < N; ++i)
+                A[i * N + j] -= f * v[i];
+        }
+        for (int i = 0; i < N; ++i) {
+            double dot = 0.0;
+            for (int j = k; j < N; ++j)
+                dot += Q[i * N + j] * v[j];
+            const double f = 2.0 * dot / vNorm;
+            for (int j = k; j < N; ++j)
+                Q[i * N + j] -= f * v[j];
+        }
+    }
+
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            Q[i * N + j] *= signs[j];
+}
+
+std::vector<float> MatrixFactory::createRandomOrthogonal(int N, int seed) {
+    Random random(seed);
+    std::vector<double> Q;
+    randomOrthogonalInto(Q, N, random);
+    return std::vector<float>(Q.begin(), Q.end());
+}
+
+std::vector<float> MatrixFactory::createHadamard(int N) {
+    if (!isPowerOfTwo(N))
+        return createHouseholder(N);
+
+    std::vector<float> H(N * N);
+    const float h = 1.0f / std::sqrt((float)N);
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            H[i * N + j] = (countNumberOfBits((uint32)(i & j)) & 1) ? -h : h;
+    return H;
+}
+
+std::vector<float> MatrixFactory::createHouseholder(int N) {
+    std::vector<float> H(N * N);
+    const float h = 2.0f / N;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            H[i * N + j] = (i == j ? 1.0f : 0.0f) - h;
+    return H;
+}
+
+// Eigenvalues e^(i phi_k) with phi_(N-k) = -phi_k, the real bins are +-1.
+// The first column is their inverse DFT and every row is a rotation of it.
+std::vector<float> MatrixFactory::createCirculant(int N, int seed) {
+    Random random(seed);
+    std::vector<double> phases(N, 0.0);
+    for (int k = 0; k <= N / 2; ++k) {
+        const bool realBin = (k == 0 || 2 * k == N);
+        phases[k] = realBin ? (random.nextBool() ? 0.0 : MathConstants<double>::pi)
+                            : random.nextDouble() * MathConstants<double>::twoPi;
+        if (k > 0 && !realBin)
+            phases[N - k] = -phases[k];
+    }
+
+    std::vector<double> column(N, 0.0);
+    for (int n = 0; n < N; ++n) {
+        for (int k = 0; k < N; ++k)
+            column[n] += std::cos(phases[k] + MathConstants<double>::twoPi * k * n / N);
+        column[n] /= N;
+    }
+
+    std::vector<float> C(N * N);
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            C[i * N + j] = (float)column[(i - j + N) % N];
+    return C;
+}
+
+std::vector<float> MatrixFactory::createBlockDiagonal(int N, int seed, int blockSize) {
+    Random random(seed);
+    std::vector<float> B(N * N, 0.0f);
+    std::vector<double> Q;
+
+    for (int start = 0; start < N; start += blockSize) {
+        const int size = jmin(blockSize, N - start);
+        randomOrthogonalInto(Q, size, random);
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j)
+                B[(start + i) * N + start + j] = (float)Q[i * size + j];
+    }
+    return B;
+}
+
+std::vector<float> MatrixFactory::createNested(int N, int seed) {
+    if (!isPowerOfTwo(N) || N < 2)
+        return createRandomOrthogonal(N, seed);
+
+    Random random(seed);
+    std::vector<double> K { 1.0 };
+    int size = 1;
+
+    // K = R(theta) (x) K, one random rotation per level
+    while (size < N) {
+        const double angle = random.nextDouble() * MathConstants<double>::halfPi;
+        const double R[4] = { std::cos(angle), -std::sin(angle), std::sin(angle), std::cos(angle) };
+
+        std::vector<double> next(4 * size * size);
+        for (int a = 0; a < 2; ++a)
+            for (int b = 0; b < 2; ++b)
+                for (int i = 0; i < size; ++i)
+                    for (int j = 0; j < size; ++j)
+                        next[(a * size + i) * 2 * size + b * size + j] = R[a * 2 + b] * K[i * size + j];
+        K.swap(next);
+        size *= 2;
+    }
+    return std::vector<float>(K.begin(), K.end());
+}
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    MatrixFactory.h
+    Created: 19 Oct 2026 5:40:03pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Builds orthogonal feedback matrices of any order, row-major N x N. Runs in
+// microseconds for the orders used here, but allocates, so it is only called
+// from the message thread. The same type, order and seed always give the same
+// matrix.
+class MatrixFactory {
+
+public:
+
+    // values match MATRIXSELECTION, 1 - 3 are identity, custom (OSC) and scattering.
+    // filterMatrix is not built here, it is a FilterFeedbackMatrix made of two of these.
+    enum Type
+    {
+        randomOrthogonal = 4,
+        hadamard,
+        householder,
+        circulant,
+        blockDiagonal,
+        nested,
+        filterMatrix,
+    };
+
+    static bool isGenerated(int matrixSelection) { return matrixSelection >= randomOrthogonal && matrixSelection <= nested; }
+
+    // name as used over OSC, e.g. "hadamard", or -1 if the name is unknown
+    static int getTypeFromName(const String& name);
+    static String getName(int type);
+
+    static std::vector<float> create(int type, int N, int seed);
+
+    // Haar distributed, QR of a Gaussian matrix by Householder reflections
+    static std::vector<float> createRandomOrthogonal(int N, int seed);
+    // Sylvester construction, Householder if N is not a power of two
+    static std::vector<float> createHadamard(int N);
+    // I - 2/N 11^T
+    static std::vector<float> createHouseholder(int N);
+    // random unit modulus spectrum, real because it is conjugate symmetric
+    static std::vector<float> createCirculant(int N, int seed);
+    // random orthogonal blocks on the diagonal, no mixing between the blocks
+    static std::vector<float> createBlockDiagonal(int N, int seed, int blockSize = 4);
+    // Kronecker product of 2 x 2 rotations, random orthogonal if N is not a power of two
+    static std::vector<float> createNested(int N, int seed);
+
+private:
+
+    static double nextGaussian(Random& random);
+    static void randomOrthogonalInto(std::vector<double>& Q, int N, Random& random);
+};
@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+    MatrixHeatmap.cpp
+    Created: 20 Oct 2026 2:41:09pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "MatrixHeatmap.h"
+
+MatrixHeatmap::MatrixHeatmap() {
+    setOpaque(true);
+}
+
+MatrixHeatmap::~MatrixHeatmap() {}
+
+void MatrixHeatmap::setMatrix(const float* coefficients, int newSize, uint32 version) {
+    if (version == shownVersion && newSize == size)
+        return;
+
+    shownVersion = version;
+    size = newSize;
+    matrix.assign(coefficients, coefficients + size * size);
+    imageChanged = true;
+
+    if (hoveredRow >= size || hoveredColumn >= size)
+        hoveredRow = hoveredColumn = -1;
+    repaint();
+}
+
+Colour MatrixHeatmap::getColour(float value, float range) {
+    const float x = range > 0.0f ? jlimit(-1.0f, 1.0f, value / range) : 0.0f;
+    // square root so that the small coefficients of a large matrix still show
+    const float level = std::sqrt(std::abs(x));
+    if (x >= 0.0f)
+        return Colour::fromFloatRGBA(level, 0.35f * level, 0.1f * level, 1.0f);
+    return Colour::fromFloatRGBA(0.1f * level, 0.45f * level, level, 1.0f);
+}
+
+void MatrixHeatmap::renderImage() {
+    imageChanged = false;
+    if (size == 0) {
+        image = Image();
+        return;
+    }
+
+    float range = 0.0f;
+    for (const float value : matrix)
+        range = jmax(range, std::abs(value));
+
+    if (image.isNull() || image.getWidth() != size)
+        image = Image(Image::RGB, size, size, false);
+
+    for (int row = 0; row < size; ++row)
+        for (int column = 0; column < size; ++column)
+            image.setPixelAt(column, row, getColour(matrix[row * size + column], range));
+}
+
+// square, centred in the component
+Rectangle<int> MatrixHeatmap::getGridArea() const {
+    const int side = jmin(getWidth(), getHeight());
+    return Rectangle<int>((getWidth() - side) / 2, (getHeight() - side) / 2, side, side);
+}
+
+void MatrixHeatmap::paint(Graphics& g) {
+    g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+
+    if (imageChanged)
+        renderImage();
+    if (size == 0 || image.isNull())
+        return;
+
+    // nearest neighbour, every coefficient stays a sharp square
+    const auto area = getGridArea();
+    g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+    g.drawImage(image, area.toFloat());
+
+    if (hoveredRow >= 0) {
+        g.setColour(Colours::ghostwhite);
+        g.setFont(Font("Arial", 11.f, Font::plain));
+        g.drawText("[" + String(hoveredRow) + "][" + String(hoveredColumn) + "] "
+                   + String(matrix[hoveredRow * size + hoveredColumn], 4),
+                   area.getX() + 2, area.getY() + 2, area.getWidth() - 4, 14, Justification::topLeft);
+    }
+}
+
+void MatrixHeatmap::mouseMove(const MouseEvent& event) {
+    const auto area = getGridArea();
+    int row = -1, column = -1;
+    if (size > 0 && area.getWidth() > 0 && event.x >= area.getX() && event.x < area.getRight()
+        && event.y >= area.getY() && event.y < area.getBottom()) {
+        column = (event.x - area.getX()) * size / area.getWidth();
+        row = (event.y - area.getY()) * size / area.getHeight();
+    }
+
+    if (row != hoveredRow || column != hoveredColumn) {
+        hoveredRow = row;
+        hoveredColumn = column;
+        repaint();
+    }
+}
+
+void MatrixHeatmap::mouseExit(const MouseEvent&) {
+    if (hoveredRow >= 0) {
+        hoveredRow = hoveredColumn = -1;
+        repaint();
+    }
+}
@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    MatrixHeatmap.h
+    Created: 20 Oct 2026 2:41:09pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// The mixing matrix as a grid of colours, red for positive and blue for
+// negative coefficients, scaled to the largest magnitude. The grid is kept in
+// an image with one pixel per coefficient that is only drawn again when a
+// matrix with a new version comes in, paint() just stretches it over the
+// component. The coefficient under the mouse is written in the corner.
+class MatrixHeatmap : public juce::Component {
+
+public:
+
+    MatrixHeatmap();
+    ~MatrixHeatmap() override;
+
+    // message thread, size x size and row major, ignored if the version is the one shown
+    void setMatrix(const float* coefficients, int size, uint32 version);
+
+    void paint(Graphics& g) override;
+    void mouseMove(const MouseEvent& event) override;
+    void mouseExit(const MouseEvent& event) override;
+
+    // value between -range and range, black at 0
+    static Colour getColour(float value, float range);
+
+private:
+
+    void renderImage();
+    Rectangle<int> getGridArea() const;
+
+    std::vector<float> matrix;
+    int size = 0;
+    uint32 shownVersion = 0;
+    bool imageChanged = false;
+    Image image;
+
+    int hoveredRow = -1, hoveredColumn = -1;
+};
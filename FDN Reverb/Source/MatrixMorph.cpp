@@ -0,0 +1,305 @@
+/*
+  ==============================================================================
+
+    MatrixMorph.cpp
+    Created: 19 Oct 2026 7:48:12pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "MatrixMorph.h"
+
+MatrixMorph::MatrixMorph() : juce::Thread("FDN Matrix Morph") {}
+
+MatrixMorph::~MatrixMorph() {
+    stopThread(1000);
+}
+
+void MatrixMorph::Plan::allocate(int maxLines) {
+    base.resize(maxLines * maxLines);
+    target.resize(maxLines * maxLines);
+    // N(N-1)/2 rotations for the factorisation, at most N/2 more for the signs
+    first.resize(maxLines * maxLines);
+    second.resize(maxLines * maxLines);
+    angle.resize(maxLines * maxLines);
+    numLines = 0;
+    nrRotations = 0;
+    steps = 0;
+}
+
+void MatrixMorph::prepare(double sampleRate, int maxLines) {
+    // the worker uses the buffers, so it is stopped while they are allocated
+    stopThread(1000);
+
+    Fs = sampleRate;
+    maxNrLines = maxLines;
+
+    building.allocate(maxLines);
+    pending.allocate(maxLines);
+    active.allocate(maxLines);
+    requestedTarget.resize(maxLines * maxLines);
+    snapshot.resize(maxLines * maxLines);
+    work.resize(maxLines * maxLines);
+    cosines.resize(maxLines * maxLines);
+    sines.resize(maxLines * maxLines);
+    stepCosines.resize(maxLines * maxLines);
+    stepSines.resize(maxLines * maxLines);
+
+    planReady = targetRequested = snapshotRequested = snapshotReady = waitingForPlan = false;
+    running = false;
+    morphing = false;
+    samplesUntilUpdate = 0;
+
+    if (morphTime > 0.0f)
+        startThread(4);
+}
+
+void MatrixMorph::setMorphTime(float seconds) {
+    morphTime = jlimit(0.0f, 30.0f, seconds);
+
+    if (morphTime > 0.0f) {
+        if (!isThreadRunning())
+            startThread(4);
+        return;
+    }
+
+    // whatever was on its way is dropped, the matrix stays where the morph left it
+    stopThread(1000);
+    const SpinLock::ScopedLockType lock(stateLock);
+    planReady = targetRequested = snapshotRequested = snapshotReady = waitingForPlan = false;
+    running = false;
+    morphing = false;
+}
+
+void MatrixMorph::setTarget(const std::vector<float>& matrix, int numLines) {
+    if (numLines > maxNrLines || (int)matrix.size() < numLines * numLines)
+        return;
+
+    {
+        const SpinLock::ScopedLockType lock(stateLock);
+        std::copy(matrix.begin(), matrix.begin() + numLines * numLines, requestedTarget.begin());
+        requestedLines = numLines;
+        targetRequested = true;
+        morphing = true;
+    }
+    notify();
+}
+
+void MatrixMorph::cancel() {
+    const SpinLock::ScopedLockType lock(stateLock);
+    planReady = targetRequested = snapshotRequested = snapshotReady = false;
+    ++cancelCount;
+    cancelRequested = true;
+    morphing = false;
+}
+
+bool MatrixMorph::trySetTarget(const float* matrix, int numLines) {
+    if (numLines > maxNrLines)
+        return false;
+
+    const SpinLock::ScopedTryLockType lock(stateLock);
+    if (!lock.isLocked())
+        return false;
+
+    if (matrix != nullptr) {
+        std::copy(matrix, matrix + numLines * numLines, requestedTarget.begin());
+    } else {
+        std::fill(requestedTarget.begin(), requestedTarget.begin() + numLines * numLines, 0.0f);
+        for (int i = 0; i < numLines; ++i)
+            requestedTarget[i * numLines + i] = 1.0f;
+    }
+    requestedLines = numLines;
+    targetRequested = true;
+    morphing = true;
+    return true;
+}
+
+// Waits for a target, asks the audio thread for the matrix it is at right now
+// and factors the way between the two. A newer target on the way restarts it.
+void MatrixMorph::run() {
+    while (!threadShouldExit()) {
+        wait(5);
+
+        int numLines = 0;
+        int generation = 0;
+        {
+            const SpinLock::ScopedLockType lock(stateLock);
+            generation = cancelCount;
+            if (targetRequested) {
+                std::copy(requestedTarget.begin(), requestedTarget.begin() + requestedLines * requestedLines,
+                          building.target.begin());
+                building.numLines = requestedLines;
+                targetRequested = false;
+                snapshotRequested = true;
+                snapshotReady = false;
+            } else if (snapshotReady) {
+                std::copy(snapshot.begin(), snapshot.begin() + snapshotLines * snapshotLines, building.base.begin());
+                numLines = snapshotLines;
+                snapshotReady = false;
+            }
+        }
+        if (numLines == 0)
+            continue;
+
+        buildPlan(numLines);
+
+        const SpinLock::ScopedLockType lock(stateLock);
+        if (generation != cancelCount)
+            continue;
+        std::swap(building, pending);
+        planReady = true;
+    }
+}
+
+// Givens QR of Q = A^T B: G_M^T ... G_1^T Q = D, so Q = G_1 ... G_M D, where D
+// is diagonal with entries +-1. Pairs of -1 are rotations by pi.
+void MatrixMorph::buildPlan(int numLines) {
+    Plan& plan = building;
+    plan.nrRotations = 0;
+    plan.steps = jmax(1, roundToInt(morphTime * Fs / subBlockSize));
+
+    // the target was built for another order, the audio thread drops the plan
+    if (plan.numLines != numLines)
+        return;
+
+    const int N = numLines;
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            double sum = 0.0;
+            for (int k = 0; k < N; ++k)
+                sum += (double)plan.base[k * N + i] * plan.target[k * N + j];
+            work[i * N + j] = sum;
+        }
+    }
+
+    for (int i = 0; i < N - 1; ++i) {
+        for (int j = i + 1; j < N; ++j) {
+            const double a = work[i * N + i];
+            const double b = work[j * N + i];
+            if (std::abs(b) < 1.0e-9)
+                continue;
+
+            const double r = std::sqrt(a * a + b * b);
+            const double c = a / r;
+            const double s = b / r;
+            for (int k = i; k < N; ++k) {
+                const double x = work[i * N + k];
+                const double y = work[j * N + k];
+                work[i * N + k] = c * x + s * y;
+                work[j * N + k] = -s * x + c * y;
+            }
+
+            plan.first[plan.nrRotations] = i;
+            plan.second[plan.nrRotations] = j;
+            plan.angle[plan.nrRotations] = (float)std::atan2(s, c);
+            plan.nrRotations++;
+        }
+    }
+
+    int negative[64];
+    int nrNegative = 0;
+    for (int i = 0; i < N && nrNegative < 64; ++i) {
+        if (work[i * N + i] < 0.0)
+            negative[nrNegative++] = i;
+    }
+
+    // det(Q) = -1, no rotation gets there: negate a column of the target instead
+    if (nrNegative % 2 == 1) {
+        const int column = negative[--nrNegative];
+        for (int r = 0; r < N; ++r)
+            plan.target[r * N + column] = -plan.target[r * N + column];
+    }
+
+    for (int p = 0; p + 1 < nrNegative; p += 2) {
+        plan.first[plan.nrRotations] = negative[p];
+        plan.second[plan.nrRotations] = negative[p + 1];
+        plan.angle[plan.nrRotations] = MathConstants<float>::pi;
+        plan.nrRotations++;
+    }
+}
+
+void MatrixMorph::startPlan() {
+    for (int k = 0; k < active.nrRotations; ++k) {
+        const float increment = active.angle[k] / active.steps;
+        cosines[k] = 1.0f;
+        sines[k] = 0.0f;
+        stepCosines[k] = std::cos(increment);
+        stepSines[k] = std::sin(increment);
+    }
+    step = 0;
+    running = true;
+}
+
+void MatrixMorph::process(int channel, float* matrix, int numLines) {
+    // checked every sample, the matrix that replaced the morph must stay as it is
+    if (channel == 0 && cancelRequested.load(std::memory_order_relaxed) && cancelRequested.exchange(false)) {
+        running = false;
+        waitingForPlan = false;
+    }
+
+    if (channel != 0 || --samplesUntilUpdate > 0)
+        return;
+    samplesUntilUpdate = subBlockSize;
+
+    {
+        const SpinLock::ScopedTryLockType lock(stateLock);
+        if (lock.isLocked()) {
+            if (snapshotRequested) {
+                std::copy(matrix, matrix + numLines * numLines, snapshot.begin());
+                snapshotLines = numLines;
+                snapshotRequested = false;
+                snapshotReady = true;
+                waitingForPlan = true;
+            } else if (planReady && !snapshotReady) {
+                std::swap(pending, active);
+                planReady = false;
+                waitingForPlan = false;
+                running = false;
+                if (active.numLines == numLines)
+                    startPlan();
+            }
+            morphing = running || waitingForPlan || planReady || snapshotRequested || targetRequested;
+        }
+    }
+
+    // the order of the FDN has changed underneath the morph
+    if (running && active.numLines != numLines)
+        running = false;
+
+    if (running && !waitingForPlan)
+        updateMatrix(matrix);
+}
+
+void MatrixMorph::updateMatrix(float* matrix) {
+    const int N = active.numLines;
+
+    if (++step >= active.steps) {
+        std::copy(active.target.begin(), active.target.begin() + N * N, matrix);
+        running = false;
+        return;
+    }
+
+    std::copy(active.base.begin(), active.base.begin() + N * N, matrix);
+
+    for (int k = 0; k < active.nrRotations; ++k) {
+        // one more step of the angle, renormalised so the rounding does not build up
+        float c = cosines[k] * stepCosines[k] - sines[k] * stepSines[k];
+        float s = sines[k] * stepCosines[k] + cosines[k] * stepSines[k];
+        const float g = 1.5f - 0.5f * (c * c + s * s);
+        c *= g;
+        s *= g;
+        cosines[k] = c;
+        sines[k] = s;
+
+        // A <- A G, only columns i and j change
+        const int i = active.first[k];
+        const int j = active.second[k];
+        for (int r = 0; r < N; ++r) {
+            const float x = matrix[r * N + i];
+            const float y = matrix[r * N + j];
+            matrix[r * N + i] = c * x + s * y;
+            matrix[r * N + j] = -s * x + c * y;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    MatrixMorph.h
+    Created: 19 Oct 2026 7:48:12pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Glides the feedback matrix from one orthogonal matrix to another instead of
+// swapping it. A worker thread factors Q = A^T B into Givens rotations,
+// Q = G_1 ... G_M, and the audio thread walks A(t) = A G_1(t theta_1) ... G_M(t theta_M)
+// from t = 0 to 1, rebuilding the matrix once per sub-block. Every step is a
+// product of rotations, so the loop stays lossless on the way.
+//
+// A rotation path only exists between matrices with the same determinant. If
+// they differ, one column of the target is negated (the sign of one delay line
+// in the mix), which is still orthogonal and sounds the same.
+class MatrixMorph : private juce::Thread {
+
+public:
+
+    MatrixMorph();
+    ~MatrixMorph() override;
+
+    void prepare(double sampleRate, int maxLines);
+
+    // 0 switches the morph off, the worker only runs while it is on
+    void setMorphTime(float seconds);
+    float getMorphTime() const { return morphTime; }
+
+    // message thread
+    void setTarget(const std::vector<float>& matrix, int numLines);
+
+    // audio thread, gives up instead of waiting for the worker. nullptr is the identity.
+    bool trySetTarget(const float* matrix, int numLines);
+
+    // message thread, drops the morph that is running or on its way, so that a
+    // matrix that is swapped in directly is not rotated further by the audio thread
+    void cancel();
+
+    bool isMorphing() const { return morphing.load(); }
+
+    // audio thread, matrix is the N x N row-major mixing matrix and is changed in
+    // place. Time moves on with channel 0.
+    void process(int channel, float* matrix, int numLines);
+
+    enum
+    {
+        subBlockSize = 32,
+    };
+
+private:
+
+    struct Plan {
+        std::vector<float> base;        // matrix at the start of the morph
+        std::vector<float> target;
+        std::vector<int> first;         // plane of every rotation
+        std::vector<int> second;
+        std::vector<float> angle;
+        int numLines = 0;
+        int nrRotations = 0;
+        int steps = 0;
+
+        void allocate(int maxLines);
+    };
+
+    void run() override;
+    void buildPlan(int numLines);
+    void startPlan();
+    void updateMatrix(float* matrix);
+
+    Plan building, pending, active;     // worker, shared, audio thread
+    bool planReady = false;
+
+    std::vector<float> requestedTarget;
+    int requestedLines = 0;
+    bool targetRequested = false;
+
+    // the start of the morph is taken from the audio thread, which stops the
+    // running morph until the new plan is there
+    std::vector<float> snapshot;
+    int snapshotLines = 0;
+    bool snapshotRequested = false;
+    bool snapshotReady = false;
+    bool waitingForPlan = false;
+    int cancelCount = 0;                // a plan built before the last cancel() is dropped
+    std::atomic<bool> cancelRequested { false };
+    SpinLock stateLock;
+
+    // audio thread, cos and sin of every rotation and of its step per sub-block
+    std::vector<float> cosines, sines, stepCosines, stepSines;
+    int step = 0;
+    int samplesUntilUpdate = 0;
+    bool running = false;
+    std::atomic<bool> morphing { false };
+
+    std::vector<double> work;           // worker, Q while it is being factored
+
+    float morphTime = 0.0f;
+    int maxNrLines = 0;
+    double Fs = 44100.0;
+};
@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    MatrixValidator.cpp
+    Created: 19 Oct 2026 6:34:50pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "MatrixValidator.h"
+
+MatrixValidator::Report MatrixValidator::validate(std::vector<float>& A, int N, int mode, float tolerance) {
+    Report report;
+
+    for (int i = 0; i < N * N; ++i) {
+        if (!std::isfinite(A[i])) {
+            report.finite = false;
+            break;
+        }
+    }
+
+    // a matrix with infs or NaNs cannot be repaired, the identity is lossless at least
+    if (!report.finite) {
+        if (mode != off) {
+            std::fill(A.begin(), A.begin() + N * N, 0.0f);
+            for (int i = 0; i < N; ++i)
+                A[i * N + i] = 1.0f;
+            report.corrected = true;
+        }
+        return report;
+    }
+
+    report.orthogonalityError = getOrthogonalityError(A, N);
+    report.spectralNorm = getSpectralNorm(A, N);
+
+    if (mode == off)
+        return report;
+
+    const std::vector<float> original(A.begin(), A.begin() + N * N);
+
+    if (mode == project && report.orthogonalityError > tolerance) {
+        orthogonalise(A, N);
+        report.corrected = true;
+    } else if (report.spectralNorm > 1.0f + tolerance) {
+        const float scale = 1.0f / report.spectralNorm;
+        for (int i = 0; i < N * N; ++i)
+            A[i] *= scale;
+        report.corrected = true;
+    }
+
+    if (report.corrected) {
+        double sum = 0.0;
+        for (int i = 0; i < N * N; ++i)
+            sum += (A[i] - original[i]) * (A[i] - original[i]);
+        report.correction = (float)std::sqrt(sum);
+    }
+    return report;
+}
+
+float MatrixValidator::getOrthogonalityError(const std::vector<float>& A, int N) {
+    double sum = 0.0;
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            double dot = 0.0;
+            for (int k = 0; k < N; ++k)
+                dot += (double)A[k * N + i] * A[k * N + j];
+            const double e = dot - (i == j ? 1.0 : 0.0);
+            sum += e * e;
+        }
+    }
+    return (float)std::sqrt(sum);
+}
+
+// power iteration on A^T A, the norm of A v converges to the largest singular value
+float MatrixValidator::getSpectralNorm(const std::vector<float>& A, int N) {
+    std::vector<double> v(N, 1.0 / std::sqrt((double)N)), w(N);
+    double sigma = 0.0;
+
+    for (int iteration = 0; iteration < 50; ++iteration) {
+        for (int i = 0; i < N; ++i) {
+            double sum = 0.0;
+            for (int k = 0; k < N; ++k)
+                sum += A[i * N + k] * v[k];
+            w[i] = sum;
+        }
+        for (int k = 0; k < N; ++k) {
+            double sum = 0.0;
+            for (int i = 0; i < N; ++i)
+                sum += A[i * N + k] * w[i];
+            v[k] = sum;
+        }
+
+        double norm = 0.0;
+        for (auto x : v)
+            norm += x * x;
+        norm = std::sqrt(norm);
+        if (norm == 0.0)
+            return 0.0f;
+
+        const double newSigma = std::sqrt(norm);
+        for (auto& x : v)
+            x /= norm;
+
+        if (std::abs(newSigma - sigma) < 1.0e-7 * newSigma) {
+            sigma = newSigma;
+            break;
+        }
+        sigma = newSigma;
+    }
+    return (float)sigma;
+}
+
+void MatrixValidator::orthogonalise(std::vector<float>& A, int N) {
+    std::vector<double> X(A.begin(), A.begin() + N * N);
+
+    // Newton-Schulz converges for singular values in (0, sqrt(3)), so start at a norm of one
+    const double norm = getSpectralNorm(A, N);
+    if (norm > 0.0)
+        for (auto& x : X)
+            x /= norm;
+
+    if (!newtonSchulz(X, N)) {
+        X.assign(A.begin(), A.begin() + N * N);
+        gramSchmidt(X, N);
+    }
+
+    for (int i = 0; i < N * N; ++i)
+        A[i] = (float)X[i];
+}
+
+// X <- X (3I - X^T X) / 2
+bool MatrixValidator::newtonSchulz(std::vector<double>& X, int N) {
+    std::vector<double> XtX(N * N), next(N * N);
+
+    for (int iteration = 0; iteration < 100; ++iteration) {
+        double error = 0.0;
+        for (int i = 0; i < N; ++i) {
+            for (int j = 0; j < N; ++j) {
+                double dot = 0.0;
+                for (int k = 0; k < N; ++k)
+                    dot += X[k * N + i] * X[k * N + j];
+                XtX[i * N + j] = dot;
+                const double e = dot - (i == j ? 1.0 : 0.0);
+                error += e * e;
+            }
+        }
+        if (error < 1.0e-14)
+            return true;
+
+        for (int i = 0; i < N; ++i) {
+            for (int j = 0; j < N; ++j) {
+                double sum = 0.0;
+                for (int k = 0; k < N; ++k)
+                    sum += X[i * N + k] * ((k == j ? 3.0 : 0.0) - XtX[k * N + j]);
+                next[i * N + j] = 0.5 * sum;
+            }
+        }
+        X.swap(next);
+    }
+    return false;
+}
+
+// Modified Gram-Schmidt over the columns. A column that is (nearly) dependent
+// on the ones before it is replaced by the first unit vector that is not.
+void MatrixValidator::gramSchmidt(std::vector<double>& X, int N) {
+    for (int j = 0; j < N; ++j) {
+        for (int attempt = 0; attempt <= N; ++attempt) {
+            if (attempt > 0) {
+                for (int i = 0; i < N; ++i)
+                    X[i * N + j] = (i == attempt - 1 ? 1.0 : 0.0);
+            }
+
+            for (int k = 0; k < j; ++k) {
+                double dot = 0.0;
+                for (int i = 0; i < N; ++i)
+                    dot += X[i * N + k] * X[i * N + j];
+                for (int i = 0; i < N; ++i)
+                    X[i * N + j] -= dot * X[i * N + k];
+            }
+
+            double norm = 0.0;
+            for (int i = 0; i < N; ++i)
+                norm += X[i * N + j] * X[i * N + j];
+            norm = std::sqrt(norm);
+
+            if (norm > 1.0e-6) {
+                for (int i = 0; i < N; ++i)
+                    X[i * N + j] /= norm;
+                break;
+            }
+        }
+    }
+}
+
+String MatrixValidator::toString(const Report& report) {
+    if (!report.finite)
+        return String("not finite") + (report.corrected ? ", replaced by identity" : "");
+
+    String text = "orthogonality error " + String(report.orthogonalityError, 4)
+                + ", norm " + String(report.spectralNorm, 4);
+    if (report.corrected)
+        text += ", corrected by " + String(report.correction, 4);
+    return text;
+}
@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    MatrixValidator.h
+    Created: 19 Oct 2026 6:34:50pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Checks a feedback matrix before it is installed. A matrix with a spectral
+// norm above one makes the loop grow until it overflows, so depending on the
+// mode the matrix is either scaled back to a norm of one or replaced by the
+// nearest orthogonal matrix (the orthogonal factor of its polar decomposition).
+// Message thread only, the matrices are row-major N x N.
+class MatrixValidator {
+
+public:
+
+    enum Mode
+    {
+        off,        // install as received
+        check,      // report, only scale down if the norm is above one
+        project,    // report and replace by the nearest orthogonal matrix
+    };
+
+    struct Report {
+        float orthogonalityError = 0.0f;   // ||A^T A - I||_F
+        float spectralNorm = 0.0f;         // largest singular value
+        float correction = 0.0f;           // ||A_new - A||_F
+        bool finite = true;
+        bool corrected = false;
+    };
+
+    static Report validate(std::vector<float>& A, int N, int mode, float tolerance = 1.0e-3f);
+
+    static float getOrthogonalityError(const std::vector<float>& A, int N);
+    static float getSpectralNorm(const std::vector<float>& A, int N);
+
+    // polar factor by Newton-Schulz, Gram-Schmidt (QR) if that does not converge
+    static void orthogonalise(std::vector<float>& A, int N);
+
+    static String toString(const Report& report);
+
+private:
+
+    static bool newtonSchulz(std::vector<double>& X, int N);
+    static void gramSchmidt(std::vector<double>& X, int N);
+};
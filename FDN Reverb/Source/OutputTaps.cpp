@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    OutputTaps.cpp
+    Created: 20 Oct 2026 1:14:52am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "OutputTaps.h"
+
+OutputTaps::OutputTaps() {}
+
+OutputTaps::~OutputTaps() {}
+
+void OutputTaps::setTapsPerLine(int newTapsPerLine) {
+    const SpinLock::ScopedLockType lock(tapLock);
+    pendingTapsPerLine = jlimit(0, (int)maxTapsPerLine, newTapsPerLine);
+    tapsChanged = true;
+}
+
+void OutputTaps::setTap(int line, int tap, float position, float gain) {
+    if (line < 0 || line >= maxLines || tap < 0 || tap >= maxTapsPerLine)
+        return;
+
+    const SpinLock::ScopedLockType lock(tapLock);
+    pendingTaps[line][tap].position = jlimit(0.0f, 1.0f, position);
+    pendingTaps[line][tap].gain = gain;
+    tapsChanged = true;
+}
+
+// Every line gets its taps spread over the delay with some jitter, so the
+// echoes of different lines do not line up. The signs are random and the
+// gains are scaled so the taps together are about as loud as the line end.
+void OutputTaps::setDefaultTaps(int newTapsPerLine) {
+    Random random(4321);
+    const int n = jlimit(1, (int)maxTapsPerLine, newTapsPerLine);
+    const float gain = 0.5f / std::sqrt((float)n);
+
+    for (int i = 0; i < maxLines; ++i) {
+        for (int k = 0; k < n; ++k) {
+            const float position = (k + 0.25f + 0.5f * random.nextFloat()) / (n + 1);
+            const float sign = random.nextBool() ? 1.0f : -1.0f;
+            setTap(i, k, position, sign * gain);
+        }
+    }
+    setTapsPerLine(n);
+}
+
+void OutputTaps::applyPendingTaps() {
+    const SpinLock::ScopedTryLockType lock(tapLock);
+    if (!lock.isLocked() || !tapsChanged)
+        return;
+
+    std::copy(&pendingTaps[0][0], &pendingTaps[0][0] + maxLines * maxTapsPerLine, &taps[0][0]);
+    tapsPerLine = pendingTapsPerLine;
+    for (int i = 0; i < maxLines; ++i) {
+        for (int k = 0; k < tapsPerLine; ++k)
+            tapGains[i * tapsPerLine + k] = taps[i][k].gain;
+    }
+    tapsChanged = false;
+}
+
+float OutputTaps::process(int channel, DelayLinePool& lines, const std::vector<int>& delayLength, int nrLines) {
+    if (channel == 0)
+        applyPendingTaps();
+
+    if (tapsPerLine == 0)
+        return 0.0f;
+
+    // gather, the reads are scattered over the lines
+    int count = 0;
+    for (int i = 0; i < nrLines; ++i) {
+        const float delay = (float)delayLength[i];
+        for (int k = 0; k < tapsPerLine; ++k)
+            tapValues[count++] = lines[i].readSample(channel, jmax(1.0f, taps[i][k].position * delay));
+    }
+
+    // weight all of them in one vectorised multiply
+    FloatVectorOperations::multiply(tapValues, tapGains, count);
+
+    float out = 0.0f;
+    for (int n = 0; n < count; ++n)
+        out += tapValues[n];
+    return out;
+}
+
+void OutputTaps::copySettingsFrom(const OutputTaps& other) {
+    const SpinLock::ScopedLockType lock(tapLock);
+    std::copy(&other.pendingTaps[0][0], &other.pendingTaps[0][0] + maxLines * maxTapsPerLine, &pendingTaps[0][0]);
+    pendingTapsPerLine = other.pendingTapsPerLine;
+    tapsChanged = true;
+}
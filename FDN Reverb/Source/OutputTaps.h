@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+    OutputTaps.h
+    Created: 20 Oct 2026 1:14:52am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DelayLinePool.h"
+
+// Extra outputs along every delay line of the FDN. A tap reads its line at a
+// fraction of the line's delay, so each line puts several echoes into the
+// output per pass without adding any recursive state. The taps of all lines
+// are gathered into one buffer and weighted with a single vector multiply.
+class OutputTaps {
+
+public:
+
+    OutputTaps();
+    ~OutputTaps();
+
+    // message thread, picked up by the audio thread at the next sample of channel 0
+    void setTapsPerLine(int newTapsPerLine);
+    void setTap(int line, int tap, float position, float gain);
+    void setDefaultTaps(int newTapsPerLine);
+
+    int getTapsPerLine() const { return pendingTapsPerLine; }
+    float getTapPosition(int line, int tap) const { return pendingTaps[line][tap].position; }
+    float getTapGain(int line, int tap) const { return pendingTaps[line][tap].gain; }
+
+    // called once all lines have been pushed, returns the sum of the taps
+    float process(int channel, DelayLinePool& lines, const std::vector<int>& delayLength, int nrLines);
+
+    void copySettingsFrom(const OutputTaps& other);
+
+    enum
+    {
+        maxTapsPerLine = 4,
+        maxLines = DelayLinePool::maxLines,
+    };
+
+private:
+
+    struct Tap {
+        float position = 0.5f;  // fraction of the delay of the line
+        float gain = 0.0f;
+    };
+
+    void applyPendingTaps();
+
+    Tap taps[maxLines][maxTapsPerLine];
+    Tap pendingTaps[maxLines][maxTapsPerLine];
+    int tapsPerLine = 0;
+    int pendingTapsPerLine = 0;
+    bool tapsChanged = false;
+    SpinLock tapLock;
+
+    // line after line, the gains are laid out once when the taps change
+    float tapValues[maxLines * maxTapsPerLine] = {};
+    float tapGains[maxLines * maxTapsPerLine] = {};
+};
@@ -0,0 +1,386 @@
+/*
+  ==============================================================================
+
+    ParallelFDN.cpp
+    Created: 19 Oct 2026 9:12:40am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "ParallelFDN.h"
+
+//==============================================================================
+void ParallelFDN::SpinBarrier::init(int nrParticipants) {
+    participants = nrParticipants;
+    remaining.store(nrParticipants);
+    sense.store(false);
+    cancelled.store(false);
+}
+
+bool ParallelFDN::SpinBarrier::arriveAndWait(bool& localSense, int64 deadline) {
+    localSense = !localSense;
+
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // last one in releases everybody else
+        remaining.store(participants, std::memory_order_relaxed);
+        sense.store(localSense, std::memory_order_release);
+        return !isCancelled();
+    }
+
+    int spins = 0;
+    while (sense.load(std::memory_order_acquire) != localSense) {
+        if (isCancelled())
+            return false;
+        if (++spins > 2048) {
+            if (deadline != 0 && Time::getHighResolutionTicks() > deadline) {
+                cancel();
+                return false;
+            }
+            juce::Thread::yield();
+            spins = 0;
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+ParallelFDN::Worker::Worker(ParallelFDN& o, int p)
+    : juce::Thread("FDN Worker " + String(p)), owner(o), partition(p) {}
+
+void ParallelFDN::Worker::run() {
+    while (!threadShouldExit()) {
+        if (!startEvent.wait(100))
+            continue;
+        if (threadShouldExit())
+            return;
+        owner.renderPartition(partition, localSense, 0);
+        owner.busyWorkers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+//==============================================================================
+ParallelFDN::ParallelFDN() {}
+
+ParallelFDN::~ParallelFDN() {
+    stopWorkers();
+    delete [] lowShelf;
+    delete [] highShelf;
+}
+
+void ParallelFDN::stopWorkers() {
+    // nobody is left waiting at the barrier for a partition that has stopped
+    barrier.cancel();
+    for (auto* worker : workers) {
+        worker->signalThreadShouldExit();
+        worker->startEvent.signal();
+    }
+    for (auto* worker : workers) {
+        worker->stopThread(1000);
+    }
+    workers.clear();
+}
+
+void ParallelFDN::init(float sampleRate, int nrDel, float loDel, float highDel, int nrThr) {
+    stopWorkers();
+
+    Fs = sampleRate;
+    nrDelayLines = jlimit(1, (int)maxDelayLines, nrDel);
+    nrThreads = jlimit(1, jmin((int)maxThreads, nrDelayLines), nrThr);
+
+    findDelays((int)(loDel * Fs/1000.0), (int)(highDel * Fs/1000.0));
+
+    // a line of length d only needs d samples of storage: every position is read
+    // in phase 1 before it is overwritten in phase 2 of the same sub-block
+    lineOffset.resize(nrDelayLines);
+    lineSize.resize(nrDelayLines);
+    int total = 0;
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lineOffset[i] = total;
+        lineSize[i] = delayLength[i];
+        total += delayLength[i];
+    }
+    delayBuffer.assign(total, 0.0f);
+    writePos.assign(nrDelayLines, 0);
+
+    subBlockSize = jmin((int)maxSubBlockSize, *std::min_element(delayLength.begin(), delayLength.end()));
+
+    partitionStart.resize(nrThreads + 1);
+    for (int p = 0; p <= nrThreads; ++p) {
+        partitionStart[p] = (p * nrDelayLines) / nrThreads;
+    }
+
+    delete [] lowShelf;
+    delete [] highShelf;
+    lowShelf = new Filter[nrDelayLines];
+    highShelf = new Filter[nrDelayLines];
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lowShelf[i].reset(Fs);
+        highShelf[i].reset(Fs);
+    }
+
+    // random gains, scaled so the loudness does not grow with the order
+    Random random;
+    const float norm = 1.0f / std::sqrt((float)nrDelayLines);
+    bGains.resize(nrDelayLines);
+    cGainsLeft.resize(nrDelayLines);
+    cGainsRight.resize(nrDelayLines);
+    for (int i = 0; i < nrDelayLines; ++i) {
+        bGains[i] = (random.nextFloat() * 2.0f - 1.0f) * norm;
+        cGainsLeft[i] = (random.nextFloat() * 2.0f - 1.0f) * norm;
+        cGainsRight[i] = (random.nextFloat() * 2.0f - 1.0f) * norm;
+    }
+
+    // default matrix: normalised Hadamard for powers of two, Householder otherwise
+    matrix.assign(nrDelayLines * nrDelayLines, 0.0f);
+    if (isPowerOfTwo(nrDelayLines)) {
+        const float h = 1.0f / std::sqrt((float)nrDelayLines);
+        for (int i = 0; i < nrDelayLines; ++i)
+            for (int j = 0; j < nrDelayLines; ++j)
+                matrix[i * nrDelayLines + j] = (countNumberOfBits((uint32)(i & j)) & 1) ? -h : h;
+    } else {
+        const float h = 2.0f / nrDelayLines;
+        for (int i = 0; i < nrDelayLines; ++i)
+            for (int j = 0; j < nrDelayLines; ++j)
+                matrix[i * nrDelayLines + j] = (i == j ? 1.0f : 0.0f) - h;
+    }
+    updateZeroBlocks();
+
+    for (int k = 0; k < 2; ++k) {
+        lineOutput[k].assign(nrDelayLines * maxSubBlockSize, 0.0f);
+        partialLeft[k].assign(nrThreads * maxSubBlockSize, 0.0f);
+        partialRight[k].assign(nrThreads * maxSubBlockSize, 0.0f);
+    }
+    feedback.assign(nrThreads * maxSubBlockSize, 0.0f);
+    jobInput.assign(maxJobSize, 0.0f);
+
+    barrier.init(nrThreads);
+    callerSense = false;
+    busyWorkers.store(0);
+    missedBlocks.store(0);
+
+    for (int p = 1; p < nrThreads; ++p) {
+        auto* worker = workers.add(new Worker(*this, p));
+        worker->startThread(9);
+    }
+}
+
+void ParallelFDN::reset() {
+    std::fill(delayBuffer.begin(), delayBuffer.end(), 0.0f);
+    std::fill(writePos.begin(), writePos.end(), 0);
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lowShelf[i].clear();
+        highShelf[i].clear();
+    }
+}
+
+void ParallelFDN::findDelays(int LR, int UR) {
+    // collect the primes in the range, widening it until there are enough of them,
+    // then spread the lines evenly over the primes that were found
+    std::vector<int> primes;
+    int i = jmax(2, LR);
+    while ((int)primes.size() < nrDelayLines || i <= UR) {
+        bool prime = true;
+        for (int k = 2; k * k <= i; ++k) {
+            if (i % k == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime)
+            primes.push_back(i);
+        ++i;
+    }
+
+    delayLength.resize(nrDelayLines);
+    const double step = (double)primes.size() / nrDelayLines;
+    for (int n = 0; n < nrDelayLines; ++n) {
+        delayLength[n] = primes[(size_t)(n * step)];
+    }
+}
+
+void ParallelFDN::updateZeroBlocks() {
+    zeroBlock.assign(nrThreads * nrThreads, 1);
+    for (int p = 0; p < nrThreads; ++p) {
+        for (int q = 0; q < nrThreads; ++q) {
+            for (int i = partitionStart[p]; i < partitionStart[p + 1] && zeroBlock[p * nrThreads + q]; ++i) {
+                for (int j = partitionStart[q]; j < partitionStart[q + 1]; ++j) {
+                    if (matrix[i * nrDelayLines + j] != 0.0f) {
+                        zeroBlock[p * nrThreads + q] = 0;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ParallelFDN::setMatrix(const std::vector<float>& newMatrixCoef) {
+    if ((int)newMatrixCoef.size() < nrDelayLines * nrDelayLines)
+        return;
+    std::copy(newMatrixCoef.begin(), newMatrixCoef.begin() + nrDelayLines * nrDelayLines, matrix.begin());
+    updateZeroBlocks();
+}
+
+void ParallelFDN::setBGains(const std::vector<float>& gains) {
+    for (int i = 0; i < jmin(nrDelayLines, (int)gains.size()); ++i) {
+        bGains[i] = gains[i];
+    }
+}
+
+void ParallelFDN::setCGains(const std::vector<float>& leftGains, const std::vector<float>& rightGains) {
+    for (int i = 0; i < jmin(nrDelayLines, (int)leftGains.size(), (int)rightGains.size()); ++i) {
+        cGainsLeft[i] = leftGains[i];
+        cGainsRight[i] = rightGains[i];
+    }
+}
+
+void ParallelFDN::setSingleBGain(int index, float gain) {
+    if (index >= 0 && index < nrDelayLines)
+        bGains[index] = gain;
+}
+
+void ParallelFDN::setSingleCGain(int index, float gain) {
+    if (index >= 0 && index < nrDelayLines) {
+        cGainsLeft[index] = gain;
+        cGainsRight[index] = gain;
+    }
+}
+
+void ParallelFDN::updateFilter(float g_DC, float g_PI, float l_fT, float h_fT) {
+    for (int i = 0; i < nrDelayLines; ++i) {
+        lowShelf[i].updateLowShelf(g_DC, l_fT, delayLength[i], Fs);
+        highShelf[i].updateHighShelf(g_PI, h_fT, delayLength[i], Fs);
+    }
+}
+
+bool ParallelFDN::processBlock(const float* input, float* outLeft, float* outRight, int numSamples) {
+    if (nrDelayLines == 0 || numSamples <= 0)
+        return true;
+
+    // a block that was given up on is only cleaned up once every worker has left it
+    if (barrier.isCancelled()) {
+        if (busyWorkers.load(std::memory_order_acquire) > 0) {
+            FloatVectorOperations::clear(outLeft, numSamples);
+            FloatVectorOperations::clear(outRight, numSamples);
+            return false;
+        }
+        recoverFromCancel();
+    }
+
+    for (int start = 0; start < numSamples; start += maxJobSize) {
+        const int length = jmin((int)maxJobSize, numSamples - start);
+        if (!renderJob(input + start, outLeft + start, outRight + start, length)) {
+            FloatVectorOperations::clear(outLeft, numSamples);
+            FloatVectorOperations::clear(outRight, numSamples);
+            missedBlocks++;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParallelFDN::renderJob(const float* input, float* outLeft, float* outRight, int numSamples) {
+    FloatVectorOperations::copy(jobInput.data(), input, numSamples);
+    jobLeft = outLeft;
+    jobRight = outRight;
+    jobNumSamples = numSamples;
+    // counted up, not stored: a worker may still be on its way out of the last block
+    busyWorkers.fetch_add(nrThreads - 1, std::memory_order_acq_rel);
+
+    for (auto* worker : workers) {
+        worker->startEvent.signal();
+    }
+
+    // the calling thread renders partition 0 and collects the output. Very short
+    // blocks still get a millisecond, waking the workers up alone can take longer
+    const double timeout = jmax(0.001, 0.5 * numSamples / Fs);
+    const int64 deadline = Time::getHighResolutionTicks() + Time::secondsToHighResolutionTicks(timeout);
+    return renderPartition(0, callerSense, deadline);
+}
+
+// Audio thread, with every worker waiting for the next block again. The lines
+// were left half written and the barrier somewhere in the middle of a block.
+void ParallelFDN::recoverFromCancel() {
+    reset();
+    barrier.init(nrThreads);
+    callerSense = false;
+    for (auto* worker : workers) {
+        worker->localSense = false;
+    }
+}
+
+bool ParallelFDN::renderPartition(int p, bool& localSense, int64 deadline) {
+    const int first = partitionStart[p];
+    const int last = partitionStart[p + 1];
+    int k = 0;
+
+    // woken up late for a block that has already been given up on
+    if (barrier.isCancelled())
+        return false;
+
+    for (int start = 0; start < jobNumSamples; start += subBlockSize) {
+        const int L = jmin(subBlockSize, jobNumSamples - start);
+        float* outputs = lineOutput[k].data();
+        float* left = partialLeft[k].data() + p * maxSubBlockSize;
+        float* right = partialRight[k].data() + p * maxSubBlockSize;
+
+        // === phase 1: read and filter the own lines ===
+        FloatVectorOperations::clear(left, L);
+        FloatVectorOperations::clear(right, L);
+        for (int i = first; i < last; ++i) {
+            float* y = outputs + i * maxSubBlockSize;
+            const float* line = delayBuffer.data() + lineOffset[i];
+            int pos = writePos[i];
+            for (int n = 0; n < L; ++n) {
+                y[n] = highShelf[i].processSample(lowShelf[i].processSample(line[pos]));
+                if (++pos == lineSize[i])
+                    pos = 0;
+            }
+            FloatVectorOperations::addWithMultiply(left, y, cGainsLeft[i], L);
+            FloatVectorOperations::addWithMultiply(right, y, cGainsRight[i], L);
+        }
+
+        if (!barrier.arriveAndWait(localSense, deadline))
+            return false;
+
+        if (p == 0) {
+            FloatVectorOperations::copy(jobLeft + start, partialLeft[k].data(), L);
+            FloatVectorOperations::copy(jobRight + start, partialRight[k].data(), L);
+            for (int q = 1; q < nrThreads; ++q) {
+                FloatVectorOperations::add(jobLeft + start, partialLeft[k].data() + q * maxSubBlockSize, L);
+                FloatVectorOperations::add(jobRight + start, partialRight[k].data() + q * maxSubBlockSize, L);
+            }
+        }
+
+        // === phase 2: feedback for the own rows, batched over the sub-block ===
+        float* fb = feedback.data() + p * maxSubBlockSize;
+        for (int i = first; i < last; ++i) {
+            FloatVectorOperations::multiply(fb, jobInput.data() + start, bGains[i], L);
+            const float* row = matrix.data() + i * nrDelayLines;
+
+            for (int q = 0; q < nrThreads; ++q) {
+                if (zeroBlock[p * nrThreads + q])
+                    continue;
+                for (int j = partitionStart[q]; j < partitionStart[q + 1]; ++j) {
+                    if (row[j] != 0.0f)
+                        FloatVectorOperations::addWithMultiply(fb, outputs + j * maxSubBlockSize, row[j], L);
+                }
+            }
+
+            float* line = delayBuffer.data() + lineOffset[i];
+            int pos = writePos[i];
+            for (int n = 0; n < L; ++n) {
+                line[pos] = fb[n];
+                if (++pos == lineSize[i])
+                    pos = 0;
+            }
+            writePos[i] = pos;
+        }
+
+        k ^= 1;
+    }
+
+    // nobody leaves before every partition has finished the block
+    return barrier.arriveAndWait(localSense, deadline);
+}
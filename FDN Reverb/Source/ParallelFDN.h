@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+    ParallelFDN.h
+    Created: 19 Oct 2026 9:12:40am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include "Filter.h"
+
+// Large-order FDN (128 - 512 lines) rendered across a pool of worker threads.
+// The delay lines are split into contiguous partitions, one per thread. Every
+// block is cut into sub-blocks no longer than the shortest delay line, so all
+// line outputs of a sub-block are known before any of its inputs are written.
+// Each sub-block is then processed in two phases:
+//   1. every thread reads and filters the outputs of its own lines,
+//   2. every thread computes the feedback for its own rows of the matrix
+//      (batched over the whole sub-block) and writes its own lines.
+// The only synchronisation is one spinning barrier between the two phases.
+// The calling thread only waits there until half the block's duration (at least
+// a millisecond) has passed. A block that takes longer, because a worker was descheduled, is given
+// up on: its output is silence and the network is cleared once every worker
+// has left it.
+class ParallelFDN {
+
+public:
+
+    ParallelFDN();
+    ~ParallelFDN();
+
+    void init(float sampleRate, int nrDel, float loDel, float highDel, int nrThreads);
+
+    void reset();
+
+    void setMatrix(const std::vector<float>& newMatrixCoef);
+
+    void setBGains(const std::vector<float>& gains);
+
+    void setCGains(const std::vector<float>& leftGains, const std::vector<float>& rightGains);
+
+    // the C gain goes to both channels, as in the FDN
+    void setSingleBGain(int index, float gain);
+    void setSingleCGain(int index, float gain);
+
+    void updateFilter(float gDC, float gPI, float l_fT, float h_fT);
+
+    // false, with silence in the outputs, if the block was given up on
+    bool processBlock(const float* input, float* outLeft, float* outRight, int numSamples);
+
+    // blocks given up on since init()
+    int getMissedBlocks() const { return missedBlocks.load(); }
+
+    int getNrDelayLines() const { return nrDelayLines; }
+    int getNrThreads() const { return nrThreads; }
+    int getSubBlockSize() const { return subBlockSize; }
+
+    enum
+    {
+        maxDelayLines = 512,
+        maxThreads = 16,
+        maxSubBlockSize = 256,
+        maxJobSize = 2048,      // longer blocks are rendered as several jobs
+    };
+
+private:
+
+    // sense reversing barrier, lock-free for the threads that are spinning
+    class SpinBarrier {
+    public:
+        void init(int nrParticipants);
+        // false if the barrier was cancelled, or the deadline (high resolution
+        // ticks, 0 for none) passed first, which cancels it for everybody
+        bool arriveAndWait(bool& localSense, int64 deadline = 0);
+        void cancel() { cancelled.store(true, std::memory_order_release); }
+        bool isCancelled() const { return cancelled.load(std::memory_order_acquire); }
+    private:
+        int participants = 1;
+        std::atomic<int> remaining { 1 };
+        std::atomic<bool> sense { false };
+        std::atomic<bool> cancelled { false };
+    };
+
+    class Worker : public juce::Thread {
+    public:
+        Worker(ParallelFDN& owner, int partition);
+        void run() override;
+        juce::WaitableEvent startEvent;
+        bool localSense = false;
+    private:
+        ParallelFDN& owner;
+        int partition;
+    };
+
+    void stopWorkers();
+    bool renderJob(const float* input, float* outLeft, float* outRight, int numSamples);
+    bool renderPartition(int partition, bool& localSense, int64 deadline);
+    void recoverFromCancel();
+    void findDelays(int LR, int UR);
+    void updateZeroBlocks();
+
+    int nrDelayLines = 0;
+    int nrThreads = 0;
+    int subBlockSize = 1;
+    float Fs = 44100.f;
+
+    std::vector<int> partitionStart;   // nrThreads + 1 entries
+    std::vector<int> delayLength;
+    std::vector<int> lineOffset;       // start of each ring buffer in delayBuffer
+    std::vector<int> lineSize;
+    std::vector<int> writePos;
+    std::vector<float> delayBuffer;
+
+    std::vector<float> matrix;         // row-major, nrDelayLines x nrDelayLines
+    std::vector<char> zeroBlock;       // nrThreads x nrThreads, 1 if the block of the matrix is all zero
+
+    std::vector<float> bGains;
+    std::vector<float> cGainsLeft;
+    std::vector<float> cGainsRight;
+
+    Filter* lowShelf = nullptr;
+    Filter* highShelf = nullptr;
+
+    // double buffered so phase 1 of the next sub-block never overwrites what phase 2 is reading
+    std::vector<float> lineOutput[2];      // nrDelayLines x maxSubBlockSize
+    std::vector<float> partialLeft[2];     // nrThreads x maxSubBlockSize
+    std::vector<float> partialRight[2];
+    std::vector<float> feedback;           // nrThreads x maxSubBlockSize scratch
+
+    // current job, written by the audio thread before the workers are woken up.
+    // The input is copied, a worker that is late for a block that was given up on
+    // may still read it after processBlock() has returned
+    std::vector<float> jobInput;           // maxJobSize
+    float* jobLeft = nullptr;
+    float* jobRight = nullptr;
+    int jobNumSamples = 0;
+
+    juce::OwnedArray<Worker> workers;
+    SpinBarrier barrier;
+    bool callerSense = false;
+    std::atomic<int> busyWorkers { 0 };     // workers still inside the current block
+    std::atomic<int> missedBlocks { 0 };
+};
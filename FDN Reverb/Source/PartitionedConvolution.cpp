@@ -0,0 +1,189 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolution.cpp
+    Created: 19 Oct 2026 11:03:18am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "PartitionedConvolution.h"
+
+PartitionedConvolution::ImpulseResponse::ImpulseResponse(const float* const* irs, int nrChannels, int irLength,
+                                                         int B, bool zeroLat)
+    : numChannels(nrChannels), blockSize(B), numBins(B + 1), length(irLength), zeroLatency(zeroLat)
+{
+    const int fftSize = 2 * blockSize;
+    const int numPaths = numChannels * numChannels;
+    dsp::FFT transform((int)std::log2(fftSize));
+
+    const int offset = zeroLatency ? blockSize : 0;
+    numPartitions = jmax(1, (irLength - offset + blockSize - 1) / blockSize);
+    partitions.assign(numPaths * numPartitions * numBins * 2, 0.0f);
+    if (zeroLatency)
+        head.assign(numPaths * blockSize, 0.0f);
+
+    std::vector<float> buffer(2 * fftSize);
+    for (int path = 0; path < numPaths; ++path) {
+        const float* ir = irs[path];
+        if (zeroLatency)
+            std::copy(ir, ir + jmin(blockSize, irLength), head.begin() + path * blockSize);
+
+        for (int p = 0; p < numPartitions; ++p) {
+            std::fill(buffer.begin(), buffer.end(), 0.0f);
+            const int start = offset + p * blockSize;
+            const int count = jlimit(0, blockSize, irLength - start);
+            if (count > 0)
+                std::copy(ir + start, ir + start + count, buffer.begin());
+
+            transform.performRealOnlyForwardTransform(buffer.data());
+            std::copy(buffer.begin(), buffer.begin() + numBins * 2,
+                      partitions.begin() + (path * numPartitions + p) * numBins * 2);
+        }
+    }
+}
+
+//==============================================================================
+PartitionedConvolution::PartitionedConvolution() {}
+
+PartitionedConvolution::~PartitionedConvolution() {}
+
+void PartitionedConvolution::prepare(int numChannels, int maxImpulseLength) {
+    fft.reset(new dsp::FFT(fftOrder));
+    maxPartitions = maxImpulseLength / blockSize + 1;
+
+    const int numBins = blockSize + 1;
+    fftBuffer.assign(4 * blockSize, 0.0f);
+    accumulator.assign(numBins * 2, 0.0f);
+
+    channels.resize(numChannels);
+    for (auto& state : channels) {
+        state.current.assign(blockSize, 0.0f);
+        state.previous.assign(blockSize, 0.0f);
+        state.output.assign(blockSize, 0.0f);
+        state.history.assign(2 * blockSize, 0.0f);
+        state.spectra.assign(maxPartitions * numBins * 2, 0.0f);
+    }
+    reset();
+}
+
+void PartitionedConvolution::reset() {
+    for (auto& state : channels) {
+        std::fill(state.current.begin(), state.current.end(), 0.0f);
+        std::fill(state.previous.begin(), state.previous.end(), 0.0f);
+        std::fill(state.output.begin(), state.output.end(), 0.0f);
+        std::fill(state.history.begin(), state.history.end(), 0.0f);
+        std::fill(state.spectra.begin(), state.spectra.end(), 0.0f);
+    }
+    pos = 0;
+    historyPos = 0;
+    spectrumPos = 0;
+}
+
+void PartitionedConvolution::setImpulseResponse(const ImpulseResponse* newResponse) {
+    // the input spectra do not depend on the response, so nothing needs clearing here
+    if (newResponse != nullptr && (newResponse->blockSize != blockSize || newResponse->numPartitions > maxPartitions
+                                   || newResponse->numChannels != (int)channels.size()))
+        return;
+    response = newResponse;
+}
+
+void PartitionedConvolution::process(const float* const* input, float* const* output, int numSamples) {
+    const int numChannels = (int)channels.size();
+
+    if (response == nullptr) {
+        for (int ch = 0; ch < numChannels; ++ch)
+            FloatVectorOperations::clear(output[ch], numSamples);
+        return;
+    }
+
+    const bool direct = response->zeroLatency;
+
+    for (int n = 0; n < numSamples; ++n) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            auto& state = channels[ch];
+            state.current[pos] = input[ch][n];
+            output[ch][n] = state.output[pos];
+
+            if (direct) {
+                float* window = state.history.data() + historyPos;
+                window[0] = input[ch][n];
+                window[blockSize] = input[ch][n];
+            }
+        }
+
+        if (direct) {
+            for (int in = 0; in < numChannels; ++in) {
+                const float* window = channels[in].history.data() + historyPos;
+                for (int out = 0; out < numChannels; ++out) {
+                    const float* head = response->head.data() + (in * numChannels + out) * blockSize;
+                    float y = 0.0f;
+                    for (int m = 0; m < blockSize; ++m) {
+                        y += head[m] * window[m];
+                    }
+                    output[out][n] += y;
+                }
+            }
+            historyPos = (historyPos == 0 ? blockSize - 1 : historyPos - 1);
+        }
+
+        if (++pos == blockSize) {
+            processFFTStep();
+            pos = 0;
+        }
+    }
+}
+
+void PartitionedConvolution::processFFTStep() {
+    const int numBins = blockSize + 1;
+    const int fftSize = 2 * blockSize;
+    const int numChannels = (int)channels.size();
+
+    // transform [previous, current] of every input and push it into its frequency domain delay line
+    for (auto& state : channels) {
+        std::copy(state.previous.begin(), state.previous.end(), fftBuffer.begin());
+        std::copy(state.current.begin(), state.current.end(), fftBuffer.begin() + blockSize);
+        std::fill(fftBuffer.begin() + fftSize, fftBuffer.end(), 0.0f);
+        fft->performRealOnlyForwardTransform(fftBuffer.data());
+
+        float* newest = state.spectra.data() + spectrumPos * numBins * 2;
+        std::copy(fftBuffer.begin(), fftBuffer.begin() + numBins * 2, newest);
+        std::swap(state.previous, state.current);
+    }
+
+    for (int out = 0; out < numChannels; ++out) {
+        // complex multiply-accumulate over all inputs and partitions
+        std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+        for (int in = 0; in < numChannels; ++in) {
+            const float* path = response->partitions.data() + (in * numChannels + out) * response->numPartitions * numBins * 2;
+
+            for (int p = 0; p < response->numPartitions; ++p) {
+                int slot = spectrumPos - p;
+                if (slot < 0)
+                    slot += maxPartitions;
+
+                const float* x = channels[in].spectra.data() + slot * numBins * 2;
+                const float* h = path + p * numBins * 2;
+                float* acc = accumulator.data();
+                for (int k = 0; k < numBins; ++k) {
+                    const float xr = x[2 * k], xi = x[2 * k + 1];
+                    const float hr = h[2 * k], hi = h[2 * k + 1];
+                    acc[2 * k] += xr * hr - xi * hi;
+                    acc[2 * k + 1] += xr * hi + xi * hr;
+                }
+            }
+        }
+
+        // back to the time domain, the second half is the valid part
+        std::copy(accumulator.begin(), accumulator.end(), fftBuffer.begin());
+        for (int k = 1; k < blockSize; ++k) {
+            fftBuffer[2 * (fftSize - k)] = accumulator[2 * k];
+            fftBuffer[2 * (fftSize - k) + 1] = -accumulator[2 * k + 1];
+        }
+        fft->performRealOnlyInverseTransform(fftBuffer.data());
+        std::copy(fftBuffer.begin() + blockSize, fftBuffer.begin() + fftSize, channels[out].output.begin());
+    }
+
+    spectrumPos = (spectrumPos + 1) % maxPartitions;
+}
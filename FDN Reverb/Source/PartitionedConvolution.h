@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolution.h
+    Created: 19 Oct 2026 11:03:18am
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Uniformly partitioned overlap-save convolution (FFT size = 2 x block size).
+// With zeroLatency the first block of the impulse response is applied as a
+// direct FIR and only the rest goes through the FFT partitions, which gives a
+// two-level non-uniform partitioning without any added latency. Without it the
+// whole response is partitioned and the output is one block late.
+//
+// Every input channel is convolved with a response to every output channel
+// (MIMO), so each input spectrum is transformed once and shared by all outputs.
+class PartitionedConvolution {
+
+public:
+
+    // Partition spectra of the impulse responses from every input to every
+    // output, irs[input * numChannels + output]. Built off the audio thread and
+    // read-only afterwards, so several instances can share one.
+    struct ImpulseResponse {
+        ImpulseResponse(const float* const* irs, int numChannels, int irLength, int blockSize, bool zeroLatency);
+
+        int numChannels;
+        int blockSize;
+        int numBins;
+        int numPartitions;
+        int length;
+        bool zeroLatency;
+        std::vector<float> head;        // paths x blockSize, only used with zeroLatency
+        std::vector<float> partitions;  // paths x numPartitions x numBins complex values
+    };
+
+    PartitionedConvolution();
+    ~PartitionedConvolution();
+
+    void prepare(int numChannels, int maxImpulseLength);
+
+    void reset();
+
+    // audio thread, the response has to outlive its use by process()
+    void setImpulseResponse(const ImpulseResponse* newResponse);
+
+    // all channels at once, as every output depends on every input
+    void process(const float* const* input, float* const* output, int numSamples);
+
+    int getMaxPartitions() const { return maxPartitions; }
+
+    enum
+    {
+        blockSize = 256,
+        fftOrder = 9,   // 2 x blockSize
+    };
+
+private:
+
+    struct ChannelState {
+        std::vector<float> current;     // block being filled
+        std::vector<float> previous;    // last complete block
+        std::vector<float> output;      // result of the last FFT step, for this channel as an output
+        std::vector<float> history;     // doubled history for the direct head
+        std::vector<float> spectra;     // frequency domain delay line, maxPartitions x numBins complex
+    };
+
+    void processFFTStep();
+
+    std::unique_ptr<dsp::FFT> fft;
+    std::vector<ChannelState> channels;
+    std::vector<float> fftBuffer;
+    std::vector<float> accumulator;
+    const ImpulseResponse* response = nullptr;
+    int maxPartitions = 0;
+
+    // shared by all channels, which are always processed together
+    int pos = 0;
+    int historyPos = 0;
+    int spectrumPos = 0;
+};
@@ -85,13 +85,30 @@ FDNReverbAudioProcessorEditor::FDNReverbAudioProcessorEditor (FDNReverbAudioProc
     fdnOrderComboBox.addListener(this);
     setLabel(fdnOrderLabel, "FDN Order", mediumFont, centreJust);
     fdnOrderLabel.attachToComponent(&fdnOrderComboBox, true);
+    
+    // === COUPLED ROOMS ===
+    addAndMakeVisible(roomsComboBox);
+    for (int i = 1; i <= CoupledRooms::maxRooms; ++i)
+        roomsComboBox.addItem(std::to_string(i), i);
+    roomsComboBox.setSelectedId(1);
+    roomsComboBox.onChange = [this] {nrOfRoomsChanged(); };
+    nrOfRoomsAttach.reset(new ComboBoxAttachment(valueTreeState, "NROFROOMS", roomsComboBox));
+    setLabel(roomsLabel, "Rooms", mediumFont, centreJust);
+    roomsLabel.attachToComponent(&roomsComboBox, true);
 
     // ==== MATRIX SELECTION ====
     addAndMakeVisible(matrixComboBox);
     matrixComboBox.addItem("Identity", 1);
     matrixComboBox.addItem("Custom", 2);
+    matrixComboBox.addItem("Scattering", 3);
+    matrixComboBox.addItem("Random", MatrixFactory::randomOrthogonal);
+    matrixComboBox.addItem("Hadamard", MatrixFactory::hadamard);
+    matrixComboBox.addItem("Householder", MatrixFactory::householder);
+    matrixComboBox.addItem("Circulant", MatrixFactory::circulant);
+    matrixComboBox.addItem("Block Diagonal", MatrixFactory::blockDiagonal);
+    matrixComboBox.addItem("Nested", MatrixFactory::nested);
+    matrixComboBox.addItem("Filter Matrix", MatrixFactory::filterMatrix);
     matrixComboBox.setSelectedId(2);
-    matrixComboBox.onChange = [this] {matrixBoxChanged(); };
     matrixAttach.reset(new ComboBoxAttachment(valueTreeState, "MATRIXSELECTION", matrixComboBox));
     
     setLabel(matrixLabel, "Matrix Selection", mediumFont, centreJust);
@@ -121,6 +138,11 @@ FDNReverbAudioProcessorEditor::FDNReverbAudioProcessorEditor (FDNReverbAudioProc
     // === DELAY VALUES LABEL ===
     setLabel(delaysTitle, "Delay Lengths: ", smallFont, leftJust);
     
+    // === DECAY ANALYSIS LABEL ===
+    setLabel(decayTitle, "T60 Measured/Target: ", smallFont, leftJust);
+    
+    setLabel(decayValues, "Off", valueTextFont, leftJust);
+    
     setLabel(delaysValues, "", valueTextFont, leftJust);
   
     // === DELAY TOGGLE BUTTON ===
@@ -137,8 +159,11 @@ FDNReverbAudioProcessorEditor::FDNReverbAudioProcessorEditor (FDNReverbAudioProc
     setLabel(matrixWindowLabel, "Show Matrix Values", smallFont, leftJust);
     matrixWindowLabel.attachToComponent(&matrixWindowButton, true);
     
-    setLabel(matrixValueLabel, "", smallFont, centreJust);
-    matrixValueLabel.setVisible(false);
+    // the matrix and the gains and delays of every line, shown instead of the sliders
+    for (Component* view : std::initializer_list<Component*> { &matrixHeatmap, &bGainsBars, &cGainsBars, &delaysBars }) {
+        addAndMakeVisible(view);
+        view->setVisible(false);
+    }
 
     // === WHITE BOX AROUND INFO AREA ===
     addAndMakeVisible(infoLabel);
@@ -147,6 +172,7 @@ FDNReverbAudioProcessorEditor::FDNReverbAudioProcessorEditor (FDNReverbAudioProc
     addAndMakeVisible(portEditor);
     portEditor.setText(std::to_string(audioProcessor.getPortNumber()));
     portEditor.setJustification(Justification::centred);
+    portEditor.onReturnKey = [this]{updatePortNumber();};
     
     setLabel(portEditorLabel, "UDP Port", mediumFont, leftJust);
     portEditorLabel.attachToComponent(&portEditor, true);
@@ -182,6 +208,8 @@ FDNReverbAudioProcessorEditor::FDNReverbAudioProcessorEditor (FDNReverbAudioProc
     }
     
     showInfoButtonClicked(); // make sure info is hidden on startup, can be changed if needed
+    
+    startTimerHz(8);
 }
 
 FDNReverbAudioProcessorEditor::~FDNReverbAudioProcessorEditor()
@@ -197,8 +225,6 @@ void FDNReverbAudioProcessorEditor::paint (juce::Graphics& g)
     g.setFont(Font("Roboto", 20.0f, Font::bold));
     g.setColour(Colours::ghostwhite);
     g.setFont(Font("Helvetica", 10.0f, Font::plain));
-
-    startTimerHz(8);
 }
 
 void FDNReverbAudioProcessorEditor::resized()
@@ -248,6 +274,7 @@ void FDNReverbAudioProcessorEditor::resized()
     dryWetSlider.setBounds(sliderLeft, modulationButton.getY() + sliderHeight, getWidth() - sliderLeft, sliderHeight);
     // === ComboBox BBunds ===
     fdnOrderComboBox.setBounds(getWidth()/2, dryWetSlider.getY() + sliderHeight, 70, 20);
+    roomsComboBox.setBounds(sliderLeft + 40, dryWetSlider.getY() + sliderHeight, 50, 20);
     matrixComboBox.setBounds(sliderRight - 50, dryWetSlider.getY() + sliderHeight, 80, 20);
     
     // === Button Bounds ===
@@ -256,7 +283,15 @@ void FDNReverbAudioProcessorEditor::resized()
     showInfoButton.setBounds(getWidth()/2, infoButtonHeight, buttonSize, buttonSize);
     
     // === Matrix Values Bounds ===
-    matrixValueLabel.setBounds(0, sliderHeight, getWidth(), matrixWindowButton.getY() - sliderHeight);
+    // heatmap on the left as large as it fits, the three bar views stacked next to it
+    const int matrixAreaHeight = matrixWindowButton.getY() - sliderHeight;
+    const int heatmapSide = jmin(matrixAreaHeight, (int)(getWidth() * 0.6));
+    matrixHeatmap.setBounds(5, sliderHeight, heatmapSide, heatmapSide);
+    const int barsX = 5 + heatmapSide + 10;
+    const int barsHeight = matrixAreaHeight / 3;
+    bGainsBars.setBounds(barsX, sliderHeight, getWidth() - barsX - 5, barsHeight - 4);
+    cGainsBars.setBounds(barsX, sliderHeight + barsHeight, getWidth() - barsX - 5, barsHeight - 4);
+    delaysBars.setBounds(barsX, sliderHeight + 2 * barsHeight, getWidth() - barsX - 5, barsHeight - 4);
 
     
     // === OSC Values ===
@@ -271,11 +306,14 @@ void FDNReverbAudioProcessorEditor::resized()
     
     delaysTitle.setBounds(infoArea.removeFromBottom(infoHeight));
     delaysValues.setBounds(70, delaysTitle.getY(), getWidth() - 60, infoHeight);
+    
+    decayTitle.setBounds(infoArea.removeFromBottom(infoHeight));
+    decayValues.setBounds(100, decayTitle.getY(), getWidth() - 100, infoHeight);
 
     
     // === Draw Lines around info section ===
     if(showInfoButton.getToggleState() == 1)
-        drawPaths(getHeight() * 0.8);
+        drawPaths(getHeight() * 0.75);
     else
         drawPaths(getHeight() * 0.95);
 }
@@ -290,6 +328,7 @@ void FDNReverbAudioProcessorEditor::timerCallback() {
     modDepthSlider.setValue(*valueTreeState.getRawParameterValue("MODDEPTH"));
     dryWetSlider.setValue(*valueTreeState.getRawParameterValue("DRYWET"));
     matrixComboBox.setSelectedId(*valueTreeState.getRawParameterValue("MATRIXSELECTION"));
+    roomsComboBox.setSelectedId(*valueTreeState.getRawParameterValue("NROFROOMS"));
 
     if (audioProcessor.modulateFDNBool) {
         modulationButton.setToggleState(true, false);
@@ -301,75 +340,71 @@ void FDNReverbAudioProcessorEditor::timerCallback() {
     
     nrDelayLinesLabel.setText("Nr. Delay Lines: " + std::to_string(audioProcessor.getNrDelayLines()), dontSendNotification);
     
-    // == Values of B and C Gains and Delay line lenghts in sample
-    bGainsValues.setText(audioProcessor.getBGains(), dontSendNotification);
-    cGainsValues.setText(audioProcessor.getCGains(), dontSendNotification);
-    delaysValues.setText(audioProcessor.getDelayValues(), dontSendNotification);
-
-    portEditor.onReturnKey = [this]{updatePortNumber();};
     portNumberLabel.setText("UDP is " + audioProcessor.getOSCConnectionStatus() + " - Port Number: " + std::to_string(audioProcessor.getPortNumber()), dontSendNotification);
 
-    if(audioProcessor.getNrDelayLines() >= 32) {
-        matrixValueLabel.setFont(Font("Roboto", 10.f, Font::plain));
-    } else if(audioProcessor.getNrDelayLines() >= 16 && audioProcessor.getNrDelayLines() < 32) {
-        matrixValueLabel.setFont(Font("Roboto", 12.f, Font::plain));
-    } else {
-        matrixValueLabel.setFont(Font("Roboto", 12.f, Font::plain));
-    }
-    matrixValueLabel.setText(audioProcessor.getMatrixValues(), dontSendNotification);
+    updateSnapshotLabels();
+    updateDecayLabel();
 }
 
-void FDNReverbAudioProcessorEditor::sliderValueChanged(Slider *slider) {
-    
-    if (slider == &lowT60Slider) {
-        *audioProcessor.t60LOW = lowT60Slider.getValue();
-        audioProcessor.updateFilterBool = true;
-        audioProcessor.updateProcessing = true;
+void FDNReverbAudioProcessorEditor::updateDecayLabel() {
+    auto& analyzer = audioProcessor.getDecayAnalyzer();
+    if (!analyzer.isRunning()) {
+        decayValues.setText("Off", dontSendNotification);
+        shownDecayCount = -1;
+        return;
     }
+    if (analyzer.getResultCount() == shownDecayCount)
+        return;
     
-    if (slider == &highT60Slider) {
-        *audioProcessor.t60HIGH = highT60Slider.getValue();
-        audioProcessor.updateFilterBool = true;
-        audioProcessor.updateProcessing = true;
+    if (analyzer.getResultCount() == 0) {
+        decayValues.setText("Waiting for the input to stop...", dontSendNotification);
+        shownDecayCount = 0;
+        return;
     }
     
-    if (slider == &lowCutoffSlider) {
-        *audioProcessor.transFREQLow = lowCutoffSlider.getValue();
-        audioProcessor.updateFilterBool = true;
-        audioProcessor.updateProcessing = true;
+    shownDecayCount = analyzer.getResultCount();
+    const auto result = analyzer.getResult();
+    String text;
+    for (int b = 0; b < DecayAnalyzer::nrBands; ++b) {
+        const float frequency = DecayAnalyzer::getBandFrequency(b);
+        text += (frequency < 1000.f ? String((int)frequency) : String((int)frequency / 1000) + "k") + ": ";
+        text += (result.measured[b] > 0.f ? String(result.measured[b], 2) : String("-")) + "/" + String(result.target[b], 2);
+        if (b < DecayAnalyzer::nrBands - 1)
+            text += ", ";
     }
+    decayValues.setText(text, dontSendNotification);
+}
+
+// Only the parts whose version has moved on are formatted again, a label
+// repaints itself only when its text changes.
+void FDNReverbAudioProcessorEditor::updateSnapshotLabels() {
+    auto& snapshots = audioProcessor.getSnapshots();
+    if (!snapshots.acquire())
+        return;
     
-    if (slider == &highCutoffSlider) {
-        *audioProcessor.transFREQHigh = highCutoffSlider.getValue();
-        audioProcessor.updateFilterBool = true;
-        audioProcessor.updateProcessing = true;
-    }
+    const auto& snapshot = snapshots.current();
     
-    if (slider == &delayLengthSlider) {
-        *audioProcessor.delLineLength = delayLengthSlider.getValue();
-        audioProcessor.updateDelayBool = true;
-        audioProcessor.updateProcessing = true;
+    // == Values of B and C Gains and Delay line lenghts in sample
+    if (snapshot.gainsVersion != shownGainsVersion) {
+        shownGainsVersion = snapshot.gainsVersion;
+        bGainsValues.setText(FDNSnapshot::formatList(snapshot.bGains, snapshot.nrDelayLines), dontSendNotification);
+        cGainsValues.setText(FDNSnapshot::formatList(snapshot.cGains, snapshot.nrDelayLines), dontSendNotification);
+        bGainsBars.setValues(snapshot.bGains, snapshot.nrDelayLines, snapshot.gainsVersion);
+        cGainsBars.setValues(snapshot.cGains, snapshot.nrDelayLines, snapshot.gainsVersion);
     }
     
-    if (slider == & dryWetSlider) {
-        *audioProcessor.wet = dryWetSlider.getValue();
-        audioProcessor.updateDryWetBool = true;
-        audioProcessor.updateProcessing = true;
+    if (snapshot.delaysVersion != shownDelaysVersion) {
+        shownDelaysVersion = snapshot.delaysVersion;
+        delaysValues.setText(FDNSnapshot::formatList(snapshot.delays, snapshot.nrDelayLines), dontSendNotification);
+        delaysBars.setValues(snapshot.delays, snapshot.nrDelayLines, snapshot.delaysVersion);
     }
+    
+    // the heatmap only draws its image again when it is painted
+    matrixHeatmap.setMatrix(snapshot.matrix, snapshot.nrDelayLines, snapshot.matrixVersion);
 }
 
 void FDNReverbAudioProcessorEditor::comboBoxChanged(ComboBox *comboBox) {
     
-    if(comboBox == &matrixComboBox) {
-        switch(matrixComboBox.getSelectedId()) {
-            case 1: *audioProcessor.matrixSelec = 1; break;
-            case 2: *audioProcessor.matrixSelec = 2; break;
-                
-            default:
-                break;
-        }
-    }
-    
     if(comboBox == &fdnOrderComboBox) {
         switch(fdnOrderComboBox.getSelectedId()) {
             case 1: audioProcessor.setNrDelayLines(4); break;
@@ -381,17 +416,10 @@ void FDNReverbAudioProcessorEditor::comboBoxChanged(ComboBox *comboBox) {
                 break;
         }
     }
-    audioProcessor.updateProcessing = true;
 }
 
-void FDNReverbAudioProcessorEditor::matrixBoxChanged() {
-    if(matrixComboBox.getSelectedId() == 2) {
-        audioProcessor.updateMatrixOSCBool = true;
-    } else {
-        audioProcessor.updateMatrixOSCBool = false;
-    }
-    audioProcessor.updateMatrixBool = true;
-    audioProcessor.updateProcessing = true;
+void FDNReverbAudioProcessorEditor::nrOfRoomsChanged() {
+    audioProcessor.setNrRooms(roomsComboBox.getSelectedId());
 }
 
 void FDNReverbAudioProcessorEditor::drawPaths(float yValue) {
@@ -424,10 +452,17 @@ void FDNReverbAudioProcessorEditor::matrixWindowButtonClicked() {
         matrixComboBox.setVisible(false);
         delayButton.setVisible(false);
         fdnOrderComboBox.setVisible(false);
+        roomsComboBox.setVisible(false);
         
-        matrixValueLabel.setVisible(true);
+        matrixHeatmap.setVisible(true);
+        bGainsBars.setVisible(true);
+        cGainsBars.setVisible(true);
+        delaysBars.setVisible(true);
     } else {
-        matrixValueLabel.setVisible(false);
+        matrixHeatmap.setVisible(false);
+        bGainsBars.setVisible(false);
+        cGainsBars.setVisible(false);
+        delaysBars.setVisible(false);
         lowT60Slider.setVisible(true);
         highT60Slider.setVisible(true);
         lowCutoffSlider.setVisible(true);
@@ -440,6 +475,7 @@ void FDNReverbAudioProcessorEditor::matrixWindowButtonClicked() {
         matrixComboBox.setVisible(true);
         delayButton.setVisible(true);
         fdnOrderComboBox.setVisible(true);
+        roomsComboBox.setVisible(true);
     }
 }
 
@@ -454,6 +490,8 @@ void FDNReverbAudioProcessorEditor::showInfoButtonClicked() {
         bGainsValues.setVisible(true);
         cGainsTitle.setVisible(true);
         cGainsValues.setVisible(true);
+        decayTitle.setVisible(true);
+        decayValues.setVisible(true);
     } else {
         delaysTitle.setVisible(false);
         delaysValues.setVisible(false);
@@ -461,6 +499,8 @@ void FDNReverbAudioProcessorEditor::showInfoButtonClicked() {
         bGainsValues.setVisible(false);
         cGainsTitle.setVisible(false);
         cGainsValues.setVisible(false);
+        decayTitle.setVisible(false);
+        decayValues.setVisible(false);
     }
 }
 
@@ -501,5 +541,4 @@ void FDNReverbAudioProcessorEditor::setSlider(Slider& slider, Slider::SliderStyl
     slider.setValue(def);
     slider.setTextValueSuffix(suffix);
     slider.setTextBoxStyle(Slider::TextBoxLeft, false, textBoxWidth, textBoxHeight);
-    slider.addListener(this);
 }
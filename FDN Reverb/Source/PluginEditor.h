@@ -10,11 +10,13 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "MatrixHeatmap.h"
+#include "BarView.h"
 #include <string>
 //==============================================================================
 /**
 */
-class FDNReverbAudioProcessorEditor  : public juce::AudioProcessorEditor, public Slider::Listener, private Timer, public ComboBox::Listener, public Button::Listener, public TextEditor::Listener
+class FDNReverbAudioProcessorEditor  : public juce::AudioProcessorEditor, private Timer, public ComboBox::Listener, public Button::Listener, public TextEditor::Listener
 {
 public:
     FDNReverbAudioProcessorEditor (FDNReverbAudioProcessor&, AudioProcessorValueTreeState&);
@@ -30,7 +32,8 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
     void timerCallback() override;
-    void sliderValueChanged(Slider *slider) override;
+    void updateSnapshotLabels();
+    void updateDecayLabel();
     void nrOfRoomsChanged();
     void comboBoxChanged(ComboBox *comboBox) override;
     void buttonClicked(Button *button) override{};
@@ -40,7 +43,6 @@ public:
     void connectUDP();
     void changeModulationState();
     
-    void matrixBoxChanged();
     void updatePortNumber();
     
     void setLabel(Label& label, const String& name, const Font& font, const Justification& justific);
@@ -54,20 +56,20 @@ private:
     AudioProcessorValueTreeState& valueTreeState;
     
     
-    Label lowT60Label, highT60Label, lowCutoffabel, highCutoffLabel, dryWetLabel, delayLengthLabel, modDepthLabel, modRateLabel, matrixLabel, fdnOrderLabel, matrixValueLabel, infoLabel, delayButtonLabel, matrixWindowLabel, showInfoLabel, acceptUDPConnectionLabel, modulationButtonLabel;
+    Label lowT60Label, highT60Label, lowCutoffabel, highCutoffLabel, dryWetLabel, delayLengthLabel, modDepthLabel, modRateLabel, matrixLabel, fdnOrderLabel, roomsLabel, infoLabel, delayButtonLabel, matrixWindowLabel, showInfoLabel, acceptUDPConnectionLabel, modulationButtonLabel;
     
     Slider lowT60Slider, highT60Slider, lowCutoffSlider, highCutoffSlider, dryWetSlider, delayLengthSlider, modDepthSlider, modRateSlider;
 
     std::unique_ptr<SliderAttachment> lowT60Attach, highT60Attach, lowCutoffAttach, highCutoffAttach, dryWetSliderAttach, delayLengthAttach, modDepthAttach, modRateAttach;
     
-    ComboBox fdnOrderComboBox, matrixComboBox;
+    ComboBox fdnOrderComboBox, matrixComboBox, roomsComboBox;
     
     std::unique_ptr<ComboBoxAttachment> nrOfRoomsAttach, matrixAttach;
     
     ToggleButton delayButton, matrixWindowButton, showInfoButton, acceptUDPConnectionButton, modulationButton;
     
     // === Layout Labels === //
-    Label titleLabel, nrDelayLinesLabel, oscStatusLabel, portNumberLabel, portEditorLabel, bGainsTitle, bGainsValues, cGainsTitle, cGainsValues, delaysTitle, delaysValues;
+    Label titleLabel, nrDelayLinesLabel, oscStatusLabel, portNumberLabel, portEditorLabel, bGainsTitle, bGainsValues, cGainsTitle, cGainsValues, delaysTitle, delaysValues, decayTitle, decayValues;
     
     int textBoxWidth = 50;
     int textBoxHeight = 15;
@@ -88,6 +90,15 @@ private:
 
     bool updateMatrixBool = true;
     
+    // versions of the processor snapshot the labels were last formatted from
+    uint32 shownGainsVersion = 0, shownDelaysVersion = 0;
+    
+    MatrixHeatmap matrixHeatmap;
+    BarView bGainsBars { "B Gains", Colours::orange };
+    BarView cGainsBars { "C Gains", Colours::cyan };
+    BarView delaysBars { "Delay Lengths", Colours::lightgrey };
+    int shownDecayCount = -1;
+    
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FDNReverbAudioProcessorEditor)
 };
@@ -9,6 +9,17 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+    // the first ones are applied through the listener, the others are read on the timer and every block
+    const char* const parameterIDs[] = { "T60LOW", "T60HIGH", "LOWTRANSFREQ", "HIGHTRANSFREQ", "DELLINELENGTH",
+                                         "DRYWET", "MATRIXSELECTION", "MODRATE", "MODDEPTH", "NROFROOMS" };
+    const int nrListenedParameters = 7;
+    
+    // "FDNS", followed by the version of the layout
+    enum { stateMagic = 0x534e4446, stateVersion = 2 };
+}
+
 //==============================================================================
 FDNReverbAudioProcessor::FDNReverbAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -72,8 +83,14 @@ FDNReverbAudioProcessor::FDNReverbAudioProcessor()
          ("MATRIXSELECTION",
           "Matrix Selection",
           1,
-          2,
-          2)
+          MatrixFactory::filterMatrix,
+          2),
+         std::make_unique<AudioParameterInt>
+         ("NROFROOMS",
+          "Nr. of Rooms",
+          1,
+          CoupledRooms::maxRooms,
+          1)
      })
 #endif
 {
@@ -86,10 +103,23 @@ FDNReverbAudioProcessor::FDNReverbAudioProcessor()
     modDepth = tree.getRawParameterValue("MODDEPTH");
     wet = tree.getRawParameterValue("DRYWET");
     matrixSelec = tree.getRawParameterValue("MATRIXSELECTION");
+    nrOfRooms = tree.getRawParameterValue("NROFROOMS");
+    
+    for (int i = 0; i < nrListenedParameters; ++i)
+        tree.addParameterListener(parameterIDs[i], this);
+    updateMatrixOSCBool = ((int)matrixSelec->load() == 2);
+    
+    // every instance gets its own gains, the seed is saved with the state
+    fdn.setSeed((uint32)Random::getSystemRandom().nextInt());
+    
+    startTimerHz(10);
 }
 
 FDNReverbAudioProcessor::~FDNReverbAudioProcessor()
 {
+    stopTimer();
+    for (int i = 0; i < nrListenedParameters; ++i)
+        tree.removeParameterListener(parameterIDs[i], this);
 }
 
 //==============================================================================
@@ -157,31 +187,78 @@ void FDNReverbAudioProcessor::changeProgramName (int index, const juce::String&
 //==============================================================================
 void FDNReverbAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    const double prepareStart = Time::getMillisecondCounterHiRes();
     
-    Fs = getSampleRate();
-    nrDelayLines = highestFDNOrder;
-
-    fdn.init(Fs, nrDelayLines, lowDel, highDel);
+    // only the first prepare sets the FDN up, after that the gains, delays and
+    // matrix are kept and FDN::prepare scales them to the new rate
+    const bool firstPrepare = !isActive;
+    Fs = sampleRate;
+    if (firstPrepare) {
+        // a state that is waiting already knows its order, so only those delay lines are allocated
+        nrDelayLines = highestFDNOrder;
+        if (engineState.getSize() >= sizeof(int)) {
+            MemoryInputStream stream(engineState, false);
+            const int order = stream.readInt();
+            if (order > 0 && order <= highestFDNOrder)
+                nrDelayLines = order;
+        }
+        fdn.init(Fs, nrDelayLines, lowDel, highDel);
+    }
     
     smoother.reset(Fs, 1.f);
+    wetGain.reset(sampleRate, 0.02);
+    wetGain.setCurrentAndTargetValue(wet->load() / 100.f);
+    
+    // an ambisonic bus runs a single FDN on W, the encoder spreads its lines over the channels
+    ambisonicOrder = jlimit(0, (int)AmbisonicEncoder::maxOrder, getChannelLayoutOfBus(false, 0).getAmbisonicOrder());
+    ambisonicEncoder.prepare(ambisonicOrder, samplesPerBlock);
+    ambisonicBuffer.setSize(ambisonicEncoder.getNumChannels(), samplesPerBlock);
     
     dsp::ProcessSpec spec;
     spec.sampleRate = sampleRate;
     spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = getTotalNumOutputChannels();
+    spec.numChannels = ambisonicOrder > 0 ? 1 : getTotalNumOutputChannels();
     fdn.reset();
     fdn.prepare(spec);
+    fdn.setBackgroundFilterDesign(true);
+    fdn.setBackgroundDelayAllocation(true);
     
     bGains.resize(nrDelayLines);
     cGains.resize(nrDelayLines);
     matrixCoefs.resize(nrDelayLines * nrDelayLines);
+    validatedCoefs.resize(nrDelayLines * nrDelayLines);
     delayVector.resize(nrDelayLines);
+    
+    parallelBuffer.setSize(3, samplesPerBlock);
+    roomsBuffer.setSize(3, samplesPerBlock);
+    hybridBuffer.setSize(2, samplesPerBlock);
+    erBuffer.setSize(2, samplesPerBlock);
+    earlyReflections.prepare(Fs, 2, samplesPerBlock);
+    decayAnalyzer.prepare(Fs, samplesPerBlock);
+    erTapVector.resize(3 * earlyReflections.getNrTaps());
+    t60BandVector.resize(fdn.getGraphicEQ().getNrBands());
+    hybridConvolution.prepare(Fs, 2, samplesPerBlock);
+    if (parallelFDNBool) {
+        configureParallelFDN();
+    }
+    if (nrRooms > 1) {
+        configureCoupledRooms();
+    }
+    // init() went back to the identity, so a generated matrix is built again
+    if (firstPrepare)
+        generatedSelection = 0;
 
     // OSC paramters
     portNumber = 6448;
     
-    updateParameters();
+    const uint32 dirty = dirtyParameters.exchange(0) | (firstPrepare ? (uint32)matrixDirty : 0u);
+    updateParameters(dirty);
+    updateDelayAndMatrix(dirty);
+    restoreEngineState();
     isActive = true;
+    
+    lastPrepareTimeMs = Time::getMillisecondCounterHiRes() - prepareStart;
+    prepareCount++;
 }
 
 void FDNReverbAudioProcessor::releaseResources()
@@ -196,8 +273,10 @@ bool FDNReverbAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
     juce::ignoreUnused (layouts);
     return true;
   #else
+    const int ambisonicOrder = layouts.getMainOutputChannelSet().getAmbisonicOrder();
     if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo()
+     && (ambisonicOrder < 1 || ambisonicOrder > AmbisonicEncoder::maxOrder))
         return false;
 
     // This checks if the input layout matches the output layout
@@ -225,34 +304,191 @@ void FDNReverbAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     if(!isActive)
         return;
     
-    if (updateProcessing) {
-        updateParameters();
-    }
+    if (const uint32 dirty = dirtyParameters.fetch_and(timerDirty) & ~(uint32)timerDirty)
+        updateParameters(dirty);
+    
+    // the only parameter read per sample, so it is loaded once here and ramped
+    wetGain.setTargetValue(wet->load() / 100.f);
+    
+    fdn.applyPendingMatrix();
+    fdn.applyPendingDelays();
     
     if(modulateFDNBool) {
         fdn.updateModulation(modDepth->load(), modRate->load());
     }
     
+    // only copies anything when the editor has something new to show
+    snapshots.publish(fdn);
+    settingsSnapshots.publish(fdn);
+    
+    // the output follows in finishFDNBlock(), which every path ends with
+    decayAnalyzer.pushInput(buffer.getReadPointer(0), buffer.getNumSamples());
+    
+    // the parallel, rooms and stereo paths below are all two channel
+    if (ambisonicOrder > 0) {
+        processAmbisonic(buffer);
+        if (outputBlewUp(buffer))
+            fdn.recover();
+        finishFDNBlock(buffer);
+        return;
+    }
+    
+    if (parallelFDNBool) {
+        const SpinLock::ScopedTryLockType lock(parallelLock);
+        if (lock.isLocked()) {
+            auto* left = buffer.getWritePointer(0);
+            auto* right = buffer.getWritePointer(1);
+            auto* mono = parallelBuffer.getWritePointer(0);
+            auto* wetLeft = parallelBuffer.getWritePointer(1);
+            auto* wetRight = parallelBuffer.getWritePointer(2);
+            
+            for (int start = 0; start < buffer.getNumSamples(); start += parallelBuffer.getNumSamples()) {
+                const int numSamples = jmin(parallelBuffer.getNumSamples(), buffer.getNumSamples() - start);
+                
+                // the parallel network is fed with the mono sum of the input
+                for (int n = 0; n < numSamples; ++n) {
+                    mono[n] = 0.5f * (left[start + n] + right[start + n]);
+                }
+                parallelFDN.processBlock(mono, wetLeft, wetRight, numSamples);
+                
+                for (int n = 0; n < numSamples; ++n) {
+                    const float g = wetGain.getNextValue();
+                    left[start + n] = 0.6 * ((1.0f - g) * left[start + n] + g * wetLeft[n]);
+                    right[start + n] = 0.6 * ((1.0f - g) * right[start + n] + g * wetRight[n]);
+                }
+            }
+            if (outputBlewUp(buffer))
+                parallelFDN.reset();
+            finishFDNBlock(buffer);
+            return;
+        }
+    }
+    
+    if (nrRooms > 1) {
+        const SpinLock::ScopedTryLockType lock(roomsLock);
+        if (lock.isLocked()) {
+            auto* left = buffer.getWritePointer(0);
+            auto* right = buffer.getWritePointer(1);
+            auto* mono = roomsBuffer.getWritePointer(0);
+            auto* wetLeft = roomsBuffer.getWritePointer(1);
+            auto* wetRight = roomsBuffer.getWritePointer(2);
+            
+            for (int start = 0; start < buffer.getNumSamples(); start += roomsBuffer.getNumSamples()) {
+                const int numSamples = jmin(roomsBuffer.getNumSamples(), buffer.getNumSamples() - start);
+                
+                for (int n = 0; n < numSamples; ++n) {
+                    mono[n] = 0.5f * (left[start + n] + right[start + n]);
+                }
+                coupledRooms.processBlock(mono, wetLeft, wetRight, numSamples);
+                
+                for (int n = 0; n < numSamples; ++n) {
+                    const float g = wetGain.getNextValue();
+                    left[start + n] = 0.6 * ((1.0f - g) * left[start + n] + g * wetLeft[n]);
+                    right[start + n] = 0.6 * ((1.0f - g) * right[start + n] + g * wetRight[n]);
+                }
+            }
+            if (outputBlewUp(buffer))
+                coupledRooms.reset();
+            finishFDNBlock(buffer);
+            return;
+        }
+    }
+    
 
         auto* left = buffer.getWritePointer(0);
         auto* right = buffer.getWritePointer(1);
         const int numSamples = buffer.getNumSamples();
 
         smoother.setTargetValue(delLineLength->load());
+    
+    // the FDN is fed either straight from the input or through the early reflections
+    const float* fdnInLeft = left;
+    const float* fdnInRight = right;
+    if (earlyReflectionsBool) {
+        erBuffer.setSize(2, numSamples, false, false, true);
+        earlyReflections.process(0, left, erBuffer.getWritePointer(0), numSamples);
+        earlyReflections.process(1, right, erBuffer.getWritePointer(1), numSamples);
+        fdnInLeft = erBuffer.getReadPointer(0);
+        fdnInRight = erBuffer.getReadPointer(1);
+    }
+    
+    hybridConvolution.checkForChanges(parameterChangeCount.load());
+    // all of the state, so the FDN starts from silence when it runs again
+    if (hybridConvolution.shouldResetFDN())
+        fdn.recover();
+    if (hybridConvolution.isActive()) {
+        auto* wetLeft = hybridBuffer.getWritePointer(0);
+        auto* wetRight = hybridBuffer.getWritePointer(1);
+        
+        for (int start = 0; start < numSamples; start += hybridBuffer.getNumSamples()) {
+            const int count = jmin(hybridBuffer.getNumSamples(), numSamples - start);
+            
+            // the FDN is skipped completely once the convolution has taken over
+            if (hybridConvolution.needsFDN()) {
+                for (int n = 0; n < count; ++n) {
+                    wetLeft[n] = fdn.processFDN(0, fdnInLeft[start + n]);
+                    wetRight[n] = fdn.processFDN(1, fdnInRight[start + n]);
+                }
+            }
+            
+            const float* input[] = { fdnInLeft + start, fdnInRight + start };
+            float* wetPath[] = { wetLeft, wetRight };
+            hybridConvolution.process(input, wetPath, 2, count);
+            
+            for (int n = 0; n < count; ++n) {
+                const float g = wetGain.getNextValue();
+                left[start + n] = 0.6 * ((1.0f - g) * left[start + n] + g * wetLeft[n]);
+                right[start + n] = 0.6 * ((1.0f - g) * right[start + n] + g * wetRight[n]);
+            }
+        }
+    } else {
         for (int n = 0; n < numSamples; ++n) {
             float dryLeft = left[n];
             float dryRight = right[n];
 
-            float leftPath = fdn.processFDN(0, left[n]);
-            float rightPath = fdn.processFDN(1, right[n]);
+            float leftPath = fdn.processFDN(0, fdnInLeft[n]);
+            float rightPath = fdn.processFDN(1, fdnInRight[n]);
 
-            left[n] = 0.6 * ((1.0f - (wet->load()/100)) * dryLeft + (wet->load()/100) * leftPath);
-            right[n] = 0.6 * ((1.0f - (wet->load()/100)) * dryRight + (wet->load()/100) * rightPath);
+            const float g = wetGain.getNextValue();
+            left[n] = 0.6 * ((1.0f - g) * dryLeft + g * leftPath);
+            right[n] = 0.6 * ((1.0f - g) * dryRight + g * rightPath);
         }
-    if (changingFDNOrder) {
-        fdn.updateFDN(nrDelayLines, matrixSelec->load());
-        changingFDNOrder = !changingFDNOrder;
     }
+    if (outputBlewUp(buffer))
+        fdn.recover();
+    finishFDNBlock(buffer);
+}
+
+// W drives the FDN and its filtered line outputs are encoded to every channel
+// of the bus at the end of each chunk. The dry part of each channel is kept.
+void FDNReverbAudioProcessor::processAmbisonic(AudioBuffer<float>& buffer) {
+    const int numChannels = jmin(buffer.getNumChannels(), ambisonicEncoder.getNumChannels());
+    const int blockSize = ambisonicEncoder.getBlockSize();
+    float* lines = ambisonicEncoder.getLineBuffer();
+    float* const* channels = buffer.getArrayOfWritePointers();
+    float* const* wet = ambisonicBuffer.getArrayOfWritePointers();
+    
+    for (int start = 0; start < buffer.getNumSamples(); start += blockSize) {
+        const int count = jmin(blockSize, buffer.getNumSamples() - start);
+        
+        for (int n = 0; n < count; ++n)
+            fdn.processFDN(0, channels[0][start + n], lines + n, blockSize);
+        ambisonicEncoder.process(fdn.cGains.data(), fdn.nrDelayLines, wet, numChannels, count);
+        
+        for (int n = 0; n < count; ++n) {
+            const float g = wetGain.getNextValue();
+            for (int ch = 0; ch < numChannels; ++ch)
+                channels[ch][start + n] = 0.6 * ((1.0f - g) * channels[ch][start + n] + g * wet[ch][n]);
+        }
+    }
+}
+
+void FDNReverbAudioProcessor::finishFDNBlock(AudioBuffer<float>& buffer) {
+    decayAnalyzer.pushOutput(buffer.getReadPointer(0), buffer.getNumSamples());
+    
+    // waits for the delay lines of a higher order, the old order keeps running until then
+    if (changingFDNOrder && fdn.updateFDN(nrDelayLines, matrixSelec->load()))
+        changingFDNOrder = false;
 }
 
 //==============================================================================
@@ -268,62 +504,182 @@ juce::AudioProcessorEditor* FDNReverbAudioProcessor::createEditor()
 }
 
 //==============================================================================
+// Binary chunk: magic and version, every parameter by ID, the matrix seed and
+// the modulation switch, the processor settings only OSC reaches (version 2),
+// then the engine state of the FDN. The arrays are written as they are, so
+// saving and loading are plain copies.
 void FDNReverbAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    ValueTree state = tree.copyState();
-    std::unique_ptr<XmlElement> xml = state.createXml();
-    copyXmlToBinary(*xml.get(), destData);
+    MemoryOutputStream stream(destData, false);
+    stream.writeInt(stateMagic);
+    stream.writeInt(stateVersion);
+    
+    stream.writeInt(numElementsInArray(parameterIDs));
+    for (auto* parameterID : parameterIDs) {
+        stream.writeString(parameterID);
+        stream.writeFloat(tree.getParameter(parameterID)->getValue());
+    }
+    stream.writeInt(matrixSeed);
+    stream.writeInt(modulateFDNBool ? 1 : 0);
+    
+    stream.writeBool(earlyReflectionsBool);
+    stream.writeInt(earlyReflections.getNrTaps());
+    for (int i = 0; i < earlyReflections.getNrTaps(); ++i) {
+        stream.writeFloat(earlyReflections.getTapDelayMs(i));
+        stream.writeFloat(earlyReflections.getTapGain(i));
+        stream.writeFloat(earlyReflections.getTapCutoff(i));
+    }
+    stream.writeInt(matrixValidation);
+    stream.writeInt(filterLowType);
+    stream.writeInt(filterHighType);
+    stream.writeInt((int)fdn.getDelayStorage());
+    
+    // before prepareToPlay the FDN has nothing yet, a state that is still waiting is passed on
+    if (isActive)
+        fdn.getState(stream);
+    else if (engineState.getSize() > 0)
+        stream.write(engineState.getData(), engineState.getSize());
+    else
+        stream.writeInt(0);
 }
 
 void FDNReverbAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    std::unique_ptr<XmlElement> xmlState = getXmlFromBinary(data, sizeInBytes);
-    ValueTree state = ValueTree::fromXml(*xmlState.get());
-    tree.replaceState(state);
+    MemoryInputStream stream(data, (size_t)sizeInBytes, false);
+    
+    // sessions from before the binary state
+    if (sizeInBytes < 8 || stream.readInt() != stateMagic) {
+        std::unique_ptr<XmlElement> xmlState = getXmlFromBinary(data, sizeInBytes);
+        if (xmlState != nullptr)
+            tree.replaceState(ValueTree::fromXml(*xmlState.get()));
+        return;
+    }
+    const int version = stream.readInt();
+    if (version > stateVersion)
+        return;
+    
+    const int nrParameters = stream.readInt();
+    for (int i = 0; i < nrParameters && !stream.isExhausted(); ++i) {
+        const String parameterID = stream.readString();
+        const float value = stream.readFloat();
+        if (auto* parameter = tree.getParameter(parameterID))
+            parameter->setValueNotifyingHost(value);
+    }
+    matrixSeed = stream.readInt();
+    modulateFDNBool = stream.readInt() != 0;
+    generatedSelection = 0;     // built again from the seed on the timer
+    
+    if (version >= 2) {
+        earlyReflectionsBool = stream.readBool();
+        const int nrTaps = jlimit(0, (int)EarlyReflections::maxTaps, stream.readInt());
+        for (int i = 0; i < nrTaps; ++i) {
+            const float delayMs = stream.readFloat();
+            const float gain = stream.readFloat();
+            earlyReflections.setTap(i, delayMs, gain, stream.readFloat());
+        }
+        earlyReflections.setNrTaps(nrTaps);
+        erTapVector.resize(3 * nrTaps);
+        
+        matrixValidation = jlimit((int)MatrixValidator::off, (int)MatrixValidator::project, stream.readInt());
+        const int lowType = stream.readInt();
+        const int highType = stream.readInt();
+        if (MatrixFactory::isGenerated(lowType))
+            filterLowType = lowType;
+        if (MatrixFactory::isGenerated(highType))
+            filterHighType = highType;
+        
+        // prepares again if it is running, before the engine state below is restored
+        setDelayStorage((CompressedDelayLine::Format)jlimit(0, 2, stream.readInt()));
+    }
+    
+    engineState.setSize((size_t)stream.getNumBytesRemaining());
+    stream.read(engineState.getData(), (int)engineState.getSize());
+    
+    if (isActive) {
+        suspendProcessing(true);
+        restoreEngineState();
+        suspendProcessing(false);
+    }
 }
 
-void FDNReverbAudioProcessor::numChannelsChanged() {
+// Message thread, with the audio thread held off. Only a change of order
+// allocates, everything else is copied into the existing arrays.
+void FDNReverbAudioProcessor::restoreEngineState() {
+    if (engineState.getSize() < sizeof(int))
+        return;
+    
+    MemoryInputStream stream(engineState, false);
+    const int order = stream.readInt();
+    if (order > 0 && order <= highestFDNOrder) {
+        if (order != nrDelayLines) {
+            setNrDelayLines(order);
+            fdn.allocateDelayLines(order);
+            fdn.updateFDN(order, (int)matrixSelec->load());
+            changingFDNOrder = false;
+            generatedSelection = 0;
+        }
+        
+        MemoryInputStream engine(engineState, false);
+        if (fdn.setState(engine)) {
+            // the custom matrix is handed to the FDN again with the next matrix update
+            const float* matrix = fdn.mixingMatrix->getRawDataPointer();
+            matrixCoefs.resize(order * order);
+            std::copy(matrix, matrix + order * order, matrixCoefs.begin());
+            validatedCoefs = matrixCoefs;
+            
+            // the restored delays win over the ones DELLINELENGTH would give
+            dirtyParameters.fetch_and(~(uint32)delayDirty);
+            markParameterChange();
+        }
+    }
+    engineState.reset();
+}
 
+// the delay lines and filters are sized per channel, so a new layout needs a new
+// prepare. Before the first prepareToPlay there is nothing to resize.
+void FDNReverbAudioProcessor::numChannelsChanged() {
+    if (isActive)
+        prepareToPlay(getSampleRate(), getBlockSize());
 }
 
-void FDNReverbAudioProcessor::updateParameters() {
+void FDNReverbAudioProcessor::updateParameters(uint32 dirty) {
 
-    updateProcessing = false;
+    markParameterChange();
     
     float g_DC = t60LOW->load();
     float g_PI = t60HIGH->load();
     float l_fT = transFREQLow->load();
     float h_fT = transFREQHigh->load();
-    float delLength = delLineLength->load();
-    float dryWet = wet->load();
-    int newMatrixValue = matrixSelec->load();
-    
-    float m_Rate = modRate->load();
-    float m_Depth = modDepth->load();
 
     // make sure only needed variables are updated
-        if(updateFilterBool) {
-            fdn.updateFilter(g_DC, g_PI, l_fT, h_fT);
-            updateFilterBool = false;
-        }
-        if(updateDelayBool) {
-            fdn.updateDelay(delLength);
+        if(dirty & filterDirty) {
             fdn.updateFilter(g_DC, g_PI, l_fT, h_fT);
-            updateDelayBool = false;
+            updateParallelFilter();
         }
 
-        if(updateDryWetBool) {
-            fdn.updateDryMix(dryWet/100.f);
-            updateDryWetBool = false;
+        if(dirty & dryWetDirty) {
+            fdn.updateDryMix(wet->load()/100.f);
         }
+    }
+
+// The primes of the new delays are searched here and the FDN ramps the lines to
+// them, the selected matrix is built here and copied in by the audio thread.
+void FDNReverbAudioProcessor::updateDelayAndMatrix(uint32 dirty) {
+    if (!(dirty & timerDirty))
+        return;
     
-        if(updateMatrixBool) {
-            fdn.updateMatrixCoefficients(matrixCoefs, newMatrixValue);
-            updateMatrixBool = false;
-        }
+    markParameterChange();
     
-//    fdn.updateModulation(m_Depth, m_Rate);
+    if(dirty & delayDirty) {
+        fdn.updateDelay(delLineLength->load());
+        fdn.updateFilter(t60LOW->load(), t60HIGH->load(), transFREQLow->load(), transFREQHigh->load());
+        updateParallelFilter();
     }
+    
+    if(dirty & matrixDirty) {
+        fdn.updateMatrixCoefficients(validatedCoefs, (int)matrixSelec->load());
+    }
+}
 
 //==============================================================================
 // This creates new instances of the plugin..
@@ -333,8 +689,29 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 }
 
 
-void FDNReverbAudioProcessor::valueTreePropertyChanged(ValueTree &treeWhosePropertyChanged, const Identifier &property) {
-     updateProcessing = true;
+// Called on whichever thread changed the parameter, the audio thread during
+// automation, so it only flags what has to be updated at the next block.
+void FDNReverbAudioProcessor::parameterChanged(const String& parameterID, float newValue) {
+    if (parameterID == "DELLINELENGTH") {
+        markDirty(delayDirty);
+    } else if (parameterID == "DRYWET") {
+        markDirty(dryWetDirty);
+    } else if (parameterID == "MATRIXSELECTION") {
+        // the custom matrix is the one that comes over OSC
+        updateMatrixOSCBool = ((int)newValue == 2);
+        markDirty(matrixDirty);
+    } else {
+        markDirty(filterDirty);
+    }
+}
+
+void FDNReverbAudioProcessor::markDirty(uint32 flags) {
+    dirtyParameters.fetch_or(flags);
+}
+
+void FDNReverbAudioProcessor::setParameterFromOSC(const String& parameterID, float newValue) {
+    if (auto* parameter = tree.getParameter(parameterID))
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(newValue));
 }
 
 
@@ -344,6 +721,168 @@ int FDNReverbAudioProcessor::getNrDelayLines() {
 
 void FDNReverbAudioProcessor::modulateFDN(bool modulate) {
     modulateFDNBool = modulate;
+    markParameterChange();
+}
+
+void FDNReverbAudioProcessor::markParameterChange() {
+    parameterChangeCount++;
+}
+
+// Energy of each channel against a mean square of 100 (+40 dB). A NaN fails
+// every comparison, so the test is written to let those through as well.
+bool FDNReverbAudioProcessor::outputBlewUp(AudioBuffer<float>& buffer) {
+    const int numSamples = buffer.getNumSamples();
+    const float limit = 1.0e4f * numSamples;
+    
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+        const float* data = buffer.getReadPointer(ch);
+        float energy = 0.0f;
+        for (int n = 0; n < numSamples; ++n)
+            energy += data[n] * data[n];
+        
+        if (!(energy <= limit)) {
+            buffer.clear();
+            outputRecoveries++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void FDNReverbAudioProcessor::timerCallback() {
+    if (outputRecoveries.load() != reportedRecoveries) {
+        reportedRecoveries = outputRecoveries.load();
+        oscMessageStatus = "Output blew up, FDN cleared (" + std::to_string(reportedRecoveries) + ")";
+        OSCSender::send("/juce/recovered", reportedRecoveries);
+    }
+    
+    if (parallelFDN.getMissedBlocks() != reportedParallelMisses) {
+        reportedParallelMisses = parallelFDN.getMissedBlocks();
+        if (reportedParallelMisses > 0) {
+            oscMessageStatus = "Parallel FDN missed a block (" + std::to_string(reportedParallelMisses) + ")";
+            OSCSender::send("/juce/parallelMissed", reportedParallelMisses);
+        }
+    }
+    
+    if (prepareCount.load() != reportedPrepareCount) {
+        reportedPrepareCount = prepareCount.load();
+        oscMessageStatus = "Prepared in " + String(lastPrepareTimeMs, 2).toStdString() + " ms";
+        OSCSender::send("/juce/prepareTime", (float)lastPrepareTimeMs);
+    }
+    
+    settingsSnapshots.acquire();
+    hybridConvolution.update(fdn, settingsSnapshots.current(), parameterChangeCount.load(), !modulateFDNBool && !parallelFDNBool && nrRooms == 1
+                             && ambisonicOrder == 0
+                             && !fdn.isMatrixModulating() && !fdn.isMatrixMorphing());
+    
+    if (isActive)
+        updateDelayAndMatrix(dirtyParameters.fetch_and(~(uint32)timerDirty) & timerDirty);
+    
+    updateGeneratedMatrix();
+    
+    if (storageReportReady.exchange(false))
+        sendDelayStorageReport();
+    
+    if (decayAnalyzer.isRunning()) {
+        for (int b = 0; b < DecayAnalyzer::nrBands; ++b)
+            decayAnalyzer.setTarget(b, fdn.getTargetT60(DecayAnalyzer::getBandFrequency(b)));
+        
+        if (decayAnalyzer.getResultCount() != reportedDecayCount) {
+            reportedDecayCount = decayAnalyzer.getResultCount();
+            sendDecayAnalysis();
+        }
+    }
+    
+    // follows the shelf T60s of the plugin, only designs when something has changed
+    if (fdn.isGraphicEQOn())
+        fdn.updateGraphicEQ();
+    
+    // designed again whenever the attenuation filters have changed
+    if (fdn.isToneCorrectionOn())
+        fdn.updateToneCorrection();
+    
+    // the rooms parameter can also be changed by the host
+    if ((int)nrOfRooms->load() != nrRooms)
+        setNrRooms((int)nrOfRooms->load());
+    
+    // the rooms share the transition frequencies of the plugin, their T60s come from OSC
+    if (roomsLowTransFreq != transFREQLow->load() || roomsHighTransFreq != transFREQHigh->load()) {
+        roomsLowTransFreq = transFREQLow->load();
+        roomsHighTransFreq = transFREQHigh->load();
+        coupledRooms.setTransitionFrequencies(roomsLowTransFreq, roomsHighTransFreq);
+    }
+}
+
+// Builds the selected matrix whenever the type, the seed or the order of the
+// FDN has changed. The order is taken from the FDN itself, since the audio
+// thread only resizes it after setNrDelayLines().
+void FDNReverbAudioProcessor::updateGeneratedMatrix() {
+    // the FDN has no order before prepareToPlay, the matrix is built once it has
+    if (!isActive)
+        return;
+    
+    const int selection = (int)matrixSelec->load();
+    if (!MatrixFactory::isGenerated(selection) && selection != MatrixFactory::filterMatrix) {
+        generatedSelection = 0;
+        return;
+    }
+    
+    const int order = fdn.nrDelayLines;
+    if (selection == generatedSelection && order == generatedOrder && matrixSeed == generatedSeed)
+        return;
+    
+    if (selection == MatrixFactory::filterMatrix)
+        fdn.setFilterMatrices(MatrixFactory::create(filterLowType, order, matrixSeed),
+                              MatrixFactory::create(filterHighType, order, matrixSeed + 1));
+    else
+        fdn.setMatrix(MatrixFactory::create(selection, order, matrixSeed));
+    generatedSelection = selection;
+    generatedOrder = order;
+    generatedSeed = matrixSeed;
+    markParameterChange();
+}
+
+void FDNReverbAudioProcessor::setNrRooms(int newNrRooms) {
+    newNrRooms = jlimit(1, (int)CoupledRooms::maxRooms, newNrRooms);
+    if (newNrRooms == nrRooms)
+        return;
+    
+    markParameterChange();
+    if (newNrRooms > 1) {
+        nrRooms = newNrRooms;
+        // before prepareToPlay the rooms are built there
+        if (isActive)
+            configureCoupledRooms();
+    } else {
+        const SpinLock::ScopedLockType lock(roomsLock);
+        nrRooms = 1;
+    }
+}
+
+void FDNReverbAudioProcessor::configureCoupledRooms() {
+    // allocates, so this is never called from the audio thread
+    const SpinLock::ScopedLockType lock(roomsLock);
+    coupledRooms.init(Fs, nrDelayLines, nrRooms);
+    coupledRooms.setCoupling(coupling);
+    coupledRooms.reset();
+}
+
+void FDNReverbAudioProcessor::configureParallelFDN() {
+    // allocates and starts threads, so this is never called from the audio thread
+    const SpinLock::ScopedLockType lock(parallelLock);
+    parallelFDN.init(Fs, parallelOrder, lowDel, highDel, parallelThreads);
+    parallelFDN.updateFilter(t60LOW->load(), t60HIGH->load(), transFREQLow->load(), transFREQHigh->load());
+    if (MatrixFactory::isGenerated((int)matrixSelec->load()))
+        parallelFDN.setMatrix(MatrixFactory::create((int)matrixSelec->load(), parallelOrder, matrixSeed));
+}
+
+void FDNReverbAudioProcessor::updateParallelFilter() {
+    if (!parallelFDNBool)
+        return;
+    
+    const SpinLock::ScopedTryLockType lock(parallelLock);
+    if (lock.isLocked())
+        parallelFDN.updateFilter(t60LOW->load(), t60HIGH->load(), transFREQLow->load(), transFREQHigh->load());
 }
 
 void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
@@ -351,6 +890,7 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
     // A check has to be made for it to work
     if (message[0].isString()) {
         String messageString = message[0].getString(); // get the string argument
+        markParameterChange();
         
         if(messageString.compare("connected") == 0) {
             oscConnectionStatus = "Connected";
@@ -361,10 +901,17 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
             oscMessageStatus = "Updating B Gains...";
 
             if(message[1].isFloat32()) {
+                const int order = getGainOrder();
+                bGains.resize(jmax(order, nrDelayLines));
                 bGains[count] = message[1].getFloat32();
                 count++;
-                if(count >= nrDelayLines) {
-                    fdn.setBGains(bGains);
+                if(count >= order) {
+                    if (parallelFDNBool) {
+                        const SpinLock::ScopedLockType lock(parallelLock);
+                        parallelFDN.setBGains(bGains);
+                    } else {
+                        fdn.setBGains(bGains);
+                    }
                     oscMessageStatus = "B Gains Updated";
                     count = 0;
                 }
@@ -374,10 +921,17 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
             oscMessageStatus = "Updating C Gains...";
             
             if (message[1].isFloat32()) {
+                const int order = getGainOrder();
+                cGains.resize(jmax(order, nrDelayLines));
                 cGains[count] = message[1].getFloat32();
                 count++;
-                if(count >= nrDelayLines) {
-                    fdn.setCGains(cGains);
+                if(count >= order) {
+                    if (parallelFDNBool) {
+                        const SpinLock::ScopedLockType lock(parallelLock);
+                        parallelFDN.setCGains(cGains, cGains);
+                    } else {
+                        fdn.setCGains(cGains);
+                    }
                     oscMessageStatus = "C Gains Updated";
                     count = 0;
                 }
@@ -386,38 +940,44 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
         // Single gain value updates
         if(messageString.compare("bGainSingle") == 0) {
             if (message[1].isInt32() && message[2].isFloat32()) {
-                fdn.setSingleBGain(message[1].getInt32(), message[2].getFloat32());
+                if (parallelFDNBool) {
+                    const SpinLock::ScopedLockType lock(parallelLock);
+                    parallelFDN.setSingleBGain(message[1].getInt32(), message[2].getFloat32());
+                } else {
+                    fdn.setSingleBGain(message[1].getInt32(), message[2].getFloat32());
+                }
                 oscMessageStatus = "B Gain Index [" + std::to_string(message[1].getInt32()) + "] Updated";
             }
         }
         
         if(messageString.compare("cGainSingle") == 0) {
             if (message[1].isInt32() && message[2].isFloat32()) {
-                fdn.setSingleCGain(message[1].getInt32(), message[2].getFloat32());
+                if (parallelFDNBool) {
+                    const SpinLock::ScopedLockType lock(parallelLock);
+                    parallelFDN.setSingleCGain(message[1].getInt32(), message[2].getFloat32());
+                } else {
+                    fdn.setSingleCGain(message[1].getInt32(), message[2].getFloat32());
+                }
                 oscMessageStatus = "C Gain Index [" + std::to_string(message[1].getInt32()) + "] Updated";
             }
         }
         // ======================================
         // === Matrix Updates ====
         if(messageString.compare("matrixWhole") == 0) {
-            updateMatrixBool = true;
             if(updateMatrixOSCBool) {
                 oscMessageStatus = "Updating Matrix Coefficients...";
                 if (message[1].isFloat32()) {
                     matrixCoefs[count] = message[1].getFloat32();
                     count++;
                     if (count >= nrDelayLines * nrDelayLines) {
-                        fdn.updateMatrixCoefficientsOSC(matrixCoefs, "whole");
-                        oscMessageStatus = "Matrix Updated";
+                        installOSCMatrix("whole");
                         count = 0;
-                        updateMatrixBool = false;
                     }
                 }
             }
         }
         
         if(messageString.compare("matrixSingle") == 0) {
-            updateMatrixBool = true;
             if (updateMatrixOSCBool) {
                 oscMessageStatus = "Updating Matrix Coefficients...";
                 if(message[1].isInt32() && message[2].isInt32() && message[3].isFloat32()) {
@@ -425,8 +985,7 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
                     int col = message[2].getInt32();
                     float val = message[3].getFloat32();
                     matrixCoefs[row * nrDelayLines + col] = val;
-                    fdn.updateMatrixCoefficientsOSC(matrixCoefs, "single");
-                    oscMessageStatus = "Matrix Index [" + std::to_string(row) + "," + std::to_string(col) + "] Updated";
+                    installOSCMatrix("single");
                 }
             }
         }
@@ -465,8 +1024,7 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
         if(messageString.compare("dryWet") == 0) {
             oscMessageStatus = "Updating Dry/Wet Value...";
             if (message[1].isFloat32()) {
-                wet->operator=(message[1].getFloat32());
-                fdn.updateDryMix(message[1].getFloat32()/100.f);
+                setParameterFromOSC("DRYWET", message[1].getFloat32());
                 oscMessageStatus = "Dry/Wet Value updated";
             }
         }
@@ -477,8 +1035,7 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
             oscMessageStatus = "Updating High T60 Value...";
             
             if (message[1].isFloat32()) {
-                t60HIGH->operator=(message[1].getFloat32());
-                fdn.updateFilter(t60LOW->load(), t60HIGH->load(), transFREQLow->load(), transFREQHigh->load());
+                setParameterFromOSC("T60HIGH", message[1].getFloat32());
                 oscMessageStatus = "High T60 Updated";
             }
         }
@@ -487,8 +1044,7 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
             oscMessageStatus = "Updating Low T60 Value...";
             
             if (message[1].isFloat32()) {
-                t60LOW->operator=(message[1].getFloat32());
-                fdn.updateFilter(t60LOW->load(), t60HIGH->load(), transFREQLow->load(), transFREQHigh->load());
+                setParameterFromOSC("T60LOW", message[1].getFloat32());
                 oscMessageStatus = "Low T60 Updated";
             }
         }
@@ -497,8 +1053,7 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
             oscMessageStatus = "Updating Low Transitional Frequency...";
             
             if (message[1].isFloat32()) {
-                transFREQLow->operator=(message[1].getFloat32());
-                fdn.updateFilter(t60LOW->load(), t60HIGH->load(), transFREQLow->load(), transFREQHigh->load());
+                setParameterFromOSC("LOWTRANSFREQ", message[1].getFloat32());
                 oscMessageStatus = "Transitional Frequency Updated";
             }
         }
@@ -507,13 +1062,451 @@ void FDNReverbAudioProcessor::oscMessageReceived(const OSCMessage &message) {
             oscMessageStatus = "Updating High Transitional Frequency...";
             
             if (message[1].isFloat32()) {
-                transFREQHigh->operator=(message[1].getFloat32());
-                fdn.updateFilter(t60LOW->load(), t60HIGH->load(), transFREQLow->load(), transFREQHigh->load());
+                setParameterFromOSC("HIGHTRANSFREQ", message[1].getFloat32());
                 oscMessageStatus = "Transitional Frequency Updated";
             }
 
         }
         
+        // ==== GRAPHIC EQ ====
+        // "follow" takes the band T60s from the shelf parameters, "on" keeps the ones set over OSC
+        if (messageString.compare("graphicEQ") == 0) {
+            if (message[1].isString()) {
+                String eqString = message[1].getString();
+                if (eqString.compare("on") == 0 || eqString.compare("follow") == 0) {
+                    fdn.setGraphicEQ(true, eqString.compare("follow") == 0);
+                    markParameterChange();
+                    oscMessageStatus = "Graphic EQ is on, designed in " + String(fdn.getGraphicEQ().getDesignTime(), 3).toStdString() + " ms";
+                } else if (eqString.compare("off") == 0) {
+                    fdn.setGraphicEQ(false, true);
+                    markParameterChange();
+                    oscMessageStatus = "Graphic EQ is off";
+                }
+            }
+        }
+        
+        if (messageString.compare("graphicEQBands") == 0) {
+            if (message[1].isInt32()) {
+                fdn.getGraphicEQ().setNrBands(message[1].getInt32());
+                fdn.updateGraphicEQ();
+                markParameterChange();
+                t60BandVector.resize(fdn.getGraphicEQ().getNrBands());
+                count = 0;
+                oscMessageStatus = "Graphic EQ bands = " + std::to_string(fdn.getGraphicEQ().getNrBands());
+            }
+        }
+        
+        // T60 of every band, from the lowest band up
+        if (messageString.compare("t60BandWhole") == 0) {
+            oscMessageStatus = "Updating Band T60s...";
+            if (message[1].isFloat32() && !t60BandVector.empty()) {
+                t60BandVector[count] = message[1].getFloat32();
+                count++;
+                if (count >= (int)t60BandVector.size()) {
+                    for (int k = 0; k < (int)t60BandVector.size(); ++k) {
+                        fdn.getGraphicEQ().setT60(k, t60BandVector[k]);
+                    }
+                    fdn.setGraphicEQ(fdn.isGraphicEQOn(), false);
+                    markParameterChange();
+                    oscMessageStatus = "Band T60s Updated, designed in " + String(fdn.getGraphicEQ().getDesignTime(), 3).toStdString() + " ms";
+                    count = 0;
+                }
+            }
+        }
+        
+        if (messageString.compare("t60BandSingle") == 0) {
+            if (message[1].isInt32() && message[2].isFloat32()) {
+                fdn.getGraphicEQ().setT60(message[1].getInt32(), message[2].getFloat32());
+                fdn.setGraphicEQ(fdn.isGraphicEQOn(), false);
+                markParameterChange();
+                oscMessageStatus = "Band T60 [" + std::to_string(message[1].getInt32()) + "] Updated";
+            }
+        }
+        
+        // automatic EQ on the output that undoes the colouration of the decay
+        if (messageString.compare("toneCorrection") == 0) {
+            if (message[1].isString()) {
+                String toneString = message[1].getString();
+                if (toneString.compare("on") == 0) {
+                    fdn.setToneCorrection(true);
+                    markParameterChange();
+                    oscMessageStatus = "Tone correction is on";
+                } else if (toneString.compare("off") == 0) {
+                    fdn.setToneCorrection(false);
+                    markParameterChange();
+                    oscMessageStatus = "Tone correction is off";
+                }
+            }
+        }
+        
+        // ==== OUTPUT TAPS ====
+        if (messageString.compare("outputTaps") == 0) {
+            if (message[1].isInt32()) {
+                const int tapsPerLine = message[1].getInt32();
+                if (tapsPerLine > 0)
+                    fdn.getOutputTaps().setDefaultTaps(tapsPerLine);
+                else
+                    fdn.getOutputTaps().setTapsPerLine(0);
+                markParameterChange();
+                oscMessageStatus = "Output taps per line = " + std::to_string(fdn.getOutputTaps().getTapsPerLine());
+            }
+        }
+        
+        if (messageString.compare("outputTap") == 0) {
+            if (message[1].isInt32() && message[2].isInt32() && message[3].isFloat32() && message[4].isFloat32()) {
+                fdn.getOutputTaps().setTap(message[1].getInt32(), message[2].getInt32(),
+                                           message[3].getFloat32(), message[4].getFloat32());
+                markParameterChange();
+                oscMessageStatus = "Output tap [" + std::to_string(message[1].getInt32()) + "]["
+                                 + std::to_string(message[2].getInt32()) + "] Updated";
+            }
+        }
+        
+        // ==== DELAY LINE STORAGE ====
+        if (messageString.compare("delayStorage") == 0) {
+            if (message[1].isString()) {
+                String storageString = message[1].getString();
+                if (storageString.compare("float") == 0)
+                    setDelayStorage(CompressedDelayLine::float32);
+                if (storageString.compare("half") == 0)
+                    setDelayStorage(CompressedDelayLine::float16);
+                if (storageString.compare("bfloat16") == 0)
+                    setDelayStorage(CompressedDelayLine::bfloat16);
+                oscMessageStatus = "Delay storage: " + std::string(CompressedDelayLine::getFormatName(fdn.getDelayStorage()))
+                                 + ", " + std::to_string(fdn.getDelayLineBytes() >> 20) + " MB";
+            }
+        }
+        
+        if (messageString.compare("delayStorageReport") == 0) {
+            startDelayStorageReport();
+        }
+        
+        // ==== EARLY REFLECTIONS ====
+        if (messageString.compare("earlyReflections") == 0) {
+            if (message[1].isString()) {
+                String erString = message[1].getString();
+                if (erString.compare("on") == 0) {
+                    earlyReflections.reset();
+                    earlyReflectionsBool = true;
+                    oscMessageStatus = "Early reflections are on";
+                } else if (erString.compare("off") == 0) {
+                    earlyReflectionsBool = false;
+                    oscMessageStatus = "Early reflections are off";
+                }
+            }
+        }
+        
+        if (messageString.compare("erNrTaps") == 0) {
+            if (message[1].isInt32()) {
+                earlyReflections.setNrTaps(message[1].getInt32());
+                erTapVector.resize(3 * jlimit(0, (int)EarlyReflections::maxTaps, (int)message[1].getInt32()));
+                count = 0;
+                oscMessageStatus = "Early reflection taps = " + std::to_string(earlyReflections.getNrTaps());
+            }
+        }
+        
+        // triplets of delay (ms), gain and lowpass cutoff (Hz) for every tap
+        if (messageString.compare("erTapWhole") == 0) {
+            oscMessageStatus = "Updating Early Reflection Taps...";
+            if (message[1].isFloat32() && !erTapVector.empty()) {
+                erTapVector[count] = message[1].getFloat32();
+                count++;
+                if (count >= (int)erTapVector.size()) {
+                    for (int i = 0; i < (int)erTapVector.size() / 3; ++i) {
+                        earlyReflections.setTap(i, erTapVector[3 * i], erTapVector[3 * i + 1], erTapVector[3 * i + 2]);
+                    }
+                    earlyReflections.setNrTaps((int)erTapVector.size() / 3);
+                    oscMessageStatus = "Early Reflection Taps Updated";
+                    count = 0;
+                }
+            }
+        }
+        
+        if (messageString.compare("erTapSingle") == 0) {
+            if (message[1].isInt32() && message[2].isFloat32() && message[3].isFloat32() && message[4].isFloat32()) {
+                earlyReflections.setTap(message[1].getInt32(), message[2].getFloat32(), message[3].getFloat32(), message[4].getFloat32());
+                oscMessageStatus = "Early Reflection Tap [" + std::to_string(message[1].getInt32()) + "] Updated";
+            }
+        }
+        
+        // ==== DECAY ANALYSIS ====
+        if (messageString.compare("decayAnalysis") == 0) {
+            if (message[1].isString()) {
+                String analysisString = message[1].getString();
+                if (analysisString.compare("on") == 0) {
+                    decayAnalyzer.start();
+                    oscMessageStatus = "Decay analysis is on, waiting for the input to stop";
+                } else if (analysisString.compare("off") == 0) {
+                    decayAnalyzer.stop();
+                    oscMessageStatus = "Decay analysis is off";
+                }
+            }
+        }
+        
+        // ==== DIFFUSION ====
+        if (messageString.compare("diffusion") == 0) {
+            if (message[1].isString()) {
+                String diffusionString = message[1].getString();
+                if (diffusionString.compare("on") == 0) {
+                    fdn.setDiffusion(true);
+                    oscMessageStatus = "Diffusion is on";
+                } else if (diffusionString.compare("off") == 0) {
+                    fdn.setDiffusion(false);
+                    oscMessageStatus = "Diffusion is off";
+                }
+            }
+        }
+        
+        if (messageString.compare("diffusionStages") == 0) {
+            if (message[1].isInt32()) {
+                fdn.setDiffusionStages(message[1].getInt32());
+                oscMessageStatus = "Diffusion stages = " + std::to_string(fdn.getDiffuser().getNrStages());
+            }
+        }
+        
+        if (messageString.compare("diffusionGain") == 0) {
+            if (message[1].isFloat32()) {
+                fdn.setDiffusionGain(message[1].getFloat32());
+                oscMessageStatus = "Diffusion gain = " + std::to_string(fdn.getDiffuser().getGain());
+            }
+        }
+        
+        if (messageString.compare("diffusionType") == 0) {
+            if (message[1].isString()) {
+                String typeString = message[1].getString();
+                if (typeString.compare("series") == 0) {
+                    fdn.setDiffusionNested(false);
+                    oscMessageStatus = "Diffusion allpasses in series";
+                } else if (typeString.compare("nested") == 0) {
+                    fdn.setDiffusionNested(true);
+                    oscMessageStatus = "Diffusion allpasses nested";
+                }
+            }
+        }
+        
+        // ==== GENERATED MATRICES ====
+        // name and optional seed, e.g. "matrixType randomOrthogonal 42"
+        if (messageString.compare("matrixType") == 0) {
+            if (message[1].isString()) {
+                const int type = MatrixFactory::getTypeFromName(message[1].getString());
+                if (type > 0) {
+                    if (message.size() > 2 && message[2].isInt32())
+                        matrixSeed = message[2].getInt32();
+                    setParameterFromOSC("MATRIXSELECTION", (float)type);
+                    markDirty(matrixDirty);     // also when only the seed has changed
+                    oscMessageStatus = "Matrix: " + MatrixFactory::getName(type).toStdString() + ", seed " + std::to_string(matrixSeed);
+                } else {
+                    oscMessageStatus = "Unknown matrix type";
+                }
+            }
+        }
+        
+        // off, check (scale down if the norm is above one) or project (nearest orthogonal matrix)
+        if (messageString.compare("matrixValidation") == 0) {
+            if (message[1].isString()) {
+                if (message[1].getString().compare("off") == 0)
+                    matrixValidation = MatrixValidator::off;
+                if (message[1].getString().compare("check") == 0)
+                    matrixValidation = MatrixValidator::check;
+                if (message[1].getString().compare("project") == 0)
+                    matrixValidation = MatrixValidator::project;
+                oscMessageStatus = "Matrix validation: " + message[1].getString().toStdString();
+            }
+        }
+        
+        if (messageString.compare("matrixSeed") == 0) {
+            if (message[1].isInt32()) {
+                matrixSeed = message[1].getInt32();
+                oscMessageStatus = "Matrix seed = " + std::to_string(matrixSeed);
+            }
+        }
+        
+        // ==== SCATTERING MATRIX ====
+        if (messageString.compare("scatteringStages") == 0) {
+            if (message[1].isInt32()) {
+                fdn.setScatteringStages(message[1].getInt32());
+                oscMessageStatus = "Scattering stages = " + std::to_string(fdn.getScattering().getNrStages());
+            }
+        }
+        
+        if (messageString.compare("scatteringSpread") == 0) {
+            if (message[1].isFloat32()) {
+                fdn.setScatteringSpread(message[1].getFloat32());
+                oscMessageStatus = "Scattering delay spread = " + std::to_string(fdn.getScattering().getSpread()) + " ms";
+            }
+        }
+        
+        // ==== MATRIX MODULATION ====
+        // rotates the mixing matrix instead of modulating the delays
+        if (messageString.compare("matrixModulation") == 0) {
+            if (message[1].isString()) {
+                String modString = message[1].getString();
+                if (modString.compare("on") == 0) {
+                    fdn.setMatrixModulation(true);
+                    oscMessageStatus = "Matrix modulation is on";
+                } else if (modString.compare("off") == 0) {
+                    fdn.setMatrixModulation(false);
+                    oscMessageStatus = "Matrix modulation is off";
+                }
+            }
+        }
+        
+        if (messageString.compare("matrixModRate") == 0) {
+            if (message[1].isFloat32()) {
+                fdn.getMatrixModulator().setRate(message[1].getFloat32());
+                oscMessageStatus = "Matrix modulation rate = " + std::to_string(fdn.getMatrixModulator().getRate()) + " Hz";
+            }
+        }
+        
+        if (messageString.compare("matrixModDepth") == 0) {
+            if (message[1].isFloat32()) {
+                fdn.getMatrixModulator().setDepth(message[1].getFloat32());
+                oscMessageStatus = "Matrix modulation depth = " + std::to_string(fdn.getMatrixModulator().getDepth());
+            }
+        }
+        
+        // ==== FILTER FEEDBACK MATRIX ====
+        // generated types for below and above the crossover, e.g. "filterMatrixLow householder"
+        if (messageString.compare("filterMatrixLow") == 0 || messageString.compare("filterMatrixHigh") == 0) {
+            if (message[1].isString()) {
+                const int type = MatrixFactory::getTypeFromName(message[1].getString());
+                if (type > 0) {
+                    if (messageString.compare("filterMatrixLow") == 0)
+                        filterLowType = type;
+                    else
+                        filterHighType = type;
+                    generatedSelection = 0;     // built again on the timer
+                    oscMessageStatus = "Filter matrix: " + MatrixFactory::getName(filterLowType).toStdString()
+                                     + " below, " + MatrixFactory::getName(filterHighType).toStdString() + " above";
+                } else {
+                    oscMessageStatus = "Unknown matrix type";
+                }
+            }
+        }
+        
+        if (messageString.compare("filterMatrixCrossover") == 0) {
+            if (message[1].isFloat32()) {
+                fdn.setFilterMatrixCrossover(message[1].getFloat32());
+                oscMessageStatus = "Filter matrix crossover = " + std::to_string(fdn.getFilterMatrix().getCrossover()) + " Hz";
+            }
+        }
+        
+        // morph time in seconds for every new matrix, 0 swaps it straight away
+        if (messageString.compare("matrixMorph") == 0) {
+            if (message[1].isFloat32()) {
+                fdn.setMatrixMorphTime(message[1].getFloat32());
+                oscMessageStatus = "Matrix morph time = " + std::to_string(fdn.getMatrixMorphTime()) + " s";
+            }
+        }
+        
+        // ==== COUPLED ROOMS ====
+        if (messageString.compare("nrRooms") == 0) {
+            if (message[1].isInt32()) {
+                setParameterFromOSC("NROFROOMS", (float)jlimit(1, (int)CoupledRooms::maxRooms, (int)message[1].getInt32()));
+                setNrRooms(message[1].getInt32());
+                oscMessageStatus = "Nr. of rooms = " + std::to_string(nrRooms);
+            }
+        }
+        
+        if (messageString.compare("coupling") == 0) {
+            if (message[1].isFloat32()) {
+                coupling = jlimit(0.f, 1.f, message[1].getFloat32());
+                coupledRooms.setCoupling(coupling);
+                oscMessageStatus = "Room coupling = " + std::to_string(coupling);
+            }
+        }
+        
+        if (messageString.compare("roomT60") == 0) {
+            if (message[1].isInt32() && message[2].isFloat32() && message[3].isFloat32()) {
+                coupledRooms.setRoomT60(message[1].getInt32(), message[2].getFloat32(), message[3].getFloat32());
+                oscMessageStatus = "Room [" + std::to_string(message[1].getInt32()) + "] T60 Updated";
+            }
+        }
+        
+        // delay range in ms, the rooms are rebuilt
+        if (messageString.compare("roomDelay") == 0) {
+            if (message[1].isInt32() && message[2].isFloat32() && message[3].isFloat32()) {
+                coupledRooms.setRoomDelay(message[1].getInt32(), message[2].getFloat32(), message[3].getFloat32());
+                if (nrRooms > 1 && isActive)
+                    configureCoupledRooms();
+                oscMessageStatus = "Room [" + std::to_string(message[1].getInt32()) + "] Delays Updated";
+            }
+        }
+        
+        if (messageString.compare("sourceRoom") == 0) {
+            if (message[1].isInt32()) {
+                coupledRooms.setSourceRoom(message[1].getInt32());
+                oscMessageStatus = "Source in room " + std::to_string(message[1].getInt32());
+            }
+        }
+        
+        if (messageString.compare("listenerRoom") == 0) {
+            if (message[1].isInt32()) {
+                coupledRooms.setListenerRoom(message[1].getInt32());
+                oscMessageStatus = "Listener in room " + std::to_string(message[1].getInt32());
+            }
+        }
+        
+        // ==== HYBRID CONVOLUTION ====
+        if (messageString.compare("hybrid") == 0) {
+            if (message[1].isString()) {
+                String hybridString = message[1].getString();
+                if (hybridString.compare("on") == 0) {
+                    hybridConvolution.setEnabled(true);
+                    oscMessageStatus = "Hybrid convolution is on";
+                } else if (hybridString.compare("off") == 0) {
+                    hybridConvolution.setEnabled(false);
+                    oscMessageStatus = "Hybrid convolution is off";
+                }
+            }
+        }
+        
+        if (messageString.compare("hybridLatency") == 0) {
+            if (message[1].isString()) {
+                String latencyString = message[1].getString();
+                if (latencyString.compare("zero") == 0) {
+                    hybridConvolution.setZeroLatency(true);
+                    oscMessageStatus = "Hybrid convolution uses zero latency partitions";
+                } else if (latencyString.compare("uniform") == 0) {
+                    hybridConvolution.setZeroLatency(false);
+                    oscMessageStatus = "Hybrid convolution uses uniform partitions";
+                }
+            }
+        }
+        
+        // ==== PARALLEL FDN ====
+        if (messageString.compare("parallel") == 0) {
+            if (message[1].isString()) {
+                String parallelString = message[1].getString();
+                if (parallelString.compare("on") == 0) {
+                    configureParallelFDN();
+                    parallelFDNBool = true;
+                    oscMessageStatus = "Parallel FDN is on (" + std::to_string(parallelOrder) + " lines, " + std::to_string(parallelThreads) + " threads)";
+                } else if (parallelString.compare("off") == 0) {
+                    parallelFDNBool = false;
+                    oscMessageStatus = "Parallel FDN is off";
+                }
+            }
+        }
+        
+        if (messageString.compare("parallelOrder") == 0) {
+            if (message[1].isInt32()) {
+                parallelOrder = jlimit(1, (int)ParallelFDN::maxDelayLines, (int)message[1].getInt32());
+                if (parallelFDNBool)
+                    configureParallelFDN();
+                oscMessageStatus = "Parallel FDN order = " + std::to_string(parallelOrder);
+            }
+        }
+        
+        if (messageString.compare("parallelThreads") == 0) {
+            if (message[1].isInt32()) {
+                parallelThreads = jlimit(1, (int)ParallelFDN::maxThreads, (int)message[1].getInt32());
+                if (parallelFDNBool)
+                    configureParallelFDN();
+                oscMessageStatus = "Parallel FDN threads = " + std::to_string(parallelThreads);
+            }
+        }
+        
         // ==== MODULATION ====
         if (messageString.compare("modulation") == 0) {
             if(message[1].isString()) {
@@ -566,9 +1559,12 @@ void FDNReverbAudioProcessor::connectUDP(bool isConnected) {
         oscReceiver.disconnect();
         oscReceiver.connect(portNumber);
         oscReceiver.addListener(this, "/juce");
+        // validation reports go back to the sender one port up
+        OSCSender::connect("127.0.0.1", portNumber + 1);
         oscConnectionStatus = "Connected";
     } else {
         oscReceiver.disconnect();
+        OSCSender::disconnect();
         oscConnectionStatus = "Not Connected";
     }
 }
@@ -578,6 +1574,126 @@ void FDNReverbAudioProcessor::updateOSCPort(int newPortNumber) {
     portNumber = newPortNumber;
     oscReceiver.connect(portNumber);
     oscReceiver.addListener(this, "/juce");
+    OSCSender::connect("127.0.0.1", portNumber + 1);
+}
+
+// Runs on the message thread. matrixCoefs keeps what was sent, so single
+// coefficient updates keep building on it, the FDN gets the validated copy.
+void FDNReverbAudioProcessor::installOSCMatrix(String singleWhole) {
+    validatedCoefs = matrixCoefs;
+    const auto report = MatrixValidator::validate(validatedCoefs, nrDelayLines, matrixValidation);
+    fdn.updateMatrixCoefficientsOSC(validatedCoefs, singleWhole);
+    
+    if (matrixValidation == MatrixValidator::off) {
+        oscMessageStatus = "Matrix Updated";
+        return;
+    }
+    
+    oscMessageStatus = "Matrix Updated, " + MatrixValidator::toString(report).toStdString();
+    OSCSender::send("/juce/matrixReport", report.orthogonalityError, report.spectralNorm, report.correction,
+                    (int)report.corrected);
+}
+
+// The delay lines are built again in the new format, which clears the tail.
+void FDNReverbAudioProcessor::setDelayStorage(CompressedDelayLine::Format format) {
+    if (format == fdn.getDelayStorage())
+        return;
+    
+    fdn.setDelayStorage(format);
+    if (isActive) {
+        suspendProcessing(true);
+        prepareToPlay(getSampleRate(), getBlockSize());
+        suspendProcessing(false);
+    }
+}
+
+// Renders the tail of the current settings with float delay lines and with both
+// 16 bit formats, the error of each is sent relative to the float tail along
+// with the time the render took. The settings are copied from the latest
+// snapshot here, the rendering runs on reportPool and the timer sends the result.
+void FDNReverbAudioProcessor::startDelayStorageReport() {
+    if (storageReportRunning.exchange(true)) {
+        oscMessageStatus = "Delay storage report is still rendering";
+        return;
+    }
+    
+    // the one copy of the FDN, it is prepared again for every format
+    settingsSnapshots.acquire();
+    std::shared_ptr<FDN> settings(new FDN());
+    if (!settings->copySettingsFrom(fdn, settingsSnapshots.current())) {
+        storageReportRunning = false;
+        oscMessageStatus = "Delay storage report: the FDN has not run yet";
+        return;
+    }
+    const int length = jlimit((int)(0.1 * Fs), (int)(5.0 * Fs), (int)(1.5f * settings->getLongestT60() * Fs));
+    
+    const double sampleRate = Fs;
+    reportPool.addJob([this, settings, length, sampleRate] {
+        // a new format builds the delay lines again, the render starts from silence
+        auto render = [&](CompressedDelayLine::Format format, float* destination) {
+            settings->setDelayStorage(format);
+            
+            dsp::ProcessSpec spec;
+            spec.sampleRate = sampleRate;
+            spec.maximumBlockSize = 512;
+            spec.numChannels = 1;
+            settings->prepare(spec);
+            
+            const double start = Time::getMillisecondCounterHiRes();
+            settings->renderImpulseResponse(destination, length);
+            return (float)(Time::getMillisecondCounterHiRes() - start);
+        };
+        
+        std::vector<float> reference(length), response(length);
+        storageReferenceTime = render(CompressedDelayLine::float32, reference.data());
+        
+        double referenceEnergy = 0.0;
+        float referencePeak = 0.0f;
+        for (const float x : reference) {
+            referenceEnergy += x * x;
+            referencePeak = jmax(referencePeak, std::abs(x));
+        }
+        
+        storageReport.clear();
+        for (const auto format : { CompressedDelayLine::float16, CompressedDelayLine::bfloat16 }) {
+            StorageReport entry;
+            entry.name = CompressedDelayLine::getFormatName(format);
+            entry.time = render(format, response.data());
+            
+            double errorEnergy = 0.0;
+            float errorPeak = 0.0f;
+            for (int n = 0; n < length; ++n) {
+                const float error = response[n] - reference[n];
+                errorEnergy += error * error;
+                errorPeak = jmax(errorPeak, std::abs(error));
+            }
+            
+            entry.snr = (float)(10.0 * std::log10((referenceEnergy + 1.0e-30) / (errorEnergy + 1.0e-30)));
+            entry.peakError = Decibels::gainToDecibels(errorPeak / jmax(referencePeak, 1.0e-30f), -200.0f);
+            storageReport.push_back(entry);
+        }
+        storageReportReady = true;
+    });
+    oscMessageStatus = "Rendering the delay storage report...";
+}
+
+// timer, once the job has finished
+void FDNReverbAudioProcessor::sendDelayStorageReport() {
+    String status = "float " + String(storageReferenceTime, 1) + " ms";
+    for (const auto& entry : storageReport) {
+        status += ", " + entry.name + " SNR " + String(entry.snr, 1) + " dB, " + String(entry.time, 1) + " ms";
+        OSCSender::send("/juce/delayStorageReport", entry.name, entry.snr, entry.peakError, entry.time, storageReferenceTime);
+    }
+    oscMessageStatus = status.toStdString();
+    storageReportRunning = false;
+}
+
+// One message per band, a measured T60 of 0 means the band did not decay far enough to tell
+void FDNReverbAudioProcessor::sendDecayAnalysis() {
+    const auto result = decayAnalyzer.getResult();
+    for (int b = 0; b < DecayAnalyzer::nrBands; ++b)
+        OSCSender::send("/juce/decayAnalysis", DecayAnalyzer::getBandFrequency(b), result.measured[b], result.target[b]);
+    oscMessageStatus = "Decay analysed over " + String(result.seconds, 1).toStdString() + " s";
 }
 
 int FDNReverbAudioProcessor::getPortNumber() {
@@ -585,11 +1701,14 @@ int FDNReverbAudioProcessor::getPortNumber() {
 }
 
 void FDNReverbAudioProcessor::setNrDelayLines(int newDelayNr) {
+    markParameterChange();
     nrDelayLines = newDelayNr;
     bGains.resize(nrDelayLines);
     cGains.resize(nrDelayLines);
     matrixCoefs.resize(nrDelayLines*nrDelayLines);
+    validatedCoefs.resize(nrDelayLines*nrDelayLines);
     delayVector.reserve(nrDelayLines);
+    fdn.requestDelayLines(nrDelayLines);
     changingFDNOrder = true;
     
 }
@@ -602,21 +1721,4 @@ String FDNReverbAudioProcessor::getOSCMessageStatus() {
     return oscMessageStatus;
 }
 
-String FDNReverbAudioProcessor::getMatrixValues() {
-    return fdn.getMatrixValues();
-}
-
-String FDNReverbAudioProcessor::getBGains() {
-    return fdn.getBGains();
-}
-
-String FDNReverbAudioProcessor::getCGains() {
-    return fdn.getCGains();
-}
-
-String FDNReverbAudioProcessor::getDelayValues() {
-    return fdn.getDelayValues();
-}
-
-
 
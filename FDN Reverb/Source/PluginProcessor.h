@@ -10,6 +10,15 @@
 
 #include <JuceHeader.h>
 #include "FDN.hpp"
+#include "ParallelFDN.h"
+#include "HybridConvolution.h"
+#include "EarlyReflections.h"
+#include "CoupledRooms.h"
+#include "MatrixFactory.h"
+#include "MatrixValidator.h"
+#include "AmbisonicEncoder.h"
+#include "FDNSnapshot.h"
+#include "DecayAnalyzer.h"
 
 using namespace dsp;
 
@@ -17,10 +26,11 @@ using namespace dsp;
 /**
 */
 class FDNReverbAudioProcessor  : public juce::AudioProcessor,
-                                          public ValueTree::Listener,
+                                          public AudioProcessorValueTreeState::Listener,
                                           public OSCReceiver,
                                           public OSCReceiver::ListenerWithOSCAddress<OSCReceiver::MessageLoopCallback>,
-                                          public OSCSender
+                                          public OSCSender,
+                                          private Timer
 {
 public:
     //==============================================================================
@@ -70,7 +80,11 @@ public:
     
 
 
-    void updateParameters();
+    // applies the subsystems whose parameters are flagged in dirty
+    void updateParameters(uint32 dirty);
+    
+    // message thread, the delays and the matrix selection need searching or building
+    void updateDelayAndMatrix(uint32 dirty);
     
     int getNrDelayLines();
     
@@ -84,17 +98,39 @@ public:
     
     void modulateFDN(bool modulate);
     
+    void configureParallelFDN();
+    
+    void setNrRooms(int newNrRooms);
+    void configureCoupledRooms();
+    
+    void markParameterChange();
+    
+    enum DirtyFlags
+    {
+        filterDirty = 1 << 0,
+        delayDirty = 1 << 1,
+        dryWetDirty = 1 << 2,
+        matrixDirty = 1 << 3,
+        
+        // taken by the timer instead of the audio thread
+        timerDirty = delayDirty | matrixDirty,
+    };
+    
+    // any thread, collected and applied at the start of the next block, or by the
+    // next timer callback for the timerDirty flags
+    void markDirty(uint32 flags);
+    
     String getOSCConnectionStatus();
     String getOSCMessageStatus();
-    String getMatrixValues();
     
     std::string oscConnectionStatus = "Not Connected";
     std::string oscMessageStatus = "";
-    std::string matrixValues = "";
     
-    String getBGains();
-    String getCGains();
-    String getDelayValues();
+    // gains, delays and matrix of the FDN as the audio thread last saw them, for the editor
+    FDNSnapshotBuffer& getSnapshots() { return snapshots; }
+    
+    // measured against asked for T60 per octave band, while it is on
+    DecayAnalyzer& getDecayAnalyzer() { return decayAnalyzer; }
 
     AudioProcessorValueTreeState tree;
      
@@ -108,9 +144,13 @@ public:
     std::atomic<float>* matrixSelec;
     std::atomic<float>* modRate;
     std::atomic<float>* modDepth;
+    std::atomic<float>* nrOfRooms;
     
     // not used at the moment, could be used for delay line smoothing
     SmoothedValue<float, ValueSmoothingTypes::Linear> smoother;
+    
+    // dry/wet gain, ramped from block to block
+    SmoothedValue<float, ValueSmoothingTypes::Linear> wetGain;
 
     
     float Fs;
@@ -119,14 +159,11 @@ public:
     float lowDel = 5.f; // ms
     float highDel = 20.f; // ms
     
-    bool updateProcessing;
-    bool updateDryWetBool = false;
-    bool updateFilterBool = false;
-    bool updateDelayBool = false;
-    bool updateMatrixBool = true;
     bool updateMatrixOSCBool = false;
     bool updateDelayOSCBool = false;
     bool modulateFDNBool = false;
+    bool parallelFDNBool = false;
+    bool earlyReflectionsBool = false;
     
 
 private:
@@ -134,7 +171,18 @@ private:
     bool isActive = false;
     bool changingFDNOrder = false;
     
-    void valueTreePropertyChanged(ValueTree &treeWhosePropertyHasChanged, const Identifier &property) override;
+    void parameterChanged(const String& parameterID, float newValue) override;
+    
+    // sets a parameter the way the host would, so the listener and the host both see it
+    void setParameterFromOSC(const String& parameterID, float newValue);
+    
+    // the matrix is built in prepareToPlay, everything else only once it changes
+    std::atomic<uint32> dirtyParameters { matrixDirty };
+    
+    // FDN part of the state, waiting for prepareToPlay
+    MemoryBlock engineState;
+    void restoreEngineState();
+    void timerCallback() override;
     int nrDelayLines;
     int maxDelaySamples = 176400;
     int maxNumChannels;
@@ -143,7 +191,10 @@ private:
     std::vector<float> cGains;
     
     std::vector<float> matrixCoefs;
+    std::vector<float> validatedCoefs;  // matrixCoefs after the validator, this is what the FDN gets
     std::vector<float> delayVector;
+    std::vector<float> erTapVector;
+    std::vector<float> t60BandVector;
     
     // OSC variables
     OSCReceiver oscReceiver;
@@ -152,9 +203,91 @@ private:
         
     // Coupled rooms variables
     float coupling = 0.3f;
+    int nrRooms = 1;    // a single room is the normal FDN
+    CoupledRooms coupledRooms;
+    SpinLock roomsLock;
+    AudioBuffer<float> roomsBuffer; // mono input, left and right output
+    float roomsLowTransFreq = 0.f, roomsHighTransFreq = 0.f;
     
 //    Initialise FDN
     FDN fdn;
+    FDNSnapshotBuffer snapshots;
+    FDNSnapshotBuffer settingsSnapshots;    // read by the timer for copies of the FDN, see FDN::copySettingsFrom()
+    
+    // Large order FDN rendered on a worker pool, configured from the message thread
+    ParallelFDN parallelFDN;
+    SpinLock parallelLock;
+    AudioBuffer<float> parallelBuffer; // mono input, left and right output
+    int parallelOrder = 128;
+    int parallelThreads = 4;
+    int reportedParallelMisses = 0;
+    
+    void updateParallelFilter();
+    
+    // the OSC gains go to the network that is running
+    int getGainOrder() const { return parallelFDNBool ? parallelOrder : nrDelayLines; }
+    
+    // Static FDN frozen into a convolution, the change count tells it when to go back to the FDN
+    HybridConvolution hybridConvolution;
+    AudioBuffer<float> hybridBuffer;
+    std::atomic<int> parameterChangeCount { 0 };
+    
+    // generated mixing matrices, built on the timer and handed to the FDN
+    int matrixSeed = 1;
+    int generatedSelection = 0;
+    int generatedOrder = 0;
+    int generatedSeed = 0;
+    int filterLowType = MatrixFactory::householder;         // MATRIXSELECTION 10
+    int filterHighType = MatrixFactory::randomOrthogonal;
+    
+    void updateGeneratedMatrix();
+    
+    // OSC matrices are checked on the message thread before they reach the FDN,
+    // the result is sent back to port + 1
+    int matrixValidation = MatrixValidator::check;
+    void installOSCMatrix(String singleWhole);
+    
+    // per block guard, clears the output and the engine state when it blows up
+    bool outputBlewUp(AudioBuffer<float>& buffer);
+    std::atomic<int> outputRecoveries { 0 };
+    int reportedRecoveries = 0;
+    
+    // time prepareToPlay took, reported from the timer
+    std::atomic<int> prepareCount { 0 };
+    int reportedPrepareCount = 0;
+    double lastPrepareTimeMs = 0.0;
+    
+    // message thread, 16 bit delay line storage and how far its tail is from the float one.
+    // The tails are rendered on reportPool, the timer sends the result
+    void setDelayStorage(CompressedDelayLine::Format format);
+    void startDelayStorageReport();
+    void sendDelayStorageReport();
+    
+    struct StorageReport {
+        String name;
+        float snr = 0.0f, peakError = 0.0f, time = 0.0f;
+    };
+    std::vector<StorageReport> storageReport;   // written by the job until storageReportReady
+    float storageReferenceTime = 0.0f;
+    std::atomic<bool> storageReportRunning { false };
+    std::atomic<bool> storageReportReady { false };
+    ThreadPool reportPool { 1 };
+    
+    EarlyReflections earlyReflections;
+    AudioBuffer<float> erBuffer;
+    
+    DecayAnalyzer decayAnalyzer;
+    int reportedDecayCount = 0;
+    void sendDecayAnalysis();
+    
+    // set from the output bus in prepareToPlay, 0 for mono and stereo
+    int ambisonicOrder = 0;
+    AmbisonicEncoder ambisonicEncoder;
+    AudioBuffer<float> ambisonicBuffer;
+    void processAmbisonic(AudioBuffer<float>& buffer);
+    
+    // decay analysis and order change, the last thing every block does
+    void finishFDNBlock(AudioBuffer<float>& buffer);
   
 
 
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    ScatteringMatrix.cpp
+    Created: 19 Oct 2026 3:37:12pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#include "ScatteringMatrix.h"
+
+ScatteringMatrix::ScatteringMatrix() {}
+
+ScatteringMatrix::~ScatteringMatrix() {}
+
+void ScatteringMatrix::prepare(double sampleRate, int numChannels, int maxLines) {
+    Fs = sampleRate;
+    rowSize = maxLines;
+
+    const int ringSize = nextPowerOfTwo((int)(maxSpreadMs * Fs / 1000.0) + 1);
+    ringMask = ringSize - 1;
+
+    state.resize(numChannels);
+    for (auto& channel : state) {
+        channel.resize(maxStages);
+        for (auto& stage : channel) {
+            stage.assign(ringSize * rowSize, 0.0f);
+        }
+    }
+    position.assign(numChannels, 0);
+    work.assign(rowSize, 0.0f);
+    stageDelays.assign(maxStages * rowSize, 0);
+    pendingDelays.assign(maxStages * rowSize, 0);
+
+    // fixed seed, so the same settings always give the same matrix
+    Random random(4321);
+    signs.resize((maxStages + 1) * rowSize);
+    for (auto& sign : signs) {
+        sign = random.nextBool() ? 1.0f : -1.0f;
+    }
+
+    const SpinLock::ScopedLockType lock(settingsLock);
+    generateDelays();
+    stageDelays = pendingDelays;
+    nrStages = pendingStages;
+    settingsChanged = false;
+}
+
+void ScatteringMatrix::reset() {
+    for (auto& channel : state)
+        for (auto& stage : channel)
+            std::fill(stage.begin(), stage.end(), 0.0f);
+    std::fill(position.begin(), position.end(), 0);
+}
+
+void ScatteringMatrix::setNrStages(int newNrStages) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingStages = jlimit(0, (int)maxStages, newNrStages);
+    settingsChanged = true;
+}
+
+void ScatteringMatrix::setSpread(float newSpreadMs) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingSpreadMs = jlimit(0.0f, (float)maxSpreadMs, newSpreadMs);
+    generateDelays();
+    settingsChanged = true;
+}
+
+void ScatteringMatrix::copySettingsFrom(const ScatteringMatrix& other) {
+    const SpinLock::ScopedLockType lock(settingsLock);
+    pendingStages = other.pendingStages;
+    pendingSpreadMs = other.pendingSpreadMs;
+    generateDelays();
+    settingsChanged = true;
+}
+
+// fills the pending table, the caller holds settingsLock
+void ScatteringMatrix::generateDelays() {
+    if (pendingDelays.empty())
+        return;
+
+    const int maxDelay = jmin(ringMask, (int)(pendingSpreadMs * Fs / 1000.0));
+    Random random(8765);
+    for (auto& delay : pendingDelays) {
+        delay = random.nextInt(maxDelay + 1);
+    }
+}
+
+// called on the audio thread, a change that is being written is taken next time
+void ScatteringMatrix::applyPendingSettings() {
+    const SpinLock::ScopedTryLockType lock(settingsLock);
+    if (!lock.isLocked() || !settingsChanged)
+        return;
+
+    // stages that come back into use must not replay what they held before
+    for (auto& channel : state)
+        for (int k = nrStages; k < pendingStages; ++k)
+            std::fill(channel[k].begin(), channel[k].end(), 0.0f);
+
+    std::copy(pendingDelays.begin(), pendingDelays.end(), stageDelays.begin());
+    nrStages = pendingStages;
+    settingsChanged = false;
+}
+
+// uses the pending table, the loop filters are designed for the settings that are on the way
+float ScatteringMatrix::getAverageDelay(int numLines) const {
+    numLines = jmin(numLines, rowSize);
+    if (numLines <= 0)
+        return 0.0f;
+
+    int total = 0;
+    for (int k = 0; k < pendingStages; ++k)
+        for (int i = 0; i < numLines; ++i)
+            total += pendingDelays[k * rowSize + i];
+
+    return (float)total / numLines;
+}
+
+// Scaled Hadamard by a fast Walsh-Hadamard transform, or a Householder
+// reflection I - 2/N 11^T when N is not a power of two.
+void ScatteringMatrix::mix(float* v, int numLines) const {
+    if (isPowerOfTwo(numLines)) {
+        for (int length = 1; length < numLines; length <<= 1) {
+            for (int i = 0; i < numLines; i += 2 * length) {
+                for (int j = i; j < i + length; ++j) {
+                    const float a = v[j];
+                    const float b = v[j + length];
+                    v[j] = a + b;
+                    v[j + length] = a - b;
+                }
+            }
+        }
+        FloatVectorOperations::multiply(v, 1.0f / std::sqrt((float)numLines), numLines);
+    } else {
+        float sum = 0.0f;
+        for (int i = 0; i < numLines; ++i) {
+            sum += v[i];
+        }
+        FloatVectorOperations::add(v, -2.0f * sum / numLines, numLines);
+    }
+}
+
+void ScatteringMatrix::process(int channel, const float* input, float* output, int numLines) {
+    if (channel >= (int)state.size() || numLines > rowSize)
+        return;
+
+    if (channel == 0)
+        applyPendingSettings();
+
+    float* v = work.data();
+    const int pos = position[channel];
+    FloatVectorOperations::copy(v, input, numLines);
+
+    for (int k = 0; k <= nrStages; ++k) {
+        FloatVectorOperations::multiply(v, signs.data() + k * rowSize, numLines);
+        mix(v, numLines);
+
+        if (k == nrStages)
+            break;
+
+        // D_k(z): write the stage input, read it back with a different delay per line
+        float* ring = state[channel][k].data();
+        const int* delays = stageDelays.data() + k * rowSize;
+        FloatVectorOperations::copy(ring + pos * rowSize, v, numLines);
+        for (int i = 0; i < numLines; ++i) {
+            v[i] = ring[((pos - delays[i]) & ringMask) * rowSize + i];
+        }
+    }
+
+    position[channel] = (pos + 1) & ringMask;
+    FloatVectorOperations::copy(output, v, numLines);
+}
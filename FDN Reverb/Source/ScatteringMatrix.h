@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    ScatteringMatrix.h
+    Created: 19 Oct 2026 3:37:12pm
+    Author:  Oddur Kristjansson
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Delay feedback matrix for a scattering FDN:
+//
+//     A(z) = U_K D_K(z) ... U_1 D_1(z) U_0
+//
+// where every U_k is a Hadamard matrix with a random sign flip on its input
+// and every D_k(z) is a diagonal of short, different delays. Each U_k is
+// orthogonal and the delays are lossless, so A(z) is paraunitary and the
+// network stays as stable as with a scalar orthogonal matrix.
+//
+// The Hadamard stages are applied with a fast Walsh-Hadamard transform,
+// O(N log N) instead of O(N^2). For orders that are not a power of two a
+// Householder reflection, O(N), is used instead.
+class ScatteringMatrix {
+
+public:
+
+    ScatteringMatrix();
+    ~ScatteringMatrix();
+
+    void prepare(double sampleRate, int numChannels, int maxLines);
+
+    void reset();
+
+    // the delay table is generated here and picked up by the audio thread in process()
+    void setNrStages(int newNrStages);
+    void setSpread(float newSpreadMs);
+    void copySettingsFrom(const ScatteringMatrix& other);
+
+    int getNrStages() const { return pendingStages; }
+    float getSpread() const { return pendingSpreadMs; }
+
+    // mean delay, in samples, that the matrix adds to the first numLines lines
+    float getAverageDelay(int numLines) const;
+
+    void process(int channel, const float* input, float* output, int numLines);
+
+    enum
+    {
+        maxStages = 4,
+        maxSpreadMs = 10,
+    };
+
+private:
+
+    void mix(float* v, int numLines) const;
+    void generateDelays();
+    void applyPendingSettings();
+
+    // [channel][stage] -> ringSize rows of rowSize samples
+    std::vector<std::vector<std::vector<float>>> state;
+    std::vector<int> position;
+    std::vector<int> stageDelays;       // [stage * rowSize + line]
+    std::vector<float> signs;           // [matrix * rowSize + line]
+    std::vector<float> work;
+    int ringMask = 0;
+    int rowSize = 0;
+
+    int nrStages = 2;
+    double Fs = 44100.0;
+
+    std::vector<int> pendingDelays;
+    int pendingStages = 2;
+    float pendingSpreadMs = 3.0f;
+    bool settingsChanged = false;
+    SpinLock settingsLock;
+};
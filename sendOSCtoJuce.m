@@ -69,6 +69,23 @@ end
 % send single matrix value
 oscsend(u, path, 'siif', 'matrixSingle', idx(1), idx(2), 0.3);
 
+% incoming matrices are checked before they are installed: off, check or project.
+% The report (error, norm, correction, corrected) comes back on port + 1 at /juce/matrixReport
+oscsend(u, path, 'ss', 'matrixValidation', 'project');
+
+% glide to every new matrix over 2 seconds instead of switching (0 = off)
+oscsend(u, path, 'sf', 'matrixMorph', 2.0);
+
+% frequency dependent mixing (Matrix Selection = Filter Matrix): one generated
+% matrix below the crossover and another above it
+oscsend(u, path, 'ss', 'filterMatrixLow', 'householder');
+oscsend(u, path, 'ss', 'filterMatrixHigh', 'randomOrthogonal');
+oscsend(u, path, 'sf', 'filterMatrixCrossover', 1500.0);
+
+% or let the plugin build the matrix: randomOrthogonal, hadamard, householder,
+% circulant, blockDiagonal or nested, followed by a seed
+oscsend(u, path, 'ssi', 'matrixType', 'randomOrthogonal', 5);
+
 % send delayValues as whole
 for i = 1:length(delays)
     oscsend(u, path, 'sf', 'delayWhole', delays(i));
@@ -91,6 +108,32 @@ oscsend(u, path, 'sf', 'lowTransFreq', lowTransFreq);
 
 oscsend(u, path, 'sf', 'highTransFreq', highTransFreq);
 
+% graphic EQ attenuation, 10 octave or 31 third octave bands. 'follow' takes
+% the band T60s from the values above, sending band T60s switches that off
+oscsend(u, path, 'ss', 'graphicEQ', 'follow');
+oscsend(u, path, 'si', 'graphicEQBands', 10);
+t60Bands = linspace(4.5, 1.2, 10); % seconds, lowest band first
+for i = 1:length(t60Bands)
+    oscsend(u, path, 'sf', 't60BandWhole', t60Bands(i));
+end
+oscsend(u, path, 'sif', 't60BandSingle', 0, 6.0);
+
+% EQ on the output that flattens the spectrum of the tail
+oscsend(u, path, 'ss', 'toneCorrection', 'on');
+
+% extra outputs along every delay line, 0 switches them off
+oscsend(u, path, 'si', 'outputTaps', 3);
+oscsend(u, path, 'siiff', 'outputTap', 0, 1, 0.4, -0.3); % line, tap, position, gain
+
+% 16 bit delay lines ('float', 'half' or 'bfloat16'), the report compares the
+% tail of both 16 bit formats with float and comes back on /juce/delayStorageReport
+oscsend(u, path, 'ss', 'delayStorage', 'half');
+oscsend(u, path, 's', 'delayStorageReport');
+
+% T60 per octave band measured on every free decay of the output, comes back
+% on /juce/decayAnalysis as band, measured and target T60 (0 = not enough decay)
+oscsend(u, path, 'ss', 'decayAnalysis', 'on');
+
 % send modulation rate value
 oscsend(u, path, 'sif', 'modRateSingle', index, modRate);
 